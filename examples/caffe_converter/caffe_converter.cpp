@@ -73,6 +73,9 @@ void test(const std::string &model_file,
   auto net    = tiny_dnn::create_net_from_caffe_prototxt(model_file);
   tiny_dnn::reload_weight_from_caffe_protobinary(trained_file, net.get());
 
+  // merge batch normalization into the preceding layers for inference
+  net->fold_batch_normalization();
+
   // int channels = (*net)[0]->in_data_shape()[0].depth_;
   int width  = (*net)[0]->in_data_shape()[0].width_;
   int height = (*net)[0]->in_data_shape()[0].height_;
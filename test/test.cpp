@@ -42,16 +42,17 @@ using namespace tiny_dnn::activation;
 
 #include "test_activation_layer.h"
 #include "test_average_pooling_layer.h"
-// TODO(yida): fix broken test
-// #include "test_average_unpooling_layer.h"
+#include "test_average_unpooling_layer.h"
 #include "test_batch_norm_layer.h"
 #include "test_concat_layer.h"
 #include "test_convolutional_layer.h"
 #include "test_core.h"
 #include "test_deconvolutional_layer.h"
 #include "test_dropout_layer.h"
+#include "test_fake_quantize_layer.h"
 #include "test_fully_connected_layer.h"
 #include "test_global_average_pooling_layer.h"
+#include "test_half_precision.h"
 #include "test_integration.h"
 #include "test_l2_norm_layer.h"
 #include "test_large_thread_count.h"
@@ -66,7 +67,9 @@ using namespace tiny_dnn::activation;
 #include "test_quantization.h"
 #include "test_quantized_convolutional_layer.h"
 #include "test_quantized_deconvolutional_layer.h"
+#include "test_quantized_fully_connected_layer.h"
 #include "test_slice_layer.h"
+#include "test_sparse_fully_connected_layer.h"
 #include "test_target_cost.h"
 #include "test_tensor.h"
 #include "test_zero_pad_layer.h"
@@ -81,10 +84,6 @@ using namespace tiny_dnn::activation;
 #include "test_serialization.h"
 #endif  // CNN_NO_SERIALIZATION
 
-#ifdef CNN_USE_GEMMLOWP
-#include "test_quantized_fully_connected_layer.h"
-#endif  // CNN_USE_GEMMLOOP
-
 #ifdef CNN_USE_CAFFE_CONVERTER
 #include "test_caffe_converter.h"
 #endif  // CNN_USE_CAFFE_CONVERTER
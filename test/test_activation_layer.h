@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <cmath>
 #include <vector>
 
 namespace tiny_dnn {
@@ -37,4 +38,69 @@ TEST(selu, gradient_check) {
   }
 }
 
+TEST(activation, fast_math_accuracy) {
+  // sweep across the domain including the scalar tail (size % 8 != 0)
+  const size_t n = 4099;
+  vec_t x(n), y(n);
+
+  for (size_t i = 0; i < n; i++) x[i] = float_t(-80 + 160.0 * i / (n - 1));
+  vectorize::exp(&x[0], n, &y[0]);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(y[i] / std::exp(x[i]), float_t(1), float_t(3e-7));
+  }
+
+  for (size_t i = 0; i < n; i++) x[i] = float_t(-10 + 20.0 * i / (n - 1));
+  vectorize::tanh(&x[0], n, &y[0]);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(y[i], std::tanh(x[i]), float_t(3e-7) * std::abs(y[i]));
+  }
+  vectorize::sigmoid(&x[0], n, &y[0]);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(y[i], float_t(1) / (float_t(1) + std::exp(-x[i])),
+                float_t(2e-7));
+  }
+
+  for (size_t i = 0; i < n; i++) x[i] = float_t(-0.999 + 100.0 * i / (n - 1));
+  vectorize::log1p(&x[0], n, &y[0]);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(y[i], std::log1p(x[i]), float_t(3e-7) * std::abs(y[i]));
+  }
+
+  // saturation at both ends of exp
+  x[0] = float_t(-100);
+  x[1] = float_t(100);
+  vectorize::exp(&x[0], 2, &y[0]);
+  EXPECT_EQ(y[0], float_t(0));
+  EXPECT_TRUE(std::isfinite(y[1]));
+}
+
+TEST(activation, vectorized_forward) {
+  const size_t n = 37;
+  vec_t x(n), y(n);
+  for (size_t i = 0; i < n; i++) x[i] = float_t(-6 + 12.0 * i / (n - 1));
+
+  softmax sm(n);
+  sm.forward_activation(x, y);
+  float_t denom = 0;
+  for (size_t i = 0; i < n; i++) denom += std::exp(x[i] - x[n - 1]);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(y[i], std::exp(x[i] - x[n - 1]) / denom, float_t(1e-6));
+  }
+
+  elu el(n);
+  el.forward_activation(x, y);
+  for (size_t i = 0; i < n; i++) {
+    EXPECT_NEAR(y[i], x[i] < 0 ? std::exp(x[i]) - float_t(1) : x[i],
+                float_t(1e-6));
+  }
+
+  softplus sp(n, float_t(2), float_t(5));
+  sp.forward_activation(x, y);
+  for (size_t i = 0; i < n; i++) {
+    const float_t expected =
+      2 * x[i] > 5 ? x[i] : std::log1p(std::exp(2 * x[i])) / 2;
+    EXPECT_NEAR(y[i], expected, float_t(1e-6));
+  }
+}
+
 }  // namespace tiny_dnn
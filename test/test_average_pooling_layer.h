@@ -80,4 +80,64 @@ TEST(ave_pool, read_write) {
   serialization_test(l1, l2);
 }
 
+TEST(ave_pool, gradient_check_overlapping) {
+  using loss_func = mse;
+  using network   = network<sequential>;
+
+  network nn;
+  nn << average_pooling_layer(4, 4, 2, 2, 2, 1, 1);  // 4x4 => 3x3
+
+  const auto test_data = generate_gradient_check_data(nn.in_data_size());
+  nn.init_weight();
+
+  EXPECT_TRUE(nn.gradient_check<loss_func>(test_data.first, test_data.second,
+                                           epsilon<float_t>(), GRAD_CHECK_ALL));
+}
+
+TEST(ave_pool, avx_equals_internal) {
+  struct {
+    size_t w, h, pool;
+  } configs[] = {{36, 6, 2}, {20, 4, 2}, {6, 2, 2}, {27, 9, 3}, {12, 6, 3}};
+
+  for (auto c : configs) {
+    average_pooling_layer internal(c.w, c.h, 3, c.pool, c.pool, c.pool,
+                                   c.pool, false, padding::valid,
+                                   core::backend_t::internal);
+    average_pooling_layer avx(c.w, c.h, 3, c.pool, c.pool, c.pool, c.pool,
+                              false, padding::valid, core::backend_t::avx);
+    internal.setup(false);
+    avx.setup(false);
+    for (size_t i = 0; i < internal.weights().size(); i++) {
+      vec_t &w = *internal.weights()[i];
+      uniform_rand(w.begin(), w.end(), -1, 1);
+      *avx.weights()[i] = w;
+    }
+
+    tensor_t in(2, vec_t(c.w * c.h * 3));
+    tensor_t out_grad(2, vec_t(internal.out_shape()[0].size()));
+    for (auto &sample : in) uniform_rand(sample.begin(), sample.end(), -1, 1);
+    for (auto &sample : out_grad)
+      uniform_rand(sample.begin(), sample.end(), -1, 1);
+
+    std::vector<const tensor_t*> out_internal, out_avx;
+    internal.forward({in}, out_internal);
+    avx.forward({in}, out_avx);
+    std::vector<tensor_t> grad_internal = internal.backward({out_grad});
+    std::vector<tensor_t> grad_avx      = avx.backward({out_grad});
+
+    for (size_t s = 0; s < in.size(); s++) {
+      for (size_t i = 0; i < (*out_internal[0])[s].size(); i++) {
+        EXPECT_NEAR((*out_internal[0])[s][i], (*out_avx[0])[s][i], 1e-5);
+      }
+    }
+    for (size_t k = 0; k < grad_internal.size(); k++) {
+      for (size_t s = 0; s < in.size(); s++) {
+        for (size_t i = 0; i < grad_internal[k][s].size(); i++) {
+          EXPECT_NEAR(grad_internal[k][s][i], grad_avx[k][s][i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace tiny_dnn
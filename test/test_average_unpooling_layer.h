@@ -7,10 +7,7 @@
 */
 #pragma once
 
-#include <gtest/gtest.h>
-
-#include "test/testhelper.h"
-#include "tiny_dnn/tiny_dnn.h"
+#include <vector>
 
 namespace tiny_dnn {
 
@@ -52,7 +49,9 @@ TEST(ave_unpool, forward) {
   l.bias_init(weight_init::constant(0.0));
   l.init_weight();
 
-  vec_t res = l.forward({{in}})[0][0];
+  std::vector<const tensor_t*> out;
+  l.forward({{in}}, out);
+  vec_t res = (*out[0])[0];
 
   for (size_t i = 0; i < expected.size(); i++) {
     EXPECT_FLOAT_EQ(expected[i], res[i]);
@@ -81,20 +80,21 @@ TEST(ave_unpool, forward_stride) {
   l.bias_init(weight_init::constant(0.0));
   l.init_weight();
 
-  vec_t res = l.forward({{in}})[0][0];
+  std::vector<const tensor_t*> out;
+  l.forward({{in}}, out);
+  vec_t res = (*out[0])[0];
 
   for (size_t i = 0; i < expected.size(); i++) {
     EXPECT_FLOAT_EQ(expected[i], res[i]);
   }
 }
 
-TEST(ave_unpool, gradient_check) {
-  using loss_func  = cross_entropy;
-  using activation = sigmoid;
-  using network    = network<sequential>;
+TEST(ave_unpool, gradient_check2) {  // mse
+  using loss_func = mse;
+  using network   = network<sequential>;
 
   network nn;
-  nn << average_pooling_layer(4, 2, 1, 2);  // 4x2 => 2x1
+  nn << average_unpooling_layer(2, 1, 1, 2);  // 2x1 => 4x2
 
   const auto test_data = generate_gradient_check_data(nn.in_data_size());
   nn.init_weight();
@@ -113,4 +113,78 @@ TEST(ave_unpool, read_write) {
   serialization_test(l1, l2);
 }
 
+TEST(ave_unpool, backward) {
+  average_unpooling_layer l(2, 1, 1, 2);  // 2x1 => 4x2
+
+  // clang-format off
+    vec_t in = {1, 2};
+
+    vec_t out_grad = {
+        1, 2, 3, 4,
+        5, 6, 7, 8
+    };
+
+    // each input receives the sum of its window
+    vec_t in_grad_expected = {14, 22};
+  // clang-format on
+
+  l.weight_init(weight_init::constant(1.0));
+  l.bias_init(weight_init::constant(0.0));
+  l.init_weight();
+
+  std::vector<const tensor_t*> out;
+  l.forward({{in}}, out);
+  std::vector<tensor_t> grads = l.backward(std::vector<tensor_t>{{out_grad}});
+
+  for (size_t i = 0; i < in_grad_expected.size(); i++) {
+    EXPECT_FLOAT_EQ(in_grad_expected[i], grads[0][0][i]);
+  }
+  EXPECT_FLOAT_EQ(float_t(1 * 14 + 2 * 22), grads[1][0][0]);  // dW
+  EXPECT_FLOAT_EQ(float_t(36), grads[2][0][0]);               // db
+}
+
+TEST(ave_unpool, avx_equals_internal) {
+  struct {
+    size_t w, h, pool;
+  } configs[] = {{18, 3, 2}, {10, 2, 2}, {3, 3, 2}, {9, 3, 3}, {4, 2, 3}};
+
+  for (auto c : configs) {
+    average_unpooling_layer internal(c.w, c.h, 3, c.pool,
+                                     core::backend_t::internal);
+    average_unpooling_layer avx(c.w, c.h, 3, c.pool, core::backend_t::avx);
+    internal.setup(false);
+    avx.setup(false);
+    for (size_t i = 0; i < internal.weights().size(); i++) {
+      vec_t &w = *internal.weights()[i];
+      uniform_rand(w.begin(), w.end(), -1, 1);
+      *avx.weights()[i] = w;
+    }
+
+    tensor_t in(2, vec_t(c.w * c.h * 3));
+    tensor_t out_grad(2, vec_t(internal.out_shape()[0].size()));
+    for (auto &sample : in) uniform_rand(sample.begin(), sample.end(), -1, 1);
+    for (auto &sample : out_grad)
+      uniform_rand(sample.begin(), sample.end(), -1, 1);
+
+    std::vector<const tensor_t*> out_internal, out_avx;
+    internal.forward({in}, out_internal);
+    avx.forward({in}, out_avx);
+    std::vector<tensor_t> grad_internal = internal.backward({out_grad});
+    std::vector<tensor_t> grad_avx      = avx.backward({out_grad});
+
+    for (size_t s = 0; s < in.size(); s++) {
+      for (size_t i = 0; i < (*out_internal[0])[s].size(); i++) {
+        EXPECT_NEAR((*out_internal[0])[s][i], (*out_avx[0])[s][i], 1e-5);
+      }
+    }
+    for (size_t k = 0; k < grad_internal.size(); k++) {
+      for (size_t s = 0; s < in.size(); s++) {
+        for (size_t i = 0; i < grad_internal[k][s].size(); i++) {
+          EXPECT_NEAR(grad_internal[k][s][i], grad_avx[k][s][i], 1e-4);
+        }
+      }
+    }
+  }
+}
+
 }  // namespace tiny_dnn
@@ -257,4 +257,40 @@ TEST(batchnorm, read_write) {
   serialization_test(l1, l2);
 }
 
+TEST(batchnorm, fold_into_previous_layer) {
+  network<sequential> nn;
+  convolutional_layer c1(8, 8, 3, 2, 4, padding::valid, /*has_bias=*/false);
+  batch_normalization_layer bn1(c1, 1e-5, 0.999, net_phase::test);
+  fully_connected_layer f1(6 * 6 * 4, 10);
+  batch_normalization_layer bn2(f1, 1e-5, 0.999, net_phase::test);
+  batch_normalization_layer bn3(1, 10, 1e-5, 0.999, net_phase::test);
+
+  nn << c1 << bn1 << relu() << f1 << bn2 << tanh_layer()
+     << fully_connected_layer(10, 10) << bn3 << fully_connected_layer(10, 3);
+  nn.init_weight();
+
+  auto random_stats = [](batch_normalization_layer &bn, size_t channels) {
+    vec_t mean(channels), variance(channels);
+    uniform_rand(mean.begin(), mean.end(), -1.0, 1.0);
+    uniform_rand(variance.begin(), variance.end(), 0.1, 2.0);
+    bn.set_mean(mean);
+    bn.set_variance(variance);
+  };
+  random_stats(bn1, 4);
+  random_stats(bn2, 1);
+  random_stats(bn3, 10);
+
+  vec_t in(8 * 8 * 2);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  const vec_t before = nn.predict(in);
+
+  nn.fold_batch_normalization();
+  EXPECT_EQ(nn.layer_size(), size_t(6));
+
+  const vec_t after = nn.predict(in);
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_NEAR(before[i], after[i], 1e-5);
+  }
+}
+
 }  // namespace tiny_dnn
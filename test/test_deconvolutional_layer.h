@@ -191,6 +191,81 @@ TEST(deconvolutional, fprop2) {
   }
 }
 
+TEST(deconvolutional, gemm_matches_direct) {
+  // 3 in-channels x 4 out-channels, in-channel 1 is not connected to
+  // out-channels 0 and 2
+  static const bool connection[] = {true, true,  true, true,   // NOLINT
+                                    false, true, false, true,  // NOLINT
+                                    true, true,  true, false};
+  core::deconv_params params;
+  params.tbl          = core::connection_table(connection, 3, 4);
+  params.in           = shape3d(5, 4, 3);
+  params.weight       = shape3d(3, 2, 12);
+  params.w_stride     = 2;
+  params.h_stride     = 3;
+  params.out          = shape3d((5 - 1) * 2 + 3, (4 - 1) * 3 + 2, 4);
+  params.out_unpadded = params.out;
+  params.has_bias     = true;
+  params.pad_type     = padding::valid;
+
+  tensor_t in(2, vec_t(params.in.size())), out(2, vec_t(params.out.size()));
+  tensor_t curr_delta(2, vec_t(params.out.size()));
+  vec_t W(params.weight.size()), bias(4);
+  for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  for (auto &v : curr_delta) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+  uniform_rand(W.begin(), W.end(), -1.0, 1.0);
+  uniform_rand(bias.begin(), bias.end(), -1.0, 1.0);
+
+  // direct scatter / gather reference
+  tensor_t out_ref(2, vec_t(params.out.size()));
+  tensor_t prev_delta_ref(2, vec_t(params.in.size()));
+  vec_t dW_ref(params.weight.size());
+  for (size_t s = 0; s < 2; s++) {
+    for (size_t o = 0; o < 4; o++) {
+      for (size_t i = 0; i < params.out.area(); i++) {
+        out_ref[s][params.out.get_index(0, 0, o) + i] = bias[o];
+      }
+      for (size_t c = 0; c < 3; c++) {
+        if (!params.tbl.is_connected(o, c)) continue;
+        for (size_t y = 0; y < 4; y++) {
+          for (size_t x = 0; x < 5; x++) {
+            for (size_t wy = 0; wy < 2; wy++) {
+              for (size_t wx = 0; wx < 3; wx++) {
+                const size_t oi =
+                  params.out.get_index(x * 2 + wx, y * 3 + wy, o);
+                const size_t wi = params.weight.get_index(wx, wy, o * 3 + c);
+                const size_t ii = params.in.get_index(x, y, c);
+                out_ref[s][oi] += W[wi] * in[s][ii];
+                prev_delta_ref[s][ii] += W[wi] * curr_delta[s][oi];
+                dW_ref[wi] += in[s][ii] * curr_delta[s][oi];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  core::kernels::tiny_deconv2d_kernel(params, in, W, bias, out, false);
+
+  tensor_t dW(2, vec_t(params.weight.size())), db(2, vec_t(4));
+  tensor_t prev_delta(2, vec_t(params.in.size()));
+  core::kernels::tiny_deconv2d_back_kernel(params, in, W, dW, db, curr_delta,
+                                           &prev_delta);
+
+  for (size_t s = 0; s < 2; s++) {
+    for (size_t i = 0; i < params.out.size(); i++) {
+      EXPECT_NEAR(out_ref[s][i], out[s][i], 1e-5);
+    }
+    for (size_t i = 0; i < params.in.size(); i++) {
+      EXPECT_NEAR(prev_delta_ref[s][i], prev_delta[s][i], 1e-5);
+    }
+  }
+  for (size_t i = 0; i < params.weight.size(); i++) {
+    EXPECT_NEAR(dW_ref[i], dW[0][i] + dW[1][i], 1e-5);
+  }
+}
+
 /*
 TEST(deconvolutional, gradient_check) {
   const size_t in_width = 2;
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace tiny_dnn {
+
+TEST(fake_quantize, forward_backward) {
+  fake_quantize_layer l(shape3d(4, 1, 1), 0.5);
+  std::vector<tensor_t> in = {{{-1, 0.3, 2, 0.5}}}, out = in;
+  std::vector<tensor_t *> in_ = tensor2ptr(in), out_ = tensor2ptr(out);
+
+  // the first batch gives the range
+  l.forward_propagation(in_, out_);
+  EXPECT_FLOAT_EQ(float_t(-1), l.range().first);
+  EXPECT_FLOAT_EQ(float_t(2), l.range().second);
+  const float_t step = float_t(3) / 255;
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_NEAR(in[0][0][i], out[0][0][i], step / 2 + 1e-6);
+  }
+
+  // the next ones move it by their moving average
+  in[0][0] = {-3, 0, -2, -1};
+  l.forward_propagation(in_, out_);
+  EXPECT_FLOAT_EQ(float_t(-2), l.range().first);
+  EXPECT_FLOAT_EQ(float_t(1), l.range().second);
+
+  // the range is fixed in the test phase, and clamps the input
+  l.set_context(net_phase::test);
+  in[0][0] = {3, -4, 0, 0.5};
+  l.forward_propagation(in_, out_);
+  EXPECT_FLOAT_EQ(float_t(-2), l.range().first);
+  EXPECT_NEAR(float_t(1), out[0][0][0], 1e-6);
+  EXPECT_NEAR(float_t(-2), out[0][0][1], 1e-6);
+
+  // straight-through inside the range, 0 outside
+  std::vector<tensor_t> out_grad = {{{1, 1, 1, 1}}}, in_grad = in;
+  std::vector<tensor_t *> out_grad_ = tensor2ptr(out_grad);
+  std::vector<tensor_t *> in_grad_  = tensor2ptr(in_grad);
+  l.back_propagation(in_, out_, out_grad_, in_grad_);
+  const vec_t expected = {0, 0, 1, 1};
+  for (size_t i = 0; i < 4; i++) {
+    EXPECT_FLOAT_EQ(expected[i], in_grad[0][0][i]);
+  }
+}
+
+TEST(fake_quantize, train_and_export) {
+  network<sequential> net;
+  net << fake_quantize_layer(shape3d(16, 1, 1)) << fully_connected_layer(16, 8)
+      << relu() << fake_quantize_layer(shape3d(8, 1, 1))
+      << fully_connected_layer(8, 2);
+  for (size_t i : {1, 4}) {
+    dynamic_cast<fully_connected_layer *>(net[i])->set_fake_quantization(true);
+  }
+
+  std::vector<vec_t> inputs(64, vec_t(16));
+  std::vector<vec_t> targets(64, vec_t(2));
+  for (size_t i = 0; i < inputs.size(); i++) {
+    uniform_rand(inputs[i].begin(), inputs[i].end(), -1.0, 1.0);
+    targets[i][0] = inputs[i][0] + inputs[i][1];
+    targets[i][1] = inputs[i][2] - inputs[i][3];
+  }
+  adagrad opt;
+  net.fit<mse>(opt, inputs, targets, 16, 5);
+
+  // the float weights were updated, not their rounded values
+  vec_t W = *net[1]->weights()[0];
+  core::kernels::fake_quantize_filter_per_channel(W, 8, 1, 8);
+  EXPECT_FALSE(W == *net[1]->weights()[0]);
+
+  network<sequential> qnet = export_quantized(net);
+  ASSERT_EQ(size_t(3), qnet.depth());
+  EXPECT_EQ("q_fully-connected", qnet[0]->layer_type());
+  EXPECT_EQ("q_fully-connected", qnet[2]->layer_type());
+
+  net.set_netphase(net_phase::test);
+  for (size_t i = 0; i < 8; i++) {
+    const vec_t expected = net.predict(inputs[i]);
+    const vec_t actual   = qnet.predict(inputs[i]);
+    for (size_t j = 0; j < expected.size(); j++) {
+      EXPECT_NEAR(expected[j], actual[j], 5e-2);
+    }
+  }
+}
+
+TEST(fake_quantize, conv_weights) {
+  convolutional_layer l(5, 5, 3, 2, 3);
+  l.weight_init(weight_init::xavier());
+  l.init_weight();
+  const vec_t W = *l.weights()[0];
+
+  vec_t in(50);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  std::vector<const tensor_t *> o;
+  l.set_fake_quantization(true);
+  l.forward({{in}}, o);
+  const vec_t fake = (*o[0])[0];
+  EXPECT_TRUE(W == *l.weights()[0]);
+
+  // the same as the rounded weights of each output channel
+  core::kernels::fake_quantize_filter_per_channel(*l.weights()[0], 3, 18, 1);
+  l.set_fake_quantization(false);
+  l.forward({{in}}, o);
+  for (size_t i = 0; i < fake.size(); i++) {
+    EXPECT_FLOAT_EQ(fake[i], (*o[0])[0][i]);
+  }
+}
+
+TEST(fake_quantize, read_write) {
+  fake_quantize_layer l(shape3d(3, 2, 1), 0.9, net_phase::test);
+  l.set_range(-0.5, 1.5);
+
+  std::shared_ptr<layer> copy = detail::clone_layer(l);
+  auto fq = std::dynamic_pointer_cast<fake_quantize_layer>(copy);
+  ASSERT_TRUE(fq != nullptr);
+  EXPECT_FLOAT_EQ(float_t(-0.5), fq->range().first);
+  EXPECT_FLOAT_EQ(float_t(1.5), fq->range().second);
+  EXPECT_FLOAT_EQ(float_t(0.9), fq->momentum());
+  EXPECT_EQ(l.in_shape()[0], fq->in_shape()[0]);
+}
+
+}  // namespace tiny_dnn
@@ -117,4 +117,79 @@ TEST(fully_connected, forward_nobias) {
   }
 }
 
+TEST(fully_connected, low_rank_by_rank) {
+  fully_connected_layer l(30, 20);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::xavier());
+  l.init_weight();
+  const vec_t &W = *l.weights()[0];
+
+  // the product of the factors is within the reported error of W
+  low_rank_factors f = factorize_by_rank(l, 5);
+  EXPECT_EQ(size_t(5), f.rank);
+  const vec_t &W1 = *f.first->weights()[0];
+  const vec_t &W2 = *f.second->weights()[0];
+  double diff = 0, norm = 0;
+  for (size_t c = 0; c < 30; c++) {
+    for (size_t i = 0; i < 20; i++) {
+      double w = 0;
+      for (size_t j = 0; j < 5; j++) w += W1[c * 5 + j] * W2[j * 20 + i];
+      diff += (W[c * 20 + i] - w) * (W[c * 20 + i] - w);
+      norm += W[c * 20 + i] * W[c * 20 + i];
+    }
+  }
+  EXPECT_NEAR(std::sqrt(diff / norm), f.error, 1e-3);
+  EXPECT_GE(f.error, float_t(0.1));
+  EXPECT_TRUE(*l.weights()[1] == *f.second->weights()[1]);
+
+  // the full rank is exact
+  EXPECT_NEAR(0.0, factorize_by_rank(l, 20).error, 1e-4);
+  EXPECT_LT(factorize_by_rank(l, 10).error, f.error);
+  EXPECT_THROW(factorize_by_rank(l, 21), nn_error);
+}
+
+TEST(fully_connected, low_rank_by_error) {
+  // weights of rank 3
+  fully_connected_layer l(40, 24);
+  vec_t &W = *l.weights()[0];
+  std::fill(W.begin(), W.end(), float_t{0});
+  for (size_t j = 0; j < 3; j++) {
+    vec_t a(40), b(24);
+    uniform_rand(a.begin(), a.end(), -1.0, 1.0);
+    uniform_rand(b.begin(), b.end(), -1.0, 1.0);
+    for (size_t c = 0; c < 40; c++) {
+      for (size_t i = 0; i < 24; i++) W[c * 24 + i] += a[c] * b[i];
+    }
+  }
+  uniform_rand(l.weights()[1]->begin(), l.weights()[1]->end(), -1.0, 1.0);
+
+  low_rank_factors f = factorize_by_error(l, 1e-3);
+  EXPECT_EQ(size_t(3), f.rank);
+  EXPECT_EQ(size_t(40 * 3), f.first->weights()[0]->size());
+  EXPECT_EQ(size_t(1), f.first->weights().size());
+
+  network<sequential> net;
+  net << fully_connected_layer(40, 24) << relu()
+      << fully_connected_layer(24, 4);
+  net.init_weight();
+  *net[0]->weights()[0] = W;
+  *net[0]->weights()[1] = *l.weights()[1];
+
+  // only the first layer has fewer weights once factorized
+  network<sequential> fnet = factorize_fully_connected(net, 1e-3);
+  ASSERT_EQ(size_t(4), fnet.depth());
+  EXPECT_EQ(size_t(3), fnet[0]->out_data_size());
+
+  vec_t x(40);
+  uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+  const vec_t expected = net.predict(x);
+  const vec_t actual   = fnet.predict(x);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(expected[i], actual[i], 1e-4);
+  }
+
+  net.fuse_activations();
+  EXPECT_THROW(factorize_fully_connected(net, 1e-3), nn_error);
+}
+
 }  // namespace tiny_dnn
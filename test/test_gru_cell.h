@@ -18,10 +18,9 @@ TEST(gru, blackbox_gradient_check) {
   auto l                = recurrent_layer(gru(in_size, out_size), 1);
   l.reset_state(false);
   std::vector<tensor_t> input_data = generate_test_data(
-    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-    {in_size, out_size, in_size * out_size, in_size * out_size,
-     in_size * out_size, out_size * out_size, out_size * out_size,
-     out_size * out_size, out_size, out_size, out_size});
+    {1, 1, 1, 1, 1, 1},
+    {in_size, out_size, 3 * in_size * out_size, out_size * out_size,
+     2 * out_size * out_size, 3 * out_size});
   std::vector<tensor_t> in_grad  = input_data;  // copy constructor
   std::vector<tensor_t> out_data = generate_test_data(
     {1, 1, 1, 1, 1, 1, 1},
@@ -43,6 +42,69 @@ TEST(gru, blackbox_gradient_check) {
   }
 }
 
+TEST(gru, forward_batch) {
+  const size_t batch_size = 3;
+  const size_t seq_len    = 2;
+  recurrent_layer l(gru(6, 4), seq_len);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::constant(0.1));
+
+  // rows are ordered as (timestep, sample)
+  tensor_t batch(seq_len * batch_size, vec_t(6));
+  for (auto &row : batch) uniform_rand(row.begin(), row.end(), -1, 1);
+
+  std::vector<const tensor_t *> o;
+  l.forward({batch}, o);
+  const tensor_t batch_out = *o[0];
+
+  for (size_t sample = 0; sample < batch_size; sample++) {
+    l.forward({{batch[sample], batch[batch_size + sample]}}, o);
+    for (size_t t = 0; t < seq_len; t++) {
+      for (size_t k = 0; k < 4; k++) {
+        EXPECT_NEAR(batch_out[t * batch_size + sample][k], (*o[0])[t][k],
+                    1e-5);
+      }
+    }
+  }
+}
+
+TEST(gru, variable_length) {
+  const size_t batch_size        = 3;
+  const size_t seq_len           = 4;
+  const std::vector<size_t> lens = {4, 2, 1};
+  recurrent_layer l(gru(5, 3), seq_len);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::constant(0.1));
+
+  tensor_t batch(seq_len * batch_size, vec_t(5));
+  for (auto &row : batch) uniform_rand(row.begin(), row.end(), -1, 1);
+
+  std::vector<const tensor_t *> o;
+  l.seq_lengths(lens);
+  l.forward({batch}, o);
+  const tensor_t batch_out = *o[0];
+
+  // each sample matches its own sequence, and outputs zero once it ended
+  l.seq_lengths({});
+  for (size_t sample = 0; sample < batch_size; sample++) {
+    tensor_t seq;
+    for (size_t t = 0; t < lens[sample]; t++) {
+      seq.push_back(batch[t * batch_size + sample]);
+    }
+    l.seq_len(lens[sample]);
+    l.clear_state();
+    l.forward({seq}, o);
+    for (size_t t = 0; t < seq_len; t++) {
+      for (size_t k = 0; k < 3; k++) {
+        EXPECT_NEAR(batch_out[t * batch_size + sample][k],
+                    t < lens[sample] ? (*o[0])[t][k] : float_t{0}, 1e-5);
+      }
+    }
+  }
+
+  EXPECT_THROW(l.seq_lengths({1, 2, 1}), nn_error);
+}
+
 TEST(gru, read_write) {
   recurrent_layer l1(gru(100, 100), 1);
   recurrent_layer l2(gru(100, 100), 1);
@@ -0,0 +1,129 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace tiny_dnn {
+
+TEST(half_precision, conversion) {
+  using kernels::float_to_fp16;
+  using kernels::fp16_to_float;
+
+  EXPECT_EQ(0x3c00, float_to_fp16(1.0f));
+  EXPECT_EQ(0xc000, float_to_fp16(-2.0f));
+  EXPECT_EQ(0x8000, float_to_fp16(-0.0f));
+  EXPECT_EQ(0x7bff, float_to_fp16(65504.0f));  // largest half
+  EXPECT_EQ(0x7c00, float_to_fp16(65520.0f));  // rounds up to infinity
+  EXPECT_EQ(0xfc00, float_to_fp16(-1e10f));
+  EXPECT_EQ(0x0001, float_to_fp16(std::ldexp(1.0f, -24)));  // subnormal
+  EXPECT_EQ(0x0000, float_to_fp16(std::ldexp(1.0f, -25)));  // tie to even
+  EXPECT_EQ(0x0001, float_to_fp16(std::ldexp(1.5f, -25)));
+  EXPECT_EQ(0x0002, float_to_fp16(std::ldexp(3.0f, -25)));
+  EXPECT_EQ(0x3c00, float_to_fp16(1.0f + std::ldexp(1.0f, -11)));
+  EXPECT_EQ(0x3c02, float_to_fp16(1.0f + std::ldexp(3.0f, -11)));
+  EXPECT_TRUE(std::isnan(
+    fp16_to_float(float_to_fp16(std::numeric_limits<float>::quiet_NaN()))));
+
+  // every finite half survives the round trip
+  for (uint32_t h = 0; h < 0x10000u; h++) {
+    if ((h & 0x7c00u) == 0x7c00u) continue;
+    const kernels::fp16_t x = static_cast<kernels::fp16_t>(h);
+    EXPECT_EQ(x, float_to_fp16(fp16_to_float(x)));
+  }
+
+  // the bulk conversions agree with the scalar ones
+  vec_t v(37);
+  uniform_rand(v.begin(), v.end(), -100.0, 100.0);
+  const std::vector<kernels::fp16_t> h = kernels::to_fp16(v);
+  const vec_t back                     = kernels::from_fp16(h);
+  for (size_t i = 0; i < v.size(); i++) {
+    EXPECT_EQ(float_to_fp16(static_cast<float>(v[i])), h[i]);
+    EXPECT_EQ(fp16_to_float(h[i]), back[i]);
+    EXPECT_NEAR(v[i], back[i], std::abs(v[i]) * 1e-3);
+  }
+}
+
+TEST(half_precision, fully_connected_forward) {
+  fully_connected_layer l(37, 13);
+  init_random_weights(l);
+
+  half_fully_connected_layer h(l);
+  EXPECT_EQ(size_t(37 * 13), h.half_weights().size());
+  expect_same_forward(l, h, 2e-3);
+  EXPECT_THROW(half_fully_connected_layer(37, 12, h.half_weights(), h.bias()),
+               nn_error);
+}
+
+TEST(half_precision, convolutional_forward) {
+  for (padding pad : {padding::valid, padding::same}) {
+    convolutional_layer l(9, 7, 3, 2, 4, pad, true, 2, 1);
+    init_random_weights(l);
+
+    half_convolutional_layer h(l);
+    ASSERT_TRUE(l.out_shape()[0] == h.out_shape()[0]);
+    expect_same_forward(l, h, 2e-3);
+  }
+}
+
+TEST(half_precision, to_half_precision) {
+  network<sequential> net;
+  net << convolutional_layer(6, 6, 3, 1, 3, padding::same, false) << relu()
+      << fully_connected_layer(108, 5);
+  net.weight_init(weight_init::xavier());
+  net.bias_init(weight_init::xavier());
+  net.init_weight();
+
+  network<sequential> hnet = to_half_precision(net);
+  ASSERT_EQ(net.depth(), hnet.depth());
+  EXPECT_EQ("half-conv", hnet[0]->layer_type());
+  EXPECT_EQ("relu-activation", hnet[1]->layer_type());
+  EXPECT_EQ("half-fully-connected", hnet[2]->layer_type());
+
+  vec_t in(36);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  const vec_t expected = net.predict(in);
+  const vec_t actual   = hnet.predict(in);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(expected[i], actual[i], 1e-2);
+  }
+
+  net.fuse_activations();
+  EXPECT_THROW(to_half_precision(net), nn_error);
+}
+
+TEST(half_precision, read_write) {
+  fully_connected_layer fc(10, 6, false);
+  fc.weight_init(weight_init::xavier());
+  fc.init_weight();
+  half_fully_connected_layer hfc(fc);
+
+  auto fc_copy = std::dynamic_pointer_cast<half_fully_connected_layer>(
+    detail::clone_layer(hfc));
+  ASSERT_TRUE(fc_copy != nullptr);
+  EXPECT_TRUE(hfc.half_weights() == fc_copy->half_weights());
+  EXPECT_TRUE(fc_copy->bias().empty());
+
+  convolutional_layer conv(7, 5, 3, 2, 3, padding::same, true, 1, 2);
+  conv.weight_init(weight_init::xavier());
+  conv.bias_init(weight_init::xavier());
+  conv.init_weight();
+  half_convolutional_layer hconv(conv);
+
+  auto conv_copy = std::dynamic_pointer_cast<half_convolutional_layer>(
+    detail::clone_layer(hconv));
+  ASSERT_TRUE(conv_copy != nullptr);
+  EXPECT_TRUE(hconv.half_weights() == conv_copy->half_weights());
+  EXPECT_TRUE(hconv.bias() == conv_copy->bias());
+  EXPECT_TRUE(hconv.out_shape()[0] == conv_copy->out_shape()[0]);
+}
+
+}  // namespace tiny_dnn
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <functional>
+#include <numeric>
 #include <vector>
 
 namespace tiny_dnn {
@@ -18,11 +19,8 @@ TEST(lstm, blackbox_gradient_check) {
   auto l                = recurrent_layer(lstm(in_size, out_size), 1);
   l.reset_state(false);
   std::vector<tensor_t> input_data = generate_test_data(
-    {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1},
-    {in_size, out_size, out_size, in_size * out_size, in_size * out_size,
-     in_size * out_size, in_size * out_size, out_size * out_size,
-     out_size * out_size, out_size * out_size, out_size * out_size, out_size,
-     out_size, out_size, out_size});
+    {1, 1, 1, 1, 1, 1}, {in_size, out_size, out_size, 4 * in_size * out_size,
+                         4 * out_size * out_size, 4 * out_size});
   std::vector<tensor_t> in_grad  = input_data;  // copy constructor
   std::vector<tensor_t> out_data = generate_test_data(
     {1, 1, 1, 1, 1, 1, 1},
@@ -44,6 +42,131 @@ TEST(lstm, blackbox_gradient_check) {
   }
 }
 
+TEST(lstm, forward_batch) {
+  const size_t batch_size = 3;
+  const size_t seq_len    = 2;
+  recurrent_layer l(lstm(6, 4), seq_len);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::constant(0.1));
+
+  // rows are ordered as (timestep, sample)
+  tensor_t batch(seq_len * batch_size, vec_t(6));
+  for (auto &row : batch) uniform_rand(row.begin(), row.end(), -1, 1);
+
+  std::vector<const tensor_t *> o;
+  l.forward({batch}, o);
+  const tensor_t batch_out = *o[0];
+
+  // the batched GEMMs must give every sample the result of its own sequence
+  for (size_t sample = 0; sample < batch_size; sample++) {
+    l.forward({{batch[sample], batch[batch_size + sample]}}, o);
+    for (size_t t = 0; t < seq_len; t++) {
+      for (size_t k = 0; k < 4; k++) {
+        EXPECT_NEAR(batch_out[t * batch_size + sample][k], (*o[0])[t][k],
+                    1e-5);
+      }
+    }
+  }
+}
+
+TEST(lstm, sequence_gradient_check) {
+  const size_t batch_size = 2;
+  const size_t seq_len    = 3;
+  const size_t rows       = seq_len * batch_size;
+  recurrent_layer l(lstm(3, 4), seq_len);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::constant(0.1));
+  l.setup(false);
+
+  // weights are shared by every row, the states start at zero
+  std::vector<tensor_t> in(6), out(7);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i].assign(rows, vec_t(l.in_shape()[i].size()));
+    if (i == 1 || i == 2) continue;
+    uniform_rand(in[i][0].begin(), in[i][0].end(), -0.5, 0.5);
+    for (size_t r = 1; r < rows; r++) {
+      if (i == 0) {
+        uniform_rand(in[i][r].begin(), in[i][r].end(), -0.5, 0.5);
+      } else {
+        in[i][r] = in[i][0];
+      }
+    }
+  }
+  for (auto &t : out) t.assign(rows, vec_t(4));
+  std::vector<tensor_t> out_grad = out, in_grad = in;
+  for (auto &t : in_grad) fill_tensor(t, 0.0);
+  fill_tensor(out_grad[0], 1.0);  // loss = sum of the outputs of all steps
+
+  std::vector<tensor_t *> in_ = tensor2ptr(in), out_ = tensor2ptr(out);
+  std::vector<tensor_t *> out_grad_ = tensor2ptr(out_grad);
+  std::vector<tensor_t *> in_grad_  = tensor2ptr(in_grad);
+  auto loss = [&]() {
+    l.forward_propagation(in_, out_);
+    float_t sum = 0;
+    for (auto &row : out[0]) {
+      sum += std::accumulate(row.begin(), row.end(), float_t{0});
+    }
+    return sum;
+  };
+  loss();
+  l.back_propagation(in_, out_, out_grad_, in_grad_);
+
+  // gradients reaching through the state of the earlier steps
+  const float_t h = 1e-2;
+  for (size_t k = 0; k < 3; k++) {
+    in[0][0][k] += h;
+    const float_t plus = loss();
+    in[0][0][k] -= 2 * h;
+    const float_t minus = loss();
+    in[0][0][k] += h;
+    EXPECT_NEAR((plus - minus) / (2 * h), in_grad[0][0][k], 1e-2);
+  }
+  for (size_t k = 0; k < 16; k++) {
+    float_t dW = 0;
+    for (size_t r = 0; r < rows; r++) dW += in_grad[4][r][k];
+    for (auto &row : in[4]) row[k] += h;
+    const float_t plus = loss();
+    for (auto &row : in[4]) row[k] -= 2 * h;
+    const float_t minus = loss();
+    for (auto &row : in[4]) row[k] += h;
+    EXPECT_NEAR((plus - minus) / (2 * h), dW, 1e-2);
+  }
+}
+
+TEST(lstm, step) {
+  const size_t streams = 3;
+  const size_t seq_len = 4;
+  recurrent_layer l(lstm(5, 4), seq_len);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::constant(0.1));
+
+  tensor_t batch(seq_len * streams, vec_t(5));
+  for (auto &row : batch) uniform_rand(row.begin(), row.end(), -1, 1);
+
+  std::vector<const tensor_t *> o;
+  l.forward({batch}, o);
+  const tensor_t batch_out = *o[0];
+
+  // advancing the streams step by step gives the outputs of the sequences
+  recurrent_state st = l.make_state(streams);
+  for (size_t t = 0; t < seq_len; t++) {
+    const tensor_t x(batch.begin() + t * streams,
+                     batch.begin() + (t + 1) * streams);
+    const tensor_t &y = l.step(x, st);
+    for (size_t b = 0; b < streams; b++) {
+      for (size_t k = 0; k < 4; k++) {
+        EXPECT_NEAR(batch_out[t * streams + b][k], y[b][k], 1e-5);
+      }
+    }
+  }
+
+  st.clear();
+  const tensor_t x(batch.begin(), batch.begin() + streams);
+  const tensor_t &y = l.step(x, st);
+  EXPECT_NEAR(batch_out[0][0], y[0][0], 1e-5);
+  EXPECT_THROW(l.step(tensor_t(2, vec_t(5)), st), nn_error);
+}
+
 TEST(lstm, read_write) {
   recurrent_layer l1(lstm(100, 100), 1);
   recurrent_layer l2(lstm(100, 100), 1);
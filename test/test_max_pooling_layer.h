@@ -280,6 +280,79 @@ TEST(max_pool, backward) {
   }
 }
 
+TEST(max_pool, backward_overlapping) {
+  // 2x2 windows with stride 1: inputs shared by several windows receive the
+  // sum of their gradients
+  max_pooling_layer l(3, 3, 1, 2, 2, 1, 1);
+  // clang-format off
+    vec_t in = {
+        0, 1, 0,
+        1, 9, 1,
+        0, 1, 0
+    };
+
+    vec_t out_grad = {
+        1, 2,
+        3, 4
+    };
+
+    vec_t in_grad_expected = {
+        0, 0,  0,
+        0, 10, 0,
+        0, 0,  0
+    };
+  // clang-format on
+
+  std::vector<const tensor_t*> out;
+  l.forward({{in}}, out);
+  vec_t in_grad = l.backward(std::vector<tensor_t>{{out_grad}})[0][0];
+
+  for (size_t i = 0; i < in_grad.size(); i++) {
+    EXPECT_FLOAT_EQ(in_grad_expected[i], in_grad[i]);
+  }
+}
+
+TEST(max_pool, avx_equals_internal) {
+  struct {
+    size_t w, h, pool_x, pool_y, stride_x, stride_y;
+  } configs[] = {{37, 11, 2, 2, 2, 2}, {40, 9, 3, 3, 2, 2},
+                 {29, 7, 3, 3, 1, 1}, {23, 6, 2, 3, 1, 2},
+                 {33, 8, 3, 3, 3, 3}, {18, 5, 2, 2, 2, 2}};
+
+  for (auto c : configs) {
+    max_pooling_layer internal(c.w, c.h, 3, c.pool_x, c.pool_y, c.stride_x,
+                               c.stride_y, false, padding::valid,
+                               core::backend_t::internal);
+    max_pooling_layer avx(c.w, c.h, 3, c.pool_x, c.pool_y, c.stride_x,
+                          c.stride_y, false, padding::valid,
+                          core::backend_t::avx);
+
+    tensor_t in(2, vec_t(c.w * c.h * 3));
+    for (auto &sample : in) uniform_rand(sample.begin(), sample.end(), -1, 1);
+    // ties must resolve to the first maximum on both backends
+    in[1][5] = in[1][6] = in[1][c.w + 5] = 2;
+
+    tensor_t out_grad(2, vec_t(internal.out_shape()[0].size()));
+    for (auto &sample : out_grad)
+      uniform_rand(sample.begin(), sample.end(), -1, 1);
+
+    std::vector<const tensor_t*> out_internal, out_avx;
+    internal.forward({in}, out_internal);
+    avx.forward({in}, out_avx);
+    std::vector<tensor_t> grad_internal = internal.backward({out_grad});
+    std::vector<tensor_t> grad_avx      = avx.backward({out_grad});
+
+    for (size_t s = 0; s < in.size(); s++) {
+      for (size_t i = 0; i < (*out_internal[0])[s].size(); i++) {
+        EXPECT_EQ((*out_internal[0])[s][i], (*out_avx[0])[s][i]);
+      }
+      for (size_t i = 0; i < in[s].size(); i++) {
+        EXPECT_EQ(grad_internal[0][s][i], grad_avx[0][s][i]);
+      }
+    }
+  }
+}
+
 #ifndef CNN_NO_SERIALIZATION
 TEST(max_pool, serialization) {
   max_pooling_layer src(4, 4, 1, 2);
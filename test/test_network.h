@@ -721,4 +721,195 @@ TEST(network, trainable) {
   EXPECT_NE(w4, w4_after_update);
 }
 
+TEST(network, fuse_activations) {
+  network<sequential> nn;
+  nn << fully_connected_layer(10, 14 * 14 * 3) << activation::tanh()
+     << convolutional_layer(14, 14, 5, 3, 6) << activation::tanh()
+     << average_pooling_layer(10, 10, 6, 2) << sigmoid()
+     << fully_connected_layer(5 * 5 * 6, 8) << selu()
+     << fully_connected_layer(8, 3) << softmax();
+
+  const auto test_data = generate_gradient_check_data(nn.in_data_size());
+  nn.init_weight();
+  const vec_t before = nn.predict(test_data.first[0][0]);
+
+  nn.fuse_activations();
+
+  // both tanh are fused; sigmoid follows a pooling layer, selu needs its
+  // input for the gradient and softmax is not elementwise
+  EXPECT_EQ(nn.layer_size(), size_t(8));
+  EXPECT_TRUE(nn[0]->fused_activation() != nullptr);
+  EXPECT_TRUE(nn[1]->fused_activation() != nullptr);
+  EXPECT_TRUE(nn[4]->fused_activation() == nullptr);
+  EXPECT_TRUE(nn[6]->fused_activation() == nullptr);
+
+  const vec_t after = nn.predict(test_data.first[0][0]);
+  ASSERT_EQ(before.size(), after.size());
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_NEAR(before[i], after[i], 1e-6);
+  }
+
+  EXPECT_TRUE(nn.gradient_check<cross_entropy_multiclass>(
+    test_data.first, test_data.second, epsilon<float_t>(), GRAD_CHECK_RANDOM));
+}
+
+// an activation fused into the preceding layer runs in place, so it must
+// give the same output and gradients as the unfused one
+template <typename Activation>
+void check_fused_activation(Activation act) {
+  network<sequential> nn;
+  nn << fully_connected_layer(4, 6) << act;
+  nn.weight_init(weight_init::xavier());
+  nn.bias_init(weight_init::xavier());
+  nn.init_weight();
+
+  std::vector<tensor_t> in(16, tensor_t(1, vec_t(4)));
+  std::vector<tensor_t> t(16, tensor_t(1, vec_t(6)));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i][0].begin(), in[i][0].end(), -3.0, 3.0);
+    uniform_rand(t[i][0].begin(), t[i][0].end(), -1.0, 1.0);
+  }
+
+  const std::vector<tensor_t> out = nn.fprop(in);
+  nn[0]->clear_grads();
+  nn.bprop<mse>(out, t, std::vector<tensor_t>());
+  const tensor_t grads = *nn[0]->weights_grads()[0];
+
+  nn.fuse_activations();
+  ASSERT_TRUE(nn[0]->fused_activation() != nullptr);
+  const std::vector<tensor_t> fused_out = nn.fprop(in);
+  nn[0]->clear_grads();
+  nn.bprop<mse>(fused_out, t, std::vector<tensor_t>());
+  const tensor_t &fused_grads = *nn[0]->weights_grads()[0];
+
+  for (size_t i = 0; i < out.size(); i++) {
+    for (size_t j = 0; j < out[i][0].size(); j++) {
+      EXPECT_NEAR(out[i][0][j], fused_out[i][0][j], 1e-5);
+    }
+  }
+  for (size_t i = 0; i < grads.size(); i++) {
+    for (size_t j = 0; j < grads[i].size(); j++) {
+      EXPECT_NEAR(grads[i][j], fused_grads[i][j], 1e-4);
+    }
+  }
+}
+
+TEST(network, fused_activations_match_unfused) {
+  check_fused_activation(relu());
+  check_fused_activation(leaky_relu());
+  check_fused_activation(elu());
+  check_fused_activation(sigmoid());
+  check_fused_activation(activation::tanh());
+  check_fused_activation(tanh_p1m2());
+  check_fused_activation(activation::asinh());
+  check_fused_activation(softplus());
+  // beta x crosses the threshold where x itself does not
+  check_fused_activation(softplus(float_t(2), float_t(4)));
+}
+
+TEST(network, prune_channels) {
+  network<sequential> nn;
+  nn << convolutional_layer(8, 8, 3, 2, 6, padding::same) << relu()
+     << max_pooling_layer(8, 8, 6, 2) << batch_normalization_layer(16, 6)
+     << convolutional_layer(4, 4, 3, 6, 3, padding::same) << leaky_relu()
+     << average_pooling_layer(4, 4, 3, 2) << fully_connected_layer(12, 5);
+  nn.weight_init(weight_init::xavier());
+  nn.bias_init(weight_init::xavier());
+  nn.init_weight();
+
+  // zero channels 1 and 4 of the first layer and 2 of the second one, so
+  // that they are the weakest ones and removing them changes nothing
+  vec_t &W0 = *nn[0]->weights()[0];
+  for (size_t c : {1, 4}) {
+    std::fill(W0.begin() + c * 18, W0.begin() + (c + 1) * 18, float_t{0});
+    (*nn[0]->weights()[1])[c] = 0;
+  }
+  vec_t &W4 = *nn[4]->weights()[0];
+  std::fill(W4.begin() + 2 * 54, W4.end(), float_t{0});
+  (*nn[4]->weights()[1])[2] = 0;
+  (*nn[6]->weights()[1])[2] = 0;
+
+  auto &bn = nn.at<batch_normalization_layer>(3);
+  bn.set_mean({0.5, 0, -0.2, 0.1, 0, 0.3});
+  bn.set_variance({1.5, 0.5, 2, 1, 0.7, 0.9});
+  nn.set_netphase(net_phase::test);
+
+  vec_t x(8 * 8 * 2);
+  uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+  const vec_t before = nn.predict(x);
+
+  EXPECT_EQ(size_t(3), nn.prune_channels(float_t(1) / 3));
+  EXPECT_EQ(shape3d(8, 8, 4), nn[0]->out_shape()[0]);
+  EXPECT_EQ(shape3d(4, 4, 4), nn[2]->out_shape()[0]);
+  EXPECT_EQ(size_t(4), bn.mean().size());
+  EXPECT_FLOAT_EQ(float_t(0.3), bn.mean()[3]);
+  EXPECT_EQ(shape3d(4, 4, 4), nn[4]->in_shape()[0]);
+  EXPECT_EQ(shape3d(4, 4, 2), nn[4]->out_shape()[0]);
+  EXPECT_EQ(shape3d(2, 2, 2), nn[6]->out_shape()[0]);
+  EXPECT_EQ(size_t(8), nn[7]->in_data_size());
+  EXPECT_EQ(size_t(8 * 5), nn[7]->weights()[0]->size());
+
+  const vec_t after = nn.predict(x);
+  ASSERT_EQ(before.size(), after.size());
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_NEAR(before[i], after[i], 1e-5);
+  }
+
+  // the pruned network can be fine-tuned
+  adagrad opt;
+  std::vector<vec_t> data(4, x), target(4, vec_t(5, 0.5));
+  nn.set_netphase(net_phase::train);
+  nn.fit<mse>(opt, data, target, 2, 1);
+  EXPECT_EQ(size_t(5), nn.predict(x).size());
+  EXPECT_THROW(nn.prune_channels(1), nn_error);
+}
+
+// same loss under another type, which goes through the softmax Jacobian
+struct unfused_cross_entropy : public cross_entropy_multiclass {};
+
+template <typename NetType>
+void check_fused_softmax(network<NetType> &nn, layer &fc) {
+  nn.init_weight();
+
+  std::vector<tensor_t> in(3, tensor_t(1, vec_t(6)));
+  std::vector<tensor_t> t(3, tensor_t(1, vec_t(4, 0)));
+  std::vector<tensor_t> cost(3, tensor_t(1, vec_t(4, 1)));
+  for (size_t i = 0; i < in.size(); i++) {
+    uniform_rand(in[i][0].begin(), in[i][0].end(), -1, 1);
+    t[i][0][i]    = 1;
+    cost[i][0][i] = 2;
+  }
+
+  for (const auto &c : {std::vector<tensor_t>(), cost}) {
+    const std::vector<tensor_t> out = nn.fprop(in);
+    fc.clear_grads();
+    nn.template bprop<cross_entropy_multiclass>(out, t, c);
+    const tensor_t fused = *fc.weights_grads()[0];
+    fc.clear_grads();
+    nn.template bprop<unfused_cross_entropy>(out, t, c);
+    const tensor_t unfused = *fc.weights_grads()[0];
+
+    for (size_t sample = 0; sample < fused.size(); sample++) {
+      for (size_t i = 0; i < fused[sample].size(); i++) {
+        EXPECT_NEAR(fused[sample][i], unfused[sample][i], 1e-5);
+      }
+    }
+  }
+}
+
+TEST(network, fused_softmax_cross_entropy) {
+  network<sequential> nn;
+  nn << fully_connected_layer(6, 4) << softmax();
+  check_fused_softmax(nn, *nn[0]);
+
+  // a graph finds its softmax among its output layers
+  auto in  = std::make_shared<input_layer>(shape3d(6, 1, 1));
+  auto fc  = std::make_shared<fully_connected_layer>(6, 4);
+  auto out = std::make_shared<softmax_layer>(4);
+  in << fc << out;
+  network<graph> g;
+  construct_graph(g, {in}, {out});
+  check_fused_softmax(g, *fc);
+}
+
 }  // namespace tiny_dnn
@@ -80,4 +80,84 @@ TEST(nodes, graph_branch2) {
   EXPECT_FLOAT_EQ(static_cast<float_t>(res[2]), static_cast<float_t>(0.0));
 }
 
+TEST(nodes, graph_fuse_activations) {
+  auto in   = std::make_shared<input_layer>(shape3d(8, 8, 1));
+  auto cnn  = std::make_shared<convolutional_layer>(8, 8, 3, 1, 4);
+  auto act1 = std::make_shared<relu>(6, 6, 4);
+  auto fc1  = std::make_shared<fully_connected_layer>(6 * 6 * 4, 5);
+  auto fc2  = std::make_shared<fully_connected_layer>(6 * 6 * 4, 5);
+  auto act2 = std::make_shared<sigmoid>(5);
+  auto add  = std::make_shared<layers::add>(2, 5);
+  auto out  = std::make_shared<activation::tanh>(5);
+  auto fc3  = std::make_shared<fully_connected_layer>(5, 5);
+
+  in << cnn << act1;
+  act1 << fc1;
+  act1 << fc2 << act2;
+  (fc1, act2) << add << fc3 << out;
+
+  network<graph> net;
+  construct_graph(net, {in}, {out});
+  net.init_weight();
+
+  vec_t x(8 * 8);
+  uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+  const vec_t before = net.predict(x);
+
+  net.fuse_activations();
+  EXPECT_EQ(net.layer_size(), size_t(6));
+
+  // the network output is now produced by the fused fc3
+  const vec_t after = net.predict(x);
+  ASSERT_EQ(before.size(), after.size());
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_NEAR(before[i], after[i], 1e-6);
+  }
+}
+
+TEST(nodes, graph_prune_channels) {
+  auto in   = std::make_shared<input_layer>(shape3d(8, 8, 1));
+  auto c1   = std::make_shared<convolutional_layer>(8, 8, 3, 1, 4);
+  auto act1 = std::make_shared<activation::tanh>(6, 6, 4);
+  auto c2   = std::make_shared<convolutional_layer>(6, 6, 3, 4, 4);
+  auto act2 = std::make_shared<relu>(4, 4, 4);
+  auto fc1  = std::make_shared<fully_connected_layer>(4 * 4 * 4, 3);
+  auto fc2  = std::make_shared<fully_connected_layer>(4 * 4 * 4, 3);
+  auto add  = std::make_shared<layers::add>(2, 3);
+
+  in << c1 << act1 << c2 << act2;
+  act2 << fc1;
+  act2 << fc2;
+  (fc1, fc2) << add;
+
+  network<graph> net;
+  construct_graph(net, {in}, {add});
+  net.weight_init(weight_init::xavier());
+  net.bias_init(weight_init::xavier());
+  net.init_weight();
+
+  // the weakest channels of c1 give 0, the outputs of c2 feed two layers
+  vec_t &W = *c1->weights()[0];
+  for (size_t c : {0, 3}) {
+    std::fill(W.begin() + c * 9, W.begin() + (c + 1) * 9, float_t{0});
+    (*c1->weights()[1])[c] = 0;
+  }
+
+  vec_t x(8 * 8);
+  uniform_rand(x.begin(), x.end(), -1.0, 1.0);
+  const vec_t before = net.predict(x);
+
+  EXPECT_EQ(size_t(2), net.prune_channels(0.5));
+  EXPECT_EQ(shape3d(6, 6, 2), c1->out_shape()[0]);
+  EXPECT_EQ(shape3d(6, 6, 2), act1->out_shape()[0]);
+  EXPECT_EQ(shape3d(6, 6, 2), c2->in_shape()[0]);
+  EXPECT_EQ(shape3d(4, 4, 4), c2->out_shape()[0]);
+
+  const vec_t after = net.predict(x);
+  ASSERT_EQ(before.size(), after.size());
+  for (size_t i = 0; i < before.size(); i++) {
+    EXPECT_NEAR(before[i], after[i], 1e-5);
+  }
+}
+
 }  // namespace tiny_dnn
@@ -190,4 +190,72 @@ TEST(optimizers, nesterov_momentum_update) {
   }
 }
 
+TEST(optimizers, update_all) {
+  vec_t w1(1000), w2(7);
+  uniform_rand(w1.begin(), w1.end(), -1.0, 1.0);
+  uniform_rand(w2.begin(), w2.end(), -1.0, 1.0);
+  vec_t v1 = w1, v2 = w2;
+
+  // one sweep over both weights matches a separate optimizer for each
+  adam all, opt1, opt2;
+  vec_t dW(w1.size() + w2.size()), g1(w1.size()), g2(w2.size());
+  for (int step = 0; step < 3; step++) {
+    uniform_rand(dW.begin(), dW.end(), -1.0, 1.0);
+    std::copy(dW.begin(), dW.begin() + w1.size(), g1.begin());
+    std::copy(dW.begin() + w1.size(), dW.end(), g2.begin());
+    all.update_all(dW, {&w1, &w2});
+    opt1.update(g1, v1, false);
+    opt2.update(g2, v2, false);
+  }
+
+  for (size_t i = 0; i < w1.size(); i++) EXPECT_NEAR(v1[i], w1[i], 1e-6);
+  for (size_t i = 0; i < w2.size(); i++) EXPECT_NEAR(v2[i], w2[i], 1e-6);
+}
+
+TEST(optimizers, update_all_per_sample) {
+  const size_t batch = 3;
+  vec_t w1(700), w2(5);
+  uniform_rand(w1.begin(), w1.end(), -1.0, 1.0);
+  uniform_rand(w2.begin(), w2.end(), -1.0, 1.0);
+  tensor_t d1(batch, vec_t(w1.size())), d2(batch, vec_t(w2.size()));
+  for (auto &g : d1) uniform_rand(g.begin(), g.end(), -1.0, 1.0);
+  for (auto &g : d2) uniform_rand(g.begin(), g.end(), -1.0, 1.0);
+
+  // the fused sweep averages the samples and clips before the update
+  momentum fused, ref;
+  fused.grad_clip = float_t(0.2);
+  vec_t v1 = w1, v2 = w2;
+  const std::vector<const tensor_t *> grads = {&d1, &d2};
+  for (int step = 0; step < 2; step++) {
+    fused.update_all(grads, {&w1, &w2});
+    for (auto p : {std::make_pair(&d1, &v1), std::make_pair(&d2, &v2)}) {
+      vec_t g(p.second->size());
+      for (size_t j = 0; j < g.size(); j++) {
+        for (size_t b = 0; b < batch; b++) g[j] += (*p.first)[b][j] / batch;
+        g[j] = std::max(float_t(-0.2), std::min(float_t(0.2), g[j]));
+      }
+      ref.update(g, *p.second, false);
+    }
+  }
+
+  for (size_t i = 0; i < w1.size(); i++) EXPECT_NEAR(v1[i], w1[i], 1e-6);
+  for (size_t i = 0; i < w2.size(); i++) EXPECT_NEAR(v2[i], w2[i], 1e-6);
+}
+
+TEST(optimizers, resized_weight) {
+  vec_t w(9), g(9);
+  uniform_rand(w.begin(), w.end(), -1.0, 1.0);
+  uniform_rand(g.begin(), g.end(), -1.0, 1.0);
+  adagrad resized, fresh;
+  resized.update(g, w, false);
+
+  // a weight that shrinks in place starts over with a zeroed state
+  w.resize(4);
+  g.resize(4);
+  vec_t v = w;
+  resized.update(g, w, false);
+  fresh.update(g, v, false);
+  for (size_t i = 0; i < w.size(); i++) EXPECT_NEAR(v[i], w[i], 1e-6);
+}
+
 }  // namespace tiny_dnn
@@ -278,4 +278,29 @@ TEST(quantization_utils, quantize_down_and_shrink_range) {
   EXPECT_NEAR(1.0f, output_max, 1E-5);
 }
 
+TEST(quantization_utils, quantized_gemm) {
+  // sizes off the 4-row blocks and the 16/32-byte steps of the SIMD paths
+  const size_t M = 7, N = 3, K = 75;
+  std::vector<uint8_t> A(M * K), B(N * K);
+  for (auto &a : A) a = static_cast<uint8_t>(uniform_rand(0, 255));
+  for (auto &b : B) b = static_cast<uint8_t>(uniform_rand(0, 255));
+  // zero points may lie outside of [0, 255]
+  const std::vector<int32_t> offset_a = {0, 255, 128, -300, 17, 1000, 3};
+  const int32_t offset_b              = 77;
+
+  std::vector<int32_t> C(M * N, 1);
+  core::kernels::tiny_quantized_gemm(M, N, K, &A[0], K, &offset_a[0], &B[0],
+                                     K, offset_b, &C[0], N);
+  for (size_t i = 0; i < M; i++) {
+    for (size_t j = 0; j < N; j++) {
+      int32_t expected = 1;
+      for (size_t k = 0; k < K; k++) {
+        expected += (static_cast<int32_t>(A[i * K + k]) - offset_a[i]) *
+                    (static_cast<int32_t>(B[j * K + k]) - offset_b);
+      }
+      EXPECT_EQ(expected, C[i * N + j]);
+    }
+  }
+}
+
 }  // namespace tiny_dnn
@@ -85,6 +85,7 @@ TEST(quantized_convolutional, fprop) {
     in[15] = 3; in[16] =-1; in[17] = 2; in[18] = 9; in[19] = 0;
     in[20] = 1; in[21] = 2; in[22] = 1; in[23] = 5; in[24] = 5;
 
+    l.post_update();
     {
         l.forward_propagation(in_data, out_data);
 
@@ -97,15 +98,15 @@ TEST(quantized_convolutional, fprop) {
         EXPECT_NEAR(0.4238461, out[6], 5e-2);
         EXPECT_NEAR(1.1756143, out[7], 5e-2);
         EXPECT_NEAR(0.8273983, out[8], 5e-2);
-        EXPECT_NEAR(-0.192101, out[9], 5e-2);
-        EXPECT_NEAR(1.2309504, out[10], 5e-2);
-        EXPECT_NEAR(2.2292108, out[11], 5e-2);
-        EXPECT_NEAR(0.5300441, out[12], 5e-2);
-        EXPECT_NEAR(1.7407004, out[13], 5e-2);
-        EXPECT_NEAR(1.6345025, out[14], 5e-2);
-        EXPECT_NEAR(0.6362420, out[15], 5e-2);
-        EXPECT_NEAR(3.4186277, out[16], 5e-2);
-        EXPECT_NEAR(-0.489455, out[17], 5e-2);
+        EXPECT_NEAR(-0.800000, out[9], 5e-2);
+        EXPECT_NEAR(1.1000000, out[10], 5e-2);
+        EXPECT_NEAR(2.1000000, out[11], 5e-2);
+        EXPECT_NEAR(0.6000000, out[12], 5e-2);
+        EXPECT_NEAR(1.5000000, out[13], 5e-2);
+        EXPECT_NEAR(0.7000000, out[14], 5e-2);
+        EXPECT_NEAR(0.4000000, out[15], 5e-2);
+        EXPECT_NEAR(3.3000000, out[16], 5e-2);
+        EXPECT_NEAR(-1.000000, out[17], 5e-2);
     }
   // clang-format on
 }
@@ -178,19 +179,186 @@ TEST(quantized_convolutional, fprop_npp) {
     EXPECT_NEAR(0.4238461, out[6], 2e-2);
     EXPECT_NEAR(1.1884713, out[7], 2e-2);
     EXPECT_NEAR(0.8273983, out[8], 2e-2);
-    EXPECT_NEAR(-0.192101, out[9], 2e-2);
-    EXPECT_NEAR(1.2309504, out[10], 2e-2);
-    EXPECT_NEAR(2.2292108, out[11], 2e-2);
-    EXPECT_NEAR(0.5300441, out[12], 2e-2);
-    EXPECT_NEAR(1.7407004, out[13], 2e-2);
-    EXPECT_NEAR(1.6345025, out[14], 2e-2);
-    EXPECT_NEAR(0.6362420, out[15], 2e-2);
-    EXPECT_NEAR(3.4186277, out[16], 2e-2);
-    EXPECT_NEAR(-0.489455, out[17], 2e-2);
+    EXPECT_NEAR(-0.800000, out[9], 2e-2);
+    EXPECT_NEAR(1.1000000, out[10], 2e-2);
+    EXPECT_NEAR(2.1000000, out[11], 2e-2);
+    EXPECT_NEAR(0.6000000, out[12], 2e-2);
+    EXPECT_NEAR(1.5000000, out[13], 2e-2);
+    EXPECT_NEAR(0.7000000, out[14], 2e-2);
+    EXPECT_NEAR(0.4000000, out[15], 2e-2);
+    EXPECT_NEAR(3.3000000, out[16], 2e-2);
+    EXPECT_NEAR(-1.000000, out[17], 2e-2);
   }
 }
 #endif
 
+TEST(quantized_convolutional, cached_weights) {
+  quantized_convolutional_layer l(5, 5, 3, 1, 2);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::constant(0.1));
+
+  vec_t in(25);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  std::vector<const tensor_t *> o;
+  auto forward = [&]() {
+    l.forward({{in}}, o);
+    return (*o[0])[0];
+  };
+  const vec_t expected = forward();
+
+  // later calls reuse the weights quantized on the first call
+  for (int i = 0; i < 2; i++) {
+    const vec_t out = forward();
+    for (size_t j = 0; j < out.size(); j++) {
+      EXPECT_NEAR(expected[j], out[j], 1e-6);
+    }
+  }
+
+  // and quantize them again once they are updated
+  for (auto &w : *l.weights()[0]) w *= float_t(2);
+  l.post_update();
+  const vec_t updated = forward();
+
+  quantized_convolutional_layer fresh(5, 5, 3, 1, 2);
+  fresh.weight_init(weight_init::xavier());
+  fresh.init_weight();
+  *fresh.weights()[0] = *l.weights()[0];
+  *fresh.weights()[1] = *l.weights()[1];
+  fresh.post_update();
+  std::vector<const tensor_t *> fresh_out;
+  fresh.forward({{in}}, fresh_out);
+  for (size_t j = 0; j < updated.size(); j++) {
+    EXPECT_NEAR((*fresh_out[0])[0][j], updated[j], 1e-6);
+  }
+}
+
+TEST(quantized_convolutional, per_channel_ranges) {
+  // two output channels whose weights differ in scale by 100x
+  vec_t W(18);
+  uniform_rand(W.begin(), W.begin() + 9, -1.0, 1.0);
+  uniform_rand(W.begin() + 9, W.end(), -0.01, 0.01);
+
+  core::kernels::quantized_weights q;
+  core::kernels::quantize_filter_per_channel(W, 2, 9, 1, &q);
+  ASSERT_EQ(2u, q.min_filters.size());
+  EXPECT_LE(q.max_filters[1] - q.min_filters[1], float_t(0.02));
+
+  // each channel is quantized with the resolution of its own range
+  for (size_t o = 0; o < 2; o++) {
+    const float_t step = (q.max_filters[o] - q.min_filters[o]) / 255;
+    for (size_t k = 0; k < 9; k++) {
+      const float_t w = core::kernels::quantized_to_float<uint8_t>(
+        q.W[o * 9 + k], q.min_filters[o], q.max_filters[o]);
+      EXPECT_NEAR(W[o * 9 + k], w, step);
+    }
+  }
+}
+
+TEST(quantized_convolutional, calibration) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 2, 4, padding::same) << relu()
+      << max_pooling_layer(8, 8, 4, 2) << convolutional_layer(4, 4, 3, 4, 3)
+      << fully_connected_layer(12, 2);
+  net.weight_init(weight_init::xavier());
+  net.init_weight();
+
+  std::vector<vec_t> samples(64, vec_t(128));
+  for (auto &s : samples) uniform_rand(s.begin(), s.end(), -1.0, 1.0);
+
+  int8_calibrator calib(net);
+  EXPECT_THROW(calib.input_range(0), nn_error);
+  calib.collect(samples, 16);
+
+  // relu outputs are non-negative, so the range starts at 0
+  const auto range =
+    calib.input_range(2, int8_calibrator::range_method::min_max);
+  EXPECT_EQ(float_t(0), range.first);
+  EXPECT_LT(float_t(0), range.second);
+  EXPECT_LE(calib.input_range(2).second, range.second);
+
+  network<sequential> qnet =
+    calib.quantize(int8_calibrator::range_method::percentile, 99.99, false);
+  ASSERT_EQ(net.depth(), qnet.depth());
+  EXPECT_EQ("q_conv", qnet[0]->layer_type());
+  EXPECT_EQ("q_conv", qnet[3]->layer_type());
+
+  for (size_t i = 0; i < 8; i++) {
+    const vec_t expected = net.predict(samples[i]);
+    const vec_t actual   = qnet.predict(samples[i]);
+    for (size_t j = 0; j < expected.size(); j++) {
+      EXPECT_NEAR(expected[j], actual[j], 5e-2);
+    }
+  }
+}
+
+TEST(quantized_convolutional, integer_edges) {
+  network<sequential> net;
+  net << convolutional_layer(8, 8, 3, 2, 4, padding::same) << relu()
+      << max_pooling_layer(8, 8, 4, 2) << convolutional_layer(4, 4, 3, 4, 4)
+      << relu() << average_pooling_layer(2, 2, 4, 2)
+      << fully_connected_layer(4, 3) << relu();
+  net.weight_init(weight_init::xavier());
+  net.init_weight();
+
+  std::vector<vec_t> samples(64, vec_t(128));
+  for (auto &s : samples) uniform_rand(s.begin(), s.end(), -1.0, 1.0);
+
+  int8_calibrator calib(net);
+  calib.collect(samples, 16);
+  EXPECT_EQ(float_t(0), calib.output_range(net.depth() - 1).first);
+
+  // the relus after the quantized layers are folded into their outputs
+  network<sequential> qnet = calib.quantize();
+  const std::vector<std::string> types = {
+    "q_conv",     "max-pool",          "q_conv",
+    "q_ave-pool", "q_fully-connected", "dequantize"};
+  ASSERT_EQ(types.size(), qnet.depth());
+  for (size_t i = 0; i < types.size(); i++) {
+    EXPECT_EQ(types[i], qnet[i]->layer_type());
+  }
+
+  network<sequential> fnet =
+    calib.quantize(int8_calibrator::range_method::percentile, 99.99, false);
+  for (size_t i = 0; i < 8; i++) {
+    const vec_t expected = net.predict(samples[i]);
+    const vec_t actual   = qnet.predict(samples[i]);
+    const vec_t floats   = fnet.predict(samples[i]);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t j = 0; j < expected.size(); j++) {
+      EXPECT_NEAR(expected[j], actual[j], 5e-2);
+      EXPECT_NEAR(floats[j], actual[j], 5e-2);
+    }
+  }
+}
+
+TEST(quantized_convolutional, quantized_input) {
+  quantized_convolutional_layer l(4, 4, 3, 2, 2, padding::same);
+  l.weight_init(weight_init::xavier());
+  l.init_weight();
+  l.set_input_range(-1, 1);
+  l.set_output_range(-4, 4);
+
+  vec_t in(32);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  std::vector<const tensor_t *> o;
+  l.forward({{in}}, o);
+  const vec_t codes = (*o[0])[0];
+
+  // the codes of the input give the same codes as the input
+  vec_t in_codes(in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    in_codes[i] = core::kernels::float_to_quantized<uint8_t>(in[i], -1, 1);
+  }
+  l.set_quantized_input(-1, 1);
+  l.forward({{in_codes}}, o);
+  for (size_t i = 0; i < codes.size(); i++) {
+    EXPECT_EQ(codes[i], (*o[0])[0][i]);
+    EXPECT_EQ(codes[i], std::floor(codes[i]));
+  }
+
+  EXPECT_THROW(l.set_output_range(1, 1), nn_error);
+}
+
 /*
 TEST(quantized_convolutional, gradient_check) { // tanh - mse
     network<sequential> nn;
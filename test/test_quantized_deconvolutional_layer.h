@@ -80,6 +80,7 @@ TEST(quantized_deconvolutional, fprop) {
     in[0] = 3;  in[1] = 2;
     in[2] = 3;  in[3] = 0;
 
+    l.post_update();
     {
         l.forward_propagation(in_data, out_data);
 
@@ -150,6 +151,7 @@ TEST(quantized_deconvolutional, fprop2) {
   in[0] = 3;  in[1] = 2;
   in[2] = 3;  in[3] = 0;
 
+  l.post_update();
   {
     l.forward_propagation(in_data, out_data);
 
@@ -0,0 +1,93 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <memory>
+#include <vector>
+
+namespace tiny_dnn {
+
+TEST(sparse_fully_connected, prune_by_magnitude) {
+  fully_connected_layer l(20, 10);
+  l.weight_init(weight_init::xavier());
+  l.init_weight();
+  const vec_t W = *l.weights()[0];
+
+  EXPECT_EQ(size_t(160), prune_by_magnitude(l, 0.8));
+  const vec_t &pruned = *l.weights()[0];
+  float_t max_pruned = 0, min_kept = 1e10;
+  for (size_t i = 0; i < W.size(); i++) {
+    if (pruned[i] == float_t{0}) {
+      max_pruned = std::max(max_pruned, std::abs(W[i]));
+    } else {
+      EXPECT_EQ(W[i], pruned[i]);
+      min_kept = std::min(min_kept, std::abs(W[i]));
+    }
+  }
+  EXPECT_LE(max_pruned, min_kept);
+  EXPECT_THROW(prune_by_magnitude(l, 1.5), nn_error);
+}
+
+TEST(sparse_fully_connected, forward_matches_dense) {
+  fully_connected_layer l(37, 13);
+  init_random_weights(l);
+  prune_by_magnitude(l, 0.85);
+
+  sparse_fully_connected_layer s(l);
+  EXPECT_EQ(size_t(37 * 13 - 408), s.sparse_weights().nnz());
+  expect_same_forward(l, s, 1e-6);
+}
+
+TEST(sparse_fully_connected, sparsify) {
+  network<sequential> net;
+  net << fully_connected_layer(16, 32) << relu()
+      << fully_connected_layer(32, 4, false);
+  net.weight_init(weight_init::xavier());
+  net.init_weight();
+  prune_by_magnitude(net, 0.75);
+
+  network<sequential> snet = sparsify(net);
+  ASSERT_EQ(net.depth(), snet.depth());
+  EXPECT_EQ("sparse-fully-connected", snet[0]->layer_type());
+  EXPECT_EQ("sparse-fully-connected", snet[2]->layer_type());
+
+  vec_t in(16);
+  uniform_rand(in.begin(), in.end(), -1.0, 1.0);
+  const vec_t expected = net.predict(in);
+  const vec_t actual   = snet.predict(in);
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_NEAR(expected[i], actual[i], 1e-5);
+  }
+
+  // the fused relu would be lost
+  net.fuse_activations();
+  EXPECT_THROW(sparsify(net), nn_error);
+}
+
+TEST(sparse_fully_connected, read_write) {
+  fully_connected_layer l(10, 6);
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::xavier());
+  l.init_weight();
+  prune_by_magnitude(l, 0.5);
+  sparse_fully_connected_layer s(l);
+
+  auto copy = std::dynamic_pointer_cast<sparse_fully_connected_layer>(
+    detail::clone_layer(s));
+  ASSERT_TRUE(copy != nullptr);
+  EXPECT_TRUE(s.sparse_weights().values == copy->sparse_weights().values);
+  EXPECT_TRUE(s.sparse_weights().columns == copy->sparse_weights().columns);
+  EXPECT_TRUE(s.sparse_weights().row_ptr == copy->sparse_weights().row_ptr);
+  EXPECT_TRUE(s.bias() == copy->bias());
+
+  kernels::csr_matrix bad = s.sparse_weights();
+  bad.columns[0]          = 10;
+  EXPECT_THROW(sparse_fully_connected_layer(bad, s.bias()), nn_error);
+}
+
+}  // namespace tiny_dnn
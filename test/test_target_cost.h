@@ -145,6 +145,34 @@ TEST(target_cost, create_balanced_target_cost_0_5) {
   }
 }
 
+TEST(target_cost, minibatch_gradient) {
+  // large enough for the samples to be processed in parallel
+  const size_t samples = 64;
+  const size_t outputs = 513;
+  std::vector<tensor_t> y(samples, tensor_t(1, vec_t(outputs)));
+  std::vector<tensor_t> t = y, cost = y;
+  for (size_t i = 0; i < samples; i++) {
+    uniform_rand(y[i][0].begin(), y[i][0].end(), -1, 1);
+    uniform_rand(t[i][0].begin(), t[i][0].end(), -1, 1);
+    uniform_rand(cost[i][0].begin(), cost[i][0].end(), 0, 2);
+  }
+
+  std::vector<tensor_t> grads;
+  for (int pass = 0; pass < 2; pass++) {  // the second one reuses grads
+    gradient<mse>(y, t, cost, grads);
+    ASSERT_EQ(grads.size(), samples);
+    float_t max_error = 0;
+    for (size_t i = 0; i < samples; i++) {
+      const vec_t d = mse::df(y[i][0], t[i][0]);
+      for (size_t k = 0; k < outputs; k++) {
+        max_error = std::max(max_error,
+                             std::abs(grads[i][0][k] - d[k] * cost[i][0][k]));
+      }
+    }
+    EXPECT_NEAR(max_error, 0, 1e-6);
+  }
+}
+
 TEST(target_cost, train_unbalanced_data_1dim) {
   // train a really simple function with noisy, unbalanced training data:
   // 1) assuming equal cost for each training sample, in which case the total
@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <limits>
@@ -190,6 +191,41 @@ void quantized_serialization_test(T &src, T &dst) {
   EXPECT_TRUE(is_near_container(r1, r2, 1E-2));
 }
 
+// xavier-initialized weights and biases
+inline void init_random_weights(layer &l) {
+  l.weight_init(weight_init::xavier());
+  l.bias_init(weight_init::xavier());
+  l.init_weight();
+}
+
+// checks that the converted layer @a actual gives the outputs of @a expected
+// on random batches, within @a tolerance times the range of these outputs
+inline void expect_same_forward(layer &expected,
+                                layer &actual,
+                                float_t tolerance) {
+  for (size_t batch : {1, 3, 8, 11}) {
+    tensor_t in(batch, vec_t(expected.in_shape()[0].size()));
+    for (auto &v : in) uniform_rand(v.begin(), v.end(), -1.0, 1.0);
+
+    std::vector<const tensor_t *> o;
+    expected.forward({in}, o);
+    const tensor_t out = *o[0];
+    actual.forward({in}, o);
+
+    float_t lo = out[0][0], hi = out[0][0];
+    for (const vec_t &v : out) {
+      const auto range = std::minmax_element(v.begin(), v.end());
+      lo               = std::min(lo, *range.first);
+      hi               = std::max(hi, *range.second);
+    }
+    for (size_t b = 0; b < batch; b++) {
+      for (size_t i = 0; i < out[b].size(); i++) {
+        EXPECT_NEAR(out[b][i], (*o[0])[b][i], tolerance * (hi - lo));
+      }
+    }
+  }
+}
+
 template <typename T>
 inline T epsilon() {
   return 0;
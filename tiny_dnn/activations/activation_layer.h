@@ -71,6 +71,20 @@ class activation_layer : public layer {
     this->in_shape_ = in_shape;
   }
 
+  channel_pruning input_channel_pruning() const override {
+    return channel_pruning::forwards;
+  }
+
+  void prune_input_channels(const std::vector<size_t> &kept,
+                            size_t channels) override {
+    if (in_shape_.depth_ == channels) {
+      in_shape_.depth_ = kept.size();
+    } else {
+      in_shape_ = shape3d(in_shape_.size() / channels * kept.size(), 1, 1);
+    }
+    reshape_edges();
+  }
+
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     const tensor_t &x = *in_data[0];
@@ -120,6 +134,13 @@ class activation_layer : public layer {
    */
   virtual std::pair<float_t, float_t> scale() const = 0;
 
+  /**
+   * True if the activation is elementwise and backward_activation only reads
+   * y (and not x). Such activations can be computed in place and fused into
+   * the preceding layer.
+   */
+  virtual bool backward_uses_output_only() const { return false; }
+
  private:
   shape3d in_shape_;
 };
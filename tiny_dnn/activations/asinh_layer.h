@@ -41,6 +41,8 @@ class asinh_layer : public activation_layer {
     return std::make_pair(float_t(-0.8), float_t(0.8));
   }
 
+  bool backward_uses_output_only() const override { return true; }
+
   friend struct serialization_buddy;
 };
 
@@ -7,11 +7,13 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
 #include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 
@@ -38,9 +40,15 @@ class elu_layer : public activation_layer {
   std::string layer_type() const override { return "elu-activation"; }
 
   void forward_activation(const vec_t &x, vec_t &y) override {
-    for (size_t j = 0; j < x.size(); j++) {
-      y[j] =
-        x[j] < float_t(0) ? (alpha_ * (std::exp(x[j]) - float_t(1))) : x[j];
+    // y is x itself when fused, so the exponentials go through a buffer
+    float_t e[64];
+    for (size_t i = 0; i < x.size(); i += 64) {
+      const size_t n = std::min(x.size() - i, size_t(64));
+      vectorize::exp(&x[i], n, e);
+      for (size_t j = 0; j < n; j++) {
+        const float_t v = x[i + j];
+        y[i + j] = v < float_t(0) ? (alpha_ * (e[j] - float_t(1))) : v;
+      }
     }
   }
 
@@ -58,6 +66,8 @@ class elu_layer : public activation_layer {
     return std::make_pair(float_t(0.1), float_t(0.9));
   }
 
+  bool backward_uses_output_only() const override { return true; }
+
   float_t alpha_;
   friend struct serialization_buddy;
 };
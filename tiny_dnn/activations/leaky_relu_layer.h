@@ -92,6 +92,8 @@ class leaky_relu_layer : public activation_layer {
     return std::make_pair(float_t(0.1), float_t(0.9));
   }
 
+  bool backward_uses_output_only() const override { return true; }
+
   float_t epsilon_;
   friend struct serialization_buddy;
 };
@@ -12,6 +12,7 @@
 
 #include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 
@@ -80,10 +81,9 @@ class selu_layer : public activation_layer {
   float_t alpha_value() { return alpha_; }
 
   void forward_activation(const vec_t &x, vec_t &y) override {
+    vectorize::exp(&x[0], x.size(), &y[0]);
     for (size_t j = 0; j < x.size(); j++) {
-      y[j] =
-        lambda_ *
-        (x[j] > float_t(0) ? x[j] : alpha_ * (std::exp(x[j]) - float_t(1)));
+      y[j] = lambda_ * (x[j] > float_t(0) ? x[j] : alpha_ * (y[j] - float_t(1)));
     }
   }
 
@@ -12,6 +12,7 @@
 
 #include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 
@@ -22,9 +23,7 @@ class sigmoid_layer : public activation_layer {
   std::string layer_type() const override { return "sigmoid-activation"; }
 
   void forward_activation(const vec_t &x, vec_t &y) override {
-    for (size_t j = 0; j < x.size(); j++) {
-      y[j] = float_t(1) / (float_t(1) + std::exp(-x[j]));
-    }
+    vectorize::sigmoid(&x[0], x.size(), &y[0]);
   }
 
   void backward_activation(const vec_t &x,
@@ -41,6 +40,8 @@ class sigmoid_layer : public activation_layer {
     return std::make_pair(float_t(0.1), float_t(0.9));
   }
 
+  bool backward_uses_output_only() const override { return true; }
+
   friend struct serialization_buddy;
 };
 
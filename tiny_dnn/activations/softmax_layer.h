@@ -7,11 +7,14 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <numeric>
 #include <string>
 #include <utility>
 
 #include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 
@@ -21,15 +24,21 @@ class softmax_layer : public activation_layer {
 
   std::string layer_type() const override { return "softmax-activation"; }
 
+  // normalized over all the channels
+  channel_pruning input_channel_pruning() const override {
+    return channel_pruning::none;
+  }
+
   void forward_activation(const vec_t &x, vec_t &y) override {
     const float_t alpha = *std::max_element(x.begin(), x.end());
-    float_t denominator(0);
     for (size_t j = 0; j < x.size(); j++) {
-      y[j] = std::exp(x[j] - alpha);
-      denominator += y[j];
+      y[j] = x[j] - alpha;
     }
+    vectorize::exp(&y[0], y.size(), &y[0]);
+    const float_t denominator = std::accumulate(y.begin(), y.end(), float_t(0));
+    const float_t inv         = float_t(1) / denominator;
     for (size_t j = 0; j < x.size(); j++) {
-      y[j] /= denominator;
+      y[j] *= inv;
     }
   }
 
@@ -37,6 +46,10 @@ class softmax_layer : public activation_layer {
                            const vec_t &y,
                            vec_t &dx,
                            const vec_t &dy) override {
+    if (loss_gradient_fused_) {
+      dx = dy;
+      return;
+    }
     const size_t len = dy.size();
 
 // auxilliary vector to store element wise softmax gradients of all elements
@@ -58,7 +71,37 @@ class softmax_layer : public activation_layer {
     return std::make_pair(float_t(0), float_t(1));
   }
 
+  /**
+   * when set, the gradient given to backward() is already the gradient of the
+   * softmax input, as computed by a fused loss (see
+   * softmax_cross_entropy_gradient), and is passed through unchanged instead
+   * of being multiplied by the Jacobian.
+   **/
+  void set_loss_gradient_fused(bool fused) { loss_gradient_fused_ = fused; }
+
+  /**
+   * set_loss_gradient_fused(true) for the lifetime of the scope, reset even
+   * when the backward pass throws
+   **/
+  class fused_loss_gradient_scope {
+   public:
+    explicit fused_loss_gradient_scope(softmax_layer &l) : layer_(l) {
+      layer_.set_loss_gradient_fused(true);
+    }
+    ~fused_loss_gradient_scope() { layer_.set_loss_gradient_fused(false); }
+
+    fused_loss_gradient_scope(const fused_loss_gradient_scope &) = delete;
+    fused_loss_gradient_scope &operator=(const fused_loss_gradient_scope &) =
+      delete;
+
+   private:
+    softmax_layer &layer_;
+  };
+
   friend struct serialization_buddy;
+
+ private:
+  bool loss_gradient_fused_ = false;
 };
 
 }  // namespace tiny_dnn
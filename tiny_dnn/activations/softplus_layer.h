@@ -7,11 +7,13 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
 #include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 
@@ -82,10 +84,20 @@ class softplus_layer : public activation_layer {
   float_t threshold_value() const { return threshold_; }
 
   void forward_activation(const vec_t &x, vec_t &y) override {
-    for (size_t j = 0; j < x.size(); j++) {
-      float_t betain = beta_ * x[j];
-      y[j]           = (betain > threshold_) ? x[j]
-                                   : (1 / beta_) * std::log1p(std::exp(betain));
+    // y is x itself when fused, so log(1 + exp(beta x)) goes through a buffer
+    const float_t inv_beta = float_t(1) / beta_;
+    float_t sp[64];
+    for (size_t i = 0; i < x.size(); i += 64) {
+      const size_t n = std::min(x.size() - i, size_t(64));
+      for (size_t j = 0; j < n; j++) {
+        sp[j] = beta_ * x[i + j];
+      }
+      vectorize::exp(sp, n, sp);
+      vectorize::log1p(sp, n, sp);
+      for (size_t j = 0; j < n; j++) {
+        const float_t v = x[i + j];
+        y[i + j]        = (beta_ * v > threshold_) ? v : inv_beta * sp[j];
+      }
     }
   }
 
@@ -105,6 +117,8 @@ class softplus_layer : public activation_layer {
     return std::make_pair(float_t(0.1), float_t(0.9));
   }
 
+  bool backward_uses_output_only() const override { return true; }
+
   float_t beta_;
   float_t threshold_;
   friend struct serialization_buddy;
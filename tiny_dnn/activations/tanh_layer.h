@@ -12,6 +12,7 @@
 
 #include "tiny_dnn/activations/activation_layer.h"
 #include "tiny_dnn/layers/layer.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 
@@ -22,9 +23,7 @@ class tanh_layer : public activation_layer {
   std::string layer_type() const override { return "tanh-activation"; }
 
   void forward_activation(const vec_t &x, vec_t &y) override {
-    for (size_t j = 0; j < x.size(); j++) {
-      y[j] = std::tanh(x[j]);
-    }
+    vectorize::tanh(&x[0], x.size(), &y[0]);
   }
 
   void backward_activation(const vec_t &x,
@@ -41,6 +40,8 @@ class tanh_layer : public activation_layer {
     return std::make_pair(float_t(-0.8), float_t(0.8));
   }
 
+  bool backward_uses_output_only() const override { return true; }
+
   friend struct serialization_buddy;
 };
 
@@ -20,6 +20,12 @@
  */
 // #define CNN_USE_AVX
 
+/**
+ * define to convert half-precision weights with the F16C instructions
+ * (requires CNN_USE_AVX)
+ */
+// #define CNN_USE_F16C
+
 /**
  * define to enable sse2 vectorization
  */
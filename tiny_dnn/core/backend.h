@@ -9,6 +9,7 @@
 
 #include <vector>
 
+#include "tiny_dnn/core/params/avepool_params.h"
 #include "tiny_dnn/core/params/conv_params.h"
 #include "tiny_dnn/core/params/deconv_params.h"
 #include "tiny_dnn/core/params/fully_params.h"
@@ -16,10 +16,7 @@
 #include "tiny_dnn/core/kernels/tiny_deconv2d_kernel.h"
 #include "tiny_dnn/core/kernels/tiny_quantized_conv2d_kernel.h"
 #include "tiny_dnn/core/kernels/tiny_quantized_deconv2d_kernel.h"
-
-#ifdef CNN_USE_GEMMLOWP
 #include "tiny_dnn/core/kernels/tiny_quantized_fully_connected_kernel.h"
-#endif  // CNN_USE_GEMMLOWP
 
 namespace tiny_dnn {
 namespace core {
@@ -51,6 +48,18 @@ class tiny_backend : public backend {
       copy_and_pad_input(f1),
       copy_and_unpad_delta(f2) {}
 
+  // quantized convolution with the weights quantized once
+  tiny_backend(conv_params *params,
+               std::function<void(const tensor_t &)> f1,
+               std::function<void(const tensor_t &, tensor_t &)> f2,
+               conv_layer_worker_specific_storage *ptr,
+               kernels::quantized_weights *quantized)
+    : params_c_(params),
+      conv_layer_worker_storage_(ptr),
+      quantized_(quantized),
+      copy_and_pad_input(f1),
+      copy_and_unpad_delta(f2) {}
+
   // deconvolution
   tiny_backend(deconv_params *params,
                std::function<void(const tensor_t &)> f1,
@@ -74,6 +83,18 @@ class tiny_backend : public backend {
       copy_and_pad_delta(f2),
       backward_activation(f3) {}
 
+  // quantized deconvolution with the weights quantized once
+  tiny_backend(deconv_params *params,
+               std::function<void(const tensor_t &)> f1,
+               std::function<void(const tensor_t &, tensor_t &)> f2,
+               deconv_layer_worker_specific_storage *ptr,
+               kernels::quantized_weights *quantized)
+    : params_d_(params),
+      deconv_layer_worker_storage_(ptr),
+      quantized_(quantized),
+      copy_and_unpad_output(f1),
+      copy_and_pad_delta(f2) {}
+
   // fully_connected
   explicit tiny_backend(fully_params *params)
 #if 0
@@ -91,6 +112,10 @@ class tiny_backend : public backend {
     CNN_UNREFERENCED_PARAMETER(params);
   }
 
+  // quantized fully_connected with the weights quantized once
+  tiny_backend(fully_params *params, kernels::quantized_weights *quantized)
+    : params_f_(params), quantized_(quantized) {}
+
   // core math functions
 
   // quantized convolution
@@ -105,9 +130,12 @@ class tiny_backend : public backend {
 
     fill_tensor(out, float_t{0});
 
+    if (!quantized_->valid) {
+      kernels::tiny_quantize_conv2d_weights(*params_c_, W, bias, quantized_);
+    }
     for (size_t i = 0; i < in.size(); i++) {
-      kernels::tiny_quantized_conv2d_kernel(*params_c_, *in[i], W, bias, out[i],
-                                            layer_->parallelize());
+      kernels::tiny_quantized_conv2d_kernel(*params_c_, *in[i], *quantized_,
+                                            out[i], layer_->parallelize());
     }
   }
 
@@ -200,8 +228,11 @@ class tiny_backend : public backend {
       out, float_t{0},
       params_d_->out.size());  // deconv2d-kernel requires padded size buffer
 
+    if (!quantized_->valid) {
+      kernels::tiny_quantize_deconv2d_weights(*params_d_, W, bias, quantized_);
+    }
     for (size_t i = 0; i < in.size(); i++) {
-      kernels::tiny_quantized_deconv2d_kernel(*params_d_, in[i], W, bias,
+      kernels::tiny_quantized_deconv2d_kernel(*params_d_, in[i], *quantized_,
                                               out[i], layer_->parallelize());
     }
 
@@ -299,28 +330,23 @@ class tiny_backend : public backend {
 
   void fully_q(const std::vector<tensor_t *> &in_data,
                std::vector<tensor_t *> &out_data) override {
-#ifdef CNN_USE_GEMMLOWP
     const tensor_t &in = *in_data[0];
     const vec_t &W     = (*in_data[1])[0];
     tensor_t &out      = *out_data[0];
 
+    if (!quantized_->valid) {
+      kernels::tiny_quantize_fully_connected_weights(
+        *params_f_, W, params_f_->has_bias_ ? (*in_data[2])[0] : vec_t(),
+        quantized_);
+    }
     for (size_t i = 0; i < in.size(); i++) {
       kernels::tiny_quantized_fully_connected_kernel(
-        *params_f_, in[i], W, params_f_->has_bias_ ? (*in_data[2])[0] : vec_t(),
-        out[i], layer_->parallelize());
+        *params_f_, in[i], *quantized_, out[i], layer_->parallelize());
     }
-#else
-    CNN_UNREFERENCED_PARAMETER(in_data);
-    CNN_UNREFERENCED_PARAMETER(out_data);
-    throw nn_not_implemented_error(
-      "quantized fully op requires gemmlowp "
-      "library. please define CNN_USE_GEMMLOWP");
-#endif
   }
 
   void fully_eq(const std::vector<tensor_t *> &in_data,
                 std::vector<tensor_t *> &out_data) override {
-#ifdef CNN_USE_GEMMLOWP
     const tensor_t &in   = *in_data[0];
     const vec_t &W       = (*in_data[1])[0];
     vec_t &b             = (*in_data[2])[0];
@@ -335,20 +361,12 @@ class tiny_backend : public backend {
         *params_f_, in[i], W, b, in_r[i], W_r, b_r, out[i], out_r[i],
         layer_->parallelize());
     }
-#else
-    CNN_UNREFERENCED_PARAMETER(in_data);
-    CNN_UNREFERENCED_PARAMETER(out_data);
-    throw nn_not_implemented_error(
-      "quantized fully op requires gemmlowp "
-      "library. please define CNN_USE_GEMMLOWP");
-#endif
   }
 
   void fully_q(const std::vector<tensor_t *> &in_data,
                const std::vector<tensor_t *> &out_data,
                std::vector<tensor_t *> &out_grad,
                std::vector<tensor_t *> &in_grad) override {
-#ifdef CNN_USE_GEMMLOWP
     const tensor_t &prev_out = *in_data[0];
     const vec_t &W           = (*in_data[1])[0];
     tensor_t &dW             = *in_grad[1];
@@ -363,15 +381,6 @@ class tiny_backend : public backend {
         *params_f_, prev_out[i], W, dW[i], prev_delta[i], curr_delta[i], db[i],
         layer_->parallelize());
     }
-#else
-    CNN_UNREFERENCED_PARAMETER(in_data);
-    CNN_UNREFERENCED_PARAMETER(out_data);
-    CNN_UNREFERENCED_PARAMETER(out_grad);
-    CNN_UNREFERENCED_PARAMETER(in_grad);
-    throw nn_not_implemented_error(
-      "quantized fully op requires gemmlowp "
-      "library. please define CNN_USE_GEMMLOWP");
-#endif
   }
 
   backend_t type() const override { return default_engine(); }
@@ -380,12 +389,15 @@ class tiny_backend : public backend {
   /* Pointer to the convolution parameters */
   conv_params *params_c_;
   deconv_params *params_d_;
-  // fully_params *params_f_;
+  fully_params *params_f_;
 
   /* Pointer to the workers */
   conv_layer_worker_specific_storage *conv_layer_worker_storage_;
   deconv_layer_worker_specific_storage *deconv_layer_worker_storage_;
 
+  /* Weights of a quantized layer, kept quantized by the layer */
+  kernels::quantized_weights *quantized_;
+
   /* Pointers to parent class functions */
   std::function<void(const tensor_t &)> copy_and_pad_input;
   std::function<void(const tensor_t &)> copy_and_unpad_output;
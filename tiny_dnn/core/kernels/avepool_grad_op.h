@@ -0,0 +1,49 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include "tiny_dnn/core/framework/op_kernel.h"
+
+#include "tiny_dnn/core/kernels/avepool_op_avx.h"
+#include "tiny_dnn/core/kernels/avepool_op_internal.h"
+
+namespace tiny_dnn {
+
+class AvePoolGradOp : public core::OpKernel {
+ public:
+  explicit AvePoolGradOp(const core::OpKernelConstruction &context)
+    : core::OpKernel(context) {}
+
+  void compute(core::OpKernelContext &context) override {
+    auto &params = OpKernel::params_->avepool();
+
+    // incoming/outcoming data
+    const tensor_t &prev_out = context.input(0);
+    const vec_t &W           = context.input(1)[0];
+    tensor_t &dW             = context.input_grad(1);
+    tensor_t &db             = context.input_grad(2);
+    tensor_t &prev_delta     = context.input_grad(0);
+    tensor_t &curr_delta     = context.output_grad(0);
+
+    // initialize outputs
+    fill_tensor(prev_delta, float_t{0});
+
+    const core::backend_t engine = context.engine();
+
+    if (engine == core::backend_t::avx) {
+      kernels::avepool_grad_op_avx(prev_out, W, dW, db, prev_delta, curr_delta,
+                                   params, context.parallelize());
+    } else {
+      kernels::avepool_grad_op_internal(prev_out, W, dW, db, prev_delta,
+                                        curr_delta, params,
+                                        context.parallelize());
+    }
+  }
+};
+
+}  // namespace tiny_dnn
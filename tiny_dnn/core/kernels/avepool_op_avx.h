@@ -0,0 +1,325 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/avepool_op_internal.h"
+
+#ifdef CNN_USE_AVX
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
+
+namespace tiny_dnn {
+namespace kernels {
+
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+
+// the AVX kernels cover the common non-overlapping 2x2 / 3x3 windows,
+// everything else goes to the internal kernels
+inline bool avx_avepool_supported(const core::avepool_params &params,
+                                  const shape3d &pooled,
+                                  const shape3d &unpooled) {
+  return params.non_overlapping() &&
+         (params.pool_size_x == 2 || params.pool_size_x == 3) &&
+         pooled.width_ * params.pool_size_x <= unpooled.width_ &&
+         pooled.height_ * params.pool_size_y <= unpooled.height_;
+}
+
+/**
+ * dst[i] = sum of the pool_x * pool_y window at column i * pool_x of the
+ * pool_y rows starting at src, for i in [0, dst_width).
+ * buf must hold src_width floats.
+ **/
+inline void avx_window_sum_row(const float *src,
+                               size_t src_width,
+                               size_t pool_x,
+                               size_t pool_y,
+                               size_t dst_width,
+                               float *buf,
+                               float *dst) {
+  // vertical sums over contiguous rows
+  size_t i = 0;
+  for (; i + 8 <= src_width; i += 8) {
+    __m256 sum = _mm256_loadu_ps(src + i);
+    for (size_t dy = 1; dy < pool_y; dy++) {
+      sum = _mm256_add_ps(sum, _mm256_loadu_ps(src + dy * src_width + i));
+    }
+    _mm256_storeu_ps(buf + i, sum);
+  }
+  for (; i < src_width; i++) {
+    float sum = src[i];
+    for (size_t dy = 1; dy < pool_y; dy++) sum += src[dy * src_width + i];
+    buf[i] = sum;
+  }
+
+  // horizontal sums of adjacent pool_x columns
+  size_t x = 0;
+  if (pool_x == 2) {
+    for (; x + 8 <= dst_width && 2 * x + 16 <= src_width; x += 8) {
+      // hadd yields {0, 1, 4, 5 | 2, 3, 6, 7}; swap the middle 64bit pairs
+      __m256d d = _mm256_castps_pd(_mm256_hadd_ps(
+        _mm256_loadu_ps(buf + 2 * x), _mm256_loadu_ps(buf + 2 * x + 8)));
+      __m256d swapped =
+        _mm256_permute_pd(_mm256_permute2f128_pd(d, d, 1), 0x5);
+      _mm256_storeu_ps(dst + x,
+                       _mm256_castpd_ps(_mm256_blend_pd(d, swapped, 0x6)));
+    }
+  }
+  for (; x < dst_width; x++) {
+    const float *p = buf + x * pool_x;
+    float sum      = p[0];
+    for (size_t dx = 1; dx < pool_x; dx++) sum += p[dx];
+    dst[x] = sum;
+  }
+}
+
+/**
+ * dst[i * pool_x + dx] = src[i] * scale + shift for i in [0, n), then copies
+ * the row to the following pool_y - 1 rows of dst.
+ **/
+inline void avx_expand_row(const float *src,
+                           size_t n,
+                           float scale,
+                           float shift,
+                           size_t pool_x,
+                           size_t pool_y,
+                           size_t dst_width,
+                           float *dst) {
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  const __m256 shift8 = _mm256_set1_ps(shift);
+  size_t i            = 0;
+  if (pool_x == 2) {
+    for (; i + 8 <= n; i += 8) {
+      __m256 v  = madd256_ps(_mm256_loadu_ps(src + i), scale8, shift8);
+      __m256 lo = _mm256_unpacklo_ps(v, v);  // {0, 0, 1, 1 | 4, 4, 5, 5}
+      __m256 hi = _mm256_unpackhi_ps(v, v);  // {2, 2, 3, 3 | 6, 6, 7, 7}
+      _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+      _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+  }
+  for (; i < n; i++) {
+    const float v = src[i] * scale + shift;
+    for (size_t dx = 0; dx < pool_x; dx++) dst[i * pool_x + dx] = v;
+  }
+
+  for (size_t dy = 1; dy < pool_y; dy++) {
+    std::copy(dst, dst + n * pool_x, dst + dy * dst_width);
+  }
+}
+
+// dst[i] = dst[i] * scale + shift
+inline void avx_affine_row(float *dst, size_t n, float scale, float shift) {
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  const __m256 shift8 = _mm256_set1_ps(shift);
+  size_t i            = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(dst + i,
+                     madd256_ps(_mm256_loadu_ps(dst + i), scale8, shift8));
+  }
+  for (; i < n; i++) dst[i] = dst[i] * scale + shift;
+}
+
+inline void avx_avepool_kernel(const tensor_t &in_data,
+                               const vec_t &W,
+                               const vec_t &bias,
+                               tensor_t &out_data,
+                               const core::avepool_params &params,
+                               const bool layer_parallelize) {
+  const size_t px = params.pool_size_x, py = params.pool_size_y;
+
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in = in_data[sample];
+    vec_t &out      = out_data[sample];
+    std::vector<float> buf(params.in.width_);
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      const float weight = W[c] * params.scale_factor;
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        float *out_row = &out[params.out.get_index(0, oy, c)];
+        avx_window_sum_row(&in[params.in.get_index(0, oy * py, c)],
+                           params.in.width_, px, py, params.out.width_,
+                           &buf[0], out_row);
+        avx_affine_row(out_row, params.out.width_, weight, bias[c]);
+      }
+    }
+  });
+}
+
+inline void avx_avepool_grad_kernel(const tensor_t &prev_out,
+                                    const vec_t &W,
+                                    tensor_t &dW,
+                                    tensor_t &db,
+                                    tensor_t &prev_delta,
+                                    const tensor_t &curr_delta,
+                                    const core::avepool_params &params,
+                                    const bool layer_parallelize) {
+  const size_t px = params.pool_size_x, py = params.pool_size_y;
+
+  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
+    const vec_t &in   = prev_out[sample];
+    const vec_t &curr = curr_delta[sample];
+    vec_t &prev       = prev_delta[sample];
+    std::vector<float> buf(params.in.width_), sums(params.out.width_);
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      const float weight = W[c] * params.scale_factor;
+      float dw{0}, dbias{0};
+
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        const size_t i     = params.in.get_index(0, oy * py, c);
+        const float *delta = &curr[params.out.get_index(0, oy, c)];
+
+        avx_expand_row(delta, params.out.width_, weight, 0.0f, px, py,
+                       params.in.width_, &prev[i]);
+        avx_window_sum_row(&in[i], params.in.width_, px, py,
+                           params.out.width_, &buf[0], &sums[0]);
+        dw += vectorize::dot(delta, &sums[0], params.out.width_);
+        dbias += std::accumulate(delta, delta + params.out.width_, 0.0f);
+      }
+      dW[sample][c] += dw * params.scale_factor;
+      db[sample][c] += dbias;
+    }
+  });
+}
+
+inline void avx_aveunpool_kernel(const tensor_t &in_data,
+                                 const vec_t &W,
+                                 const vec_t &bias,
+                                 tensor_t &out_data,
+                                 const core::avepool_params &params,
+                                 const bool layer_parallelize) {
+  const size_t px = params.pool_size_x, py = params.pool_size_y;
+
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in = in_data[sample];
+    vec_t &out      = out_data[sample];
+
+    for (size_t c = 0; c < params.in.depth_; c++) {
+      const float weight = W[c] * params.scale_factor;
+      for (size_t y = 0; y < params.in.height_; y++) {
+        avx_expand_row(&in[params.in.get_index(0, y, c)], params.in.width_,
+                       weight, bias[c], px, py, params.out.width_,
+                       &out[params.out.get_index(0, y * py, c)]);
+      }
+    }
+  });
+}
+
+inline void avx_aveunpool_grad_kernel(const tensor_t &prev_out,
+                                      const vec_t &W,
+                                      tensor_t &dW,
+                                      tensor_t &db,
+                                      tensor_t &prev_delta,
+                                      const tensor_t &curr_delta,
+                                      const core::avepool_params &params,
+                                      const bool layer_parallelize) {
+  const size_t px = params.pool_size_x, py = params.pool_size_y;
+
+  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
+    const vec_t &in   = prev_out[sample];
+    const vec_t &curr = curr_delta[sample];
+    vec_t &prev       = prev_delta[sample];
+    std::vector<float> buf(params.out.width_);
+
+    for (size_t c = 0; c < params.in.depth_; c++) {
+      const float weight = W[c] * params.scale_factor;
+      float dw{0};
+
+      for (size_t y = 0; y < params.in.height_; y++) {
+        const size_t i = params.in.get_index(0, y, c);
+        float *row     = &prev[i];
+        avx_window_sum_row(&curr[params.out.get_index(0, y * py, c)],
+                           params.out.width_, px, py, params.in.width_,
+                           &buf[0], row);
+        dw += vectorize::dot(&in[i], row, params.in.width_);
+        avx_affine_row(row, params.in.width_, weight, 0.0f);
+      }
+
+      const float *pcurr = &curr[params.out.get_index(0, 0, c)];
+      dW[sample][c] += dw * params.scale_factor;
+      db[sample][c] += std::accumulate(pcurr, pcurr + params.out.area(), 0.0f);
+    }
+  });
+}
+
+#endif  // defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+
+inline void avepool_op_avx(const tensor_t &in_data,
+                           const vec_t &W,
+                           const vec_t &bias,
+                           tensor_t &out_data,
+                           const core::avepool_params &params,
+                           const bool layer_parallelize) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  if (avx_avepool_supported(params, params.out, params.in)) {
+    avx_avepool_kernel(in_data, W, bias, out_data, params, layer_parallelize);
+    return;
+  }
+#endif
+  avepool_op_internal(in_data, W, bias, out_data, params, layer_parallelize);
+}
+
+inline void avepool_grad_op_avx(const tensor_t &prev_out,
+                                const vec_t &W,
+                                tensor_t &dW,
+                                tensor_t &db,
+                                tensor_t &prev_delta,
+                                const tensor_t &curr_delta,
+                                const core::avepool_params &params,
+                                const bool layer_parallelize) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  if (avx_avepool_supported(params, params.out, params.in)) {
+    avx_avepool_grad_kernel(prev_out, W, dW, db, prev_delta, curr_delta,
+                            params, layer_parallelize);
+    return;
+  }
+#endif
+  avepool_grad_op_internal(prev_out, W, dW, db, prev_delta, curr_delta, params,
+                           layer_parallelize);
+}
+
+inline void aveunpool_op_avx(const tensor_t &in_data,
+                             const vec_t &W,
+                             const vec_t &bias,
+                             tensor_t &out_data,
+                             const core::avepool_params &params,
+                             const bool layer_parallelize) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  if (avx_avepool_supported(params, params.in, params.out)) {
+    avx_aveunpool_kernel(in_data, W, bias, out_data, params,
+                         layer_parallelize);
+    return;
+  }
+#endif
+  aveunpool_op_internal(in_data, W, bias, out_data, params, layer_parallelize);
+}
+
+inline void aveunpool_grad_op_avx(const tensor_t &prev_out,
+                                  const vec_t &W,
+                                  tensor_t &dW,
+                                  tensor_t &db,
+                                  tensor_t &prev_delta,
+                                  const tensor_t &curr_delta,
+                                  const core::avepool_params &params,
+                                  const bool layer_parallelize) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  if (avx_avepool_supported(params, params.in, params.out)) {
+    avx_aveunpool_grad_kernel(prev_out, W, dW, db, prev_delta, curr_delta,
+                              params, layer_parallelize);
+    return;
+  }
+#endif
+  aveunpool_grad_op_internal(prev_out, W, dW, db, prev_delta, curr_delta,
+                             params, layer_parallelize);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
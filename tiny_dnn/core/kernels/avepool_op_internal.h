@@ -0,0 +1,195 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/core/params/avepool_params.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * sum of the pooling window of output (ox, oy) in channel c.
+ * only windows which fit into the input are connected; the others sum to 0.
+ **/
+inline float_t avepool_window_sum(const vec_t &in,
+                                  const core::avepool_params &params,
+                                  size_t ox,
+                                  size_t oy,
+                                  size_t c) {
+  const size_t x0 = ox * params.stride_x;
+  const size_t y0 = oy * params.stride_y;
+  if (x0 + params.pool_size_x > params.in.width_ ||
+      y0 + params.pool_size_y > params.in.height_) {
+    return float_t{0};
+  }
+
+  const float_t *window = &in[params.in.get_index(x0, y0, c)];
+  float_t sum{0};
+  for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+    for (size_t dx = 0; dx < params.pool_size_x; dx++) {
+      sum += window[dy * params.in.width_ + dx];
+    }
+  }
+  return sum;
+}
+
+inline void avepool_op_internal(const tensor_t &in_data,
+                                const vec_t &W,
+                                const vec_t &bias,
+                                tensor_t &out_data,
+                                const core::avepool_params &params,
+                                const bool layer_parallelize) {
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in = in_data[sample];
+    vec_t &out      = out_data[sample];
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      const float_t weight = W[c] * params.scale_factor;
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < params.out.width_; ox++) {
+          out[params.out.get_index(ox, oy, c)] =
+            avepool_window_sum(in, params, ox, oy, c) * weight + bias[c];
+        }
+      }
+    }
+  });
+}
+
+inline void avepool_grad_op_internal(const tensor_t &prev_out,
+                                     const vec_t &W,
+                                     tensor_t &dW,
+                                     tensor_t &db,
+                                     tensor_t &prev_delta,
+                                     const tensor_t &curr_delta,
+                                     const core::avepool_params &params,
+                                     const bool layer_parallelize) {
+  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
+    const vec_t &in   = prev_out[sample];
+    const vec_t &curr = curr_delta[sample];
+    vec_t &prev       = prev_delta[sample];
+
+    // prev_delta is zero-initialized by the caller
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      const float_t weight = W[c] * params.scale_factor;
+      float_t dw{0}, dbias{0};
+
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < params.out.width_; ox++) {
+          const float_t delta = curr[params.out.get_index(ox, oy, c)];
+          dbias += delta;
+
+          const size_t x0 = ox * params.stride_x;
+          const size_t y0 = oy * params.stride_y;
+          if (x0 + params.pool_size_x > params.in.width_ ||
+              y0 + params.pool_size_y > params.in.height_) {
+            continue;
+          }
+          for (size_t dy = 0; dy < params.pool_size_y; dy++) {
+            const size_t i = params.in.get_index(x0, y0 + dy, c);
+            for (size_t dx = 0; dx < params.pool_size_x; dx++) {
+              prev[i + dx] += weight * delta;
+              dw += in[i + dx] * delta;
+            }
+          }
+        }
+      }
+      dW[sample][c] += dw * params.scale_factor;
+      db[sample][c] += dbias;
+    }
+  });
+}
+
+inline void aveunpool_op_internal(const tensor_t &in_data,
+                                  const vec_t &W,
+                                  const vec_t &bias,
+                                  tensor_t &out_data,
+                                  const core::avepool_params &params,
+                                  const bool layer_parallelize) {
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in = in_data[sample];
+    vec_t &out      = out_data[sample];
+
+    // out_data is zero-initialized by the caller
+    for (size_t c = 0; c < params.in.depth_; c++) {
+      for (size_t y = 0; y < params.in.height_; y++) {
+        for (size_t x = 0; x < params.in.width_; x++) {
+          const float_t value = in[params.in.get_index(x, y, c)];
+          const size_t x0     = x * params.stride_x;
+          const size_t y0     = y * params.stride_y;
+          const size_t dymax =
+            std::min(params.pool_size_y, params.out.height_ - y0);
+          const size_t dxmax =
+            std::min(params.pool_size_x, params.out.width_ - x0);
+
+          for (size_t dy = 0; dy < dymax; dy++) {
+            float_t *row = &out[params.out.get_index(x0, y0 + dy, c)];
+            for (size_t dx = 0; dx < dxmax; dx++) row[dx] += value;
+          }
+        }
+      }
+
+      const float_t weight = W[c] * params.scale_factor;
+      float_t *pout        = &out[params.out.get_index(0, 0, c)];
+      for (size_t i = 0; i < params.out.area(); i++) {
+        pout[i] = pout[i] * weight + bias[c];
+      }
+    }
+  });
+}
+
+inline void aveunpool_grad_op_internal(const tensor_t &prev_out,
+                                       const vec_t &W,
+                                       tensor_t &dW,
+                                       tensor_t &db,
+                                       tensor_t &prev_delta,
+                                       const tensor_t &curr_delta,
+                                       const core::avepool_params &params,
+                                       const bool layer_parallelize) {
+  for_i(layer_parallelize, prev_out.size(), [&](size_t sample) {
+    const vec_t &in   = prev_out[sample];
+    const vec_t &curr = curr_delta[sample];
+    vec_t &prev       = prev_delta[sample];
+
+    for (size_t c = 0; c < params.in.depth_; c++) {
+      const float_t weight = W[c] * params.scale_factor;
+      float_t dw{0}, dbias{0};
+
+      for (size_t y = 0; y < params.in.height_; y++) {
+        for (size_t x = 0; x < params.in.width_; x++) {
+          const size_t x0 = x * params.stride_x;
+          const size_t y0 = y * params.stride_y;
+          const size_t dymax =
+            std::min(params.pool_size_y, params.out.height_ - y0);
+          const size_t dxmax =
+            std::min(params.pool_size_x, params.out.width_ - x0);
+
+          float_t sum{0};
+          for (size_t dy = 0; dy < dymax; dy++) {
+            const float_t *row = &curr[params.out.get_index(x0, y0 + dy, c)];
+            for (size_t dx = 0; dx < dxmax; dx++) sum += row[dx];
+          }
+
+          const size_t i = params.in.get_index(x, y, c);
+          prev[i]        = weight * sum;
+          dw += in[i] * sum;
+        }
+      }
+
+      const float_t *pcurr = &curr[params.out.get_index(0, 0, c)];
+      for (size_t i = 0; i < params.out.area(); i++) dbias += pcurr[i];
+
+      dW[sample][c] += dw * params.scale_factor;
+      db[sample][c] += dbias;
+    }
+  });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/util/gemm.h"
+#include "tiny_dnn/util/util.h"
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * helpers shared by the recurrent cell kernels, which process a whole batch
+ * of one timestep as row-major (batch x width) matrices
+ **/
+
+// dst[sample * width + k] = src[sample][k]
+inline void cell_pack_batch(const tensor_t &src, size_t width, vec_t &dst) {
+  dst.resize(src.size() * width);
+  for (size_t sample = 0; sample < src.size(); sample++) {
+    std::copy(src[sample].begin(), src[sample].begin() + width,
+              dst.begin() + sample * width);
+  }
+}
+
+// dst[sample][k] += src[sample * width + k]
+inline void cell_accumulate_batch(const vec_t &src,
+                                  size_t width,
+                                  tensor_t &dst) {
+  for (size_t sample = 0; sample < dst.size(); sample++) {
+    vectorize::add(&src[sample * width], width, &dst[sample][0]);
+  }
+}
+
+// dst[sample * width + k] = row[k]
+inline void cell_broadcast_row(const vec_t &row,
+                               size_t batch_size,
+                               vec_t &dst) {
+  const size_t width = row.size();
+  dst.resize(batch_size * width);
+  for (size_t sample = 0; sample < batch_size; sample++) {
+    std::copy(row.begin(), row.end(), dst.begin() + sample * width);
+  }
+}
+
+/**
+ * C[batch_size x N] += A[batch_size x K] * op(B), where B is a K x N matrix or,
+ * with TransB, an N x K matrix. the rows of A and C may be strided (lda, ldc)
+ * to address a slice of the stacked gates. rows of the batch are split across
+ * threads.
+ **/
+template <bool TransB>
+inline void cell_batch_gemm(const bool parallelize,
+                            size_t batch_size,
+                            size_t N,
+                            size_t K,
+                            const float_t *A,
+                            size_t lda,
+                            const float_t *B,
+                            float_t *C,
+                            size_t ldc) {
+  for_(parallelize, 0u, batch_size,
+       [&](const blocked_range &r) {
+         gemm<false, TransB>(r.end() - r.begin(), N, K, A + r.begin() * lda,
+                             lda, B, TransB ? K : N, C + r.begin() * ldc, ldc);
+       },
+       0u);
+}
+
+/**
+ * dst[rows x N] = b + x W, the input-to-hidden products of all the rows of x.
+ * recurrent layers call this once for a whole sequence, since the products
+ * do not depend on the recurrence. xs receives the packed rows of x.
+ **/
+inline void cell_project_inputs(const bool parallelize,
+                                const tensor_t &x,
+                                size_t in_size,
+                                const vec_t &W,
+                                const vec_t &b,
+                                bool has_bias,
+                                size_t N,
+                                vec_t &dst,
+                                vec_t &xs) {
+  cell_pack_batch(x, in_size, xs);
+  if (has_bias) {
+    cell_broadcast_row(b, x.size(), dst);
+  } else {
+    dst.assign(x.size() * N, float_t{0});
+  }
+  cell_batch_gemm<false>(parallelize, x.size(), N, in_size, &xs[0], in_size,
+                         &W[0], &dst[0], N);
+}
+
+inline void cell_project_inputs(const bool parallelize,
+                                const tensor_t &x,
+                                size_t in_size,
+                                const vec_t &W,
+                                const vec_t &b,
+                                bool has_bias,
+                                size_t N,
+                                vec_t &dst) {
+  vec_t xs;
+  cell_project_inputs(parallelize, x, in_size, W, b, has_bias, N, dst, xs);
+}
+
+// dW[K x N] += a[K] * b[N]^T
+inline void cell_outer_product(size_t K,
+                               size_t N,
+                               const float_t *a,
+                               const float_t *b,
+                               float_t *dW) {
+  gemm<true, false>(K, N, 1, a, K, b, N, dW, N);
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
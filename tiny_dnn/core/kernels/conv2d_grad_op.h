@@ -26,7 +26,12 @@ class Conv2dGradOp : public core::OpKernel {
     const tensor_t &prev_out = context.input(0);
     const tensor_t &W        = context.input(1);
     tensor_t &dW             = context.input_grad(1);
-    tensor_t &db             = context.input_grad(2);
+    // bias-less layers accumulate db into a scratch buffer which is dropped
+    tensor_t no_bias;
+    if (!params.has_bias) {
+      no_bias.resize(prev_out.size(), vec_t(params.out.depth_));
+    }
+    tensor_t &db = params.has_bias ? context.input_grad(2) : no_bias;
     tensor_t &prev_delta     = context.input_grad(0);
     tensor_t &curr_delta     = context.output_grad(0);
 
@@ -26,9 +26,13 @@ class Conv2dOp : public core::OpKernel {
     // incomimg/outcoming data
     const tensor_t &in_data = context.input(0);
     const tensor_t &W       = context.input(1);
-    const tensor_t &bias    = context.input(2);
     tensor_t &out_data      = context.output(0);
 
+    // the kernels read bias[o] unconditionally, give bias-less layers zeros
+    const tensor_t no_bias =
+      params.has_bias ? tensor_t() : tensor_t{vec_t(params.out.depth_, 0)};
+    const tensor_t &bias = params.has_bias ? context.input(2) : no_bias;
+
     // initialize outputs
     fill_tensor(out_data, float_t{0});
 
@@ -0,0 +1,145 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "tiny_dnn/core/params/deconv_params.h"
+#include "tiny_dnn/util/gemm.h"
+
+namespace tiny_dnn {
+namespace core {
+namespace kernels {
+
+/**
+ * deconvolution is lowered per output channel o onto
+ *
+ *   col[kh * kw x in_area] = W_o^T * in[in.depth x in_area]
+ *
+ * where W_o is the contiguous (in.depth x kh * kw) weight block of o, followed
+ * by a col2im scatter-add of every row (wy, wx) of col into the output plane
+ * at stride (h_stride, w_stride). the backward pass uses the reverse im2col
+ * gather of the output delta.
+ **/
+
+// out_plane[(y * h_stride + wy, x * w_stride + wx)] += col[(wy, wx)][(y, x)]
+template <typename T>
+inline void deconv2d_col2im(const deconv_params &params,
+                            const T *col,
+                            T *out_plane) {
+  const size_t in_area = params.in.width_ * params.in.height_;
+
+  for (size_t wy = 0; wy < params.weight.height_; wy++) {
+    for (size_t wx = 0; wx < params.weight.width_; wx++) {
+      const T *src = col + (wy * params.weight.width_ + wx) * in_area;
+
+      for (size_t y = 0; y < params.in.height_; y++) {
+        T *dst =
+          out_plane + (y * params.h_stride + wy) * params.out.width_ + wx;
+        const T *s = src + y * params.in.width_;
+        if (params.w_stride == 1) {
+          for (size_t x = 0; x < params.in.width_; x++) dst[x] += s[x];
+        } else {
+          for (size_t x = 0; x < params.in.width_; x++) {
+            dst[x * params.w_stride] += s[x];
+          }
+        }
+      }
+    }
+  }
+}
+
+// col[(wy, wx)][(y, x)] = delta_plane[(y * h_stride + wy, x * w_stride + wx)]
+template <typename T>
+inline void deconv2d_im2col(const deconv_params &params,
+                            const T *delta_plane,
+                            T *col) {
+  const size_t in_area = params.in.width_ * params.in.height_;
+
+  for (size_t wy = 0; wy < params.weight.height_; wy++) {
+    for (size_t wx = 0; wx < params.weight.width_; wx++) {
+      T *dst = col + (wy * params.weight.width_ + wx) * in_area;
+
+      for (size_t y = 0; y < params.in.height_; y++) {
+        const T *src =
+          delta_plane + (y * params.h_stride + wy) * params.out.width_ + wx;
+        T *d = dst + y * params.in.width_;
+        for (size_t x = 0; x < params.in.width_; x++) {
+          d[x] = src[x * params.w_stride];
+        }
+      }
+    }
+  }
+}
+
+// zero the weight blocks of (out, in) pairs not in the connection table
+template <typename Container>
+inline void deconv2d_mask_weight(const deconv_params &params, Container &W) {
+  if (params.tbl.is_empty()) return;
+
+  const size_t block = params.weight.width_ * params.weight.height_;
+  for (size_t o = 0; o < params.out.depth_; o++) {
+    for (size_t inc = 0; inc < params.in.depth_; inc++) {
+      if (params.tbl.is_connected(o, inc)) continue;
+      auto first = W.begin() + (params.in.depth_ * o + inc) * block;
+      std::fill(first, first + block, typename Container::value_type(0));
+    }
+  }
+}
+
+/**
+ * out_plane += col2im(W_o^T * in) for every output channel o, computed with
+ * the caller's scratch buffer col (kh * kw * in_area elements).
+ * W must already be masked by the connection table.
+ **/
+template <typename T>
+inline void deconv2d_gemm_forward(const deconv_params &params,
+                                  const T *in,
+                                  const T *W,
+                                  size_t o,
+                                  T *col,
+                                  T *out_plane) {
+  const size_t in_area = params.in.width_ * params.in.height_;
+  const size_t kk      = params.weight.width_ * params.weight.height_;
+
+  std::fill(col, col + kk * in_area, T(0));
+  gemm<true, false>(kk, in_area, params.in.depth_,
+                    W + params.in.depth_ * o * kk, kk, in, in_area, col,
+                    in_area);
+  deconv2d_col2im(params, col, out_plane);
+}
+
+/**
+ * backward of deconv2d_gemm_forward for output channel o:
+ *   prev_delta += W_o * im2col(delta_o)
+ *   dW_o       += prev_out * im2col(delta_o)^T
+ **/
+template <typename T>
+inline void deconv2d_gemm_backward(const deconv_params &params,
+                                   const T *prev_out,
+                                   const T *W,
+                                   const T *delta_plane,
+                                   size_t o,
+                                   T *col,
+                                   T *dW,
+                                   T *prev_delta) {
+  const size_t in_area = params.in.width_ * params.in.height_;
+  const size_t kk      = params.weight.width_ * params.weight.height_;
+  const size_t offset  = params.in.depth_ * o * kk;
+
+  deconv2d_im2col(params, delta_plane, col);
+  gemm<false, false>(params.in.depth_, in_area, kk, W + offset, kk, col,
+                     in_area, prev_delta, in_area);
+  gemm<false, true>(params.in.depth_, kk, in_area, prev_out, in_area, col,
+                    in_area, dW + offset, kk);
+}
+
+}  // namespace kernels
+}  // namespace core
+}  // namespace tiny_dnn
@@ -22,24 +22,16 @@ class GRUCellGradOp : public core::OpKernel {
     // incoming/outcoming data
     const tensor_t &x      = context.input(0);  // x
     const tensor_t &h_prev = context.input(1);  // h(t-1)
-    const tensor_t &W_x2z  = context.input(2);  // W[x->z]
-    const tensor_t &W_x2r  = context.input(3);  // W[x->r]
-    const tensor_t &W_x2h  = context.input(4);  // W[x->h]
-    const tensor_t &W_hr2c = context.input(5);  // W[hr2c]
-    const tensor_t &W_s2z  = context.input(6);  // W[s->z]
-    const tensor_t &W_s2r  = context.input(7);  // W[s->r]
+    const tensor_t &W_x    = context.input(2);  // W[x->zrh]
+    const tensor_t &W_hr2c = context.input(3);  // W[hr2c]
+    const tensor_t &W_s    = context.input(4);  // W[s->zr]
 
     tensor_t &d_x_prev = context.input_grad(0);  // dx
     tensor_t &d_h_prev = context.input_grad(1);  // dh_prev
-    tensor_t &dW_x2z   = context.input_grad(2);  // dW[x->z]
-    tensor_t &dW_x2r   = context.input_grad(3);  // dW[x->r]
-    tensor_t &dW_x2h   = context.input_grad(4);  // dW[x->h]
-    tensor_t &dW_hr2c  = context.input_grad(5);  // dW[hr2c]
-    tensor_t &dW_s2z   = context.input_grad(6);  // dW[s->z]
-    tensor_t &dW_s2r   = context.input_grad(7);  // dW[s->r]
-    tensor_t *db_2z    = params.has_bias_ ? &context.input_grad(8) : nullptr;
-    tensor_t *db_2r    = params.has_bias_ ? &context.input_grad(9) : nullptr;
-    tensor_t *db_2h    = params.has_bias_ ? &context.input_grad(10) : nullptr;
+    tensor_t &dW_x     = context.input_grad(2);  // dW[x->zrh]
+    tensor_t &dW_hr2c  = context.input_grad(3);  // dW[hr2c]
+    tensor_t &dW_s     = context.input_grad(4);  // dW[s->zr]
+    tensor_t *db       = params.has_bias_ ? &context.input_grad(5) : nullptr;
 
     const tensor_t &d_o_next = context.output_grad(0);  // d_o_next
     tensor_t &d_s_next       = context.output_grad(1);  // d_s_next
@@ -58,11 +50,9 @@ class GRUCellGradOp : public core::OpKernel {
     // call the algorithm depending on the selected engine type
 
     kernels::gru_cell_op_internal(
-      x, h_prev, W_x2z[0], W_x2r[0], W_x2h[0], W_hr2c[0], W_s2z[0], W_s2r[0],
-      dW_x2z, dW_x2r, dW_x2h, dW_hr2c, dW_s2z, dW_s2r,
-      params.has_bias_ ? *db_2z : dummy, params.has_bias_ ? *db_2r : dummy,
-      params.has_bias_ ? *db_2h : dummy, d_o_next, d_s_next, d_x_prev, d_h_prev,
-      h, r, z, hr, post_z, params, context.parallelize());
+      x, h_prev, W_x[0], W_hr2c[0], W_s[0], dW_x, dW_hr2c, dW_s,
+      params.has_bias_ ? *db : dummy, d_o_next, d_s_next, d_x_prev, d_h_prev, h,
+      r, z, hr, post_z, params, context.parallelize());
   }
 };
 
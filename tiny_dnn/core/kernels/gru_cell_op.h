@@ -23,16 +23,10 @@ class GRUCellOp : public core::OpKernel {
     // incomimg/outcoming data
     const tensor_t &x      = context.input(0);  // x
     const tensor_t &h_prev = context.input(1);  // h(t-1)
-    const tensor_t &W_x2z  = context.input(2);  // W[x->z]
-    const tensor_t &W_x2r  = context.input(3);  // W[x->r]
-    const tensor_t &W_x2h  = context.input(4);  // W[x->h]
-    const tensor_t &W_hr2c = context.input(5);  // W[hr2c]
-    const tensor_t &W_s2z  = context.input(6);  // W[s->z]
-    const tensor_t &W_s2r  = context.input(7);  // W[s->r]
-
-    const tensor_t *b_2z = params.has_bias_ ? &context.input(8) : nullptr;
-    const tensor_t *b_2r = params.has_bias_ ? &context.input(9) : nullptr;
-    const tensor_t *b_2h = params.has_bias_ ? &context.input(10) : nullptr;
+    const tensor_t &W_x    = context.input(2);  // W[x->zrh]
+    const tensor_t &W_hr2c = context.input(3);  // W[hr2c]
+    const tensor_t &W_s    = context.input(4);  // W[s->zr]
+    const tensor_t *b      = params.has_bias_ ? &context.input(5) : nullptr;
 
     tensor_t &out    = context.output(0);  // output vector s(t)
     tensor_t &s      = context.output(1);  // s(t) is also next state
@@ -56,11 +50,9 @@ class GRUCellOp : public core::OpKernel {
 
     if (engine == core::backend_t::internal || engine == core::backend_t::avx) {
       kernels::gru_cell_op_internal(
-        x, h_prev, W_x2z[0], W_x2r[0], W_x2h[0], W_hr2c[0], W_s2z[0], W_s2r[0],
-        params.has_bias_ ? (*b_2z)[0] : vec_t(),
-        params.has_bias_ ? (*b_2r)[0] : vec_t(),
-        params.has_bias_ ? (*b_2h)[0] : vec_t(), out, h, r, z, hr, post_z,
-        params, context.parallelize());
+        x, h_prev, W_x[0], W_hr2c[0], W_s[0],
+        params.has_bias_ ? (*b)[0] : vec_t(), out, h, r, z, hr, post_z, params,
+        context.parallelize());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
     }
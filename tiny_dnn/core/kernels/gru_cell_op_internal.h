@@ -7,22 +7,27 @@
 */
 #pragma once
 
+#include <algorithm>
+
+#include "tiny_dnn/core/kernels/cell_op_internal.h"
 #include "tiny_dnn/core/params/gru_cell_params.h"
+#include "tiny_dnn/util/fast_math.h"
 
 namespace tiny_dnn {
 namespace kernels {
 
+/**
+ * W_x (in_size x 3 * out_size) holds the input weights of the gates side by
+ * side in the order [z | r | h], W_s (out_size x 2 * out_size) the state
+ * weights of [z | r] and b the biases of [z | r | h]. all the gates of a
+ * batch are computed with one GEMM per weight matrix.
+ **/
 inline void gru_cell_op_internal(const tensor_t &x,
                                  const tensor_t &h_prev,
-                                 const vec_t &W_x2z,
-                                 const vec_t &W_x2r,
-                                 const vec_t &W_x2h,
+                                 const vec_t &W_x,
                                  const vec_t &W_hr2c,
-                                 const vec_t &W_s2z,
-                                 const vec_t &W_s2r,
-                                 const vec_t &b_2z,
-                                 const vec_t &b_2r,
-                                 const vec_t &b_2h,
+                                 const vec_t &W_s,
+                                 const vec_t &b,
                                  tensor_t &out,
                                  tensor_t &h,
                                  tensor_t &r,
@@ -31,86 +36,81 @@ inline void gru_cell_op_internal(const tensor_t &x,
                                  tensor_t &z_neg,
                                  const core::gru_cell_params &params,
                                  const bool layer_parallelize) {
-  for_(layer_parallelize, 0u, x.size(),
-       [&](const blocked_range &range) {
-         const size_t in_size  = params.in_size_;
-         const size_t out_size = params.out_size_;
-         auto tanh             = params.tanh_;
-         auto sigmoid          = params.sigmoid_;
-         const bool has_bias   = params.has_bias_;
-
-         for (size_t sample = range.begin(); sample < range.end(); sample++) {
-           const vec_t &x_      = x[sample];
-           const vec_t &h_prev_ = h_prev[sample];
-           vec_t &out_          = out[sample];
-           vec_t &h_            = h[sample];
-           vec_t &r_            = r[sample];
-           vec_t &z_            = z[sample];
-           vec_t &hr_           = hr[sample];
-           vec_t &z_neg_        = z_neg[sample];
-
-           for (size_t o = 0; o < out_size; o++) {
-             float_t local_z = 0.0;
-             float_t local_r = 0.0;
-             float_t local_h = 0.0;
-             for (size_t i = 0; i < in_size; i++) {
-               local_z += W_x2z[i * out_size + o] * x_[i];
-               local_r += W_x2r[i * out_size + o] * x_[i];
-               local_h += W_x2h[i * out_size + o] * x_[i];
-             }
-             for (size_t o_2 = 0; o_2 < out_size; o_2++) {
-               local_z += W_s2z[o_2 * out_size + o] * h_prev_[o_2];
-               local_r += W_s2r[o_2 * out_size + o] * h_prev_[o_2];
-             }
-             if (has_bias) {
-               local_z += b_2z[o];
-               local_r += b_2r[o];
-               local_h += b_2h[o];
-             }
-             z_[o] = local_z;
-             r_[o] = local_r;
-             h_[o] = local_h;
-           }
-           sigmoid->forward_activation(z_, z_);
-           sigmoid->forward_activation(r_, r_);
-
-           for (size_t o = 0; o < out_size; o++) {  // from
-             out_[o]          = h_prev_[o] * z_[o];
-             z_neg_[o]        = 1 - z_[o];
-             float_t local_hr = h_prev_[o] * r_[o];
-             for (size_t o_2 = 0; o_2 < out_size; o_2++) {  // to
-               h_[o_2] += W_hr2c[o * out_size + o_2] * local_hr;
-             }
-             hr_[o] = local_hr;
-           }
-           tanh->forward_activation(h_, h_);
-           for (size_t o = 0; o < out_size; o++) {
-             out_[o] += z_neg_[o] * h_[o];
-           }
-         }
-       },
-       0u);  // for_i
+  const size_t batch_size = x.size();
+  const size_t in_size    = params.in_size_;
+  const size_t out_size   = params.out_size_;
+  const size_t gates_size = 3 * out_size;
+
+  core::cell_workspace local;
+  core::cell_workspace &ws = params.workspace_ ? *params.workspace_ : local;
+  vec_t &hs                = ws.hs;
+  vec_t &hrs               = ws.aux;
+  vec_t &gates             = ws.gates;
+  hrs.resize(batch_size * out_size);
+
+  // [z | r | h] = b + x W_x, unless the recurrent layer projected the whole
+  // sequence
+  if (params.x_projection_) {
+    gates.assign(params.x_projection_,
+                 params.x_projection_ + batch_size * gates_size);
+  } else {
+    cell_project_inputs(layer_parallelize, x, in_size, W_x, b,
+                        params.has_bias_, gates_size, gates, ws.xs);
+  }
+
+  // [z | r] += s W_s
+  cell_pack_batch(h_prev, out_size, hs);
+  cell_batch_gemm<false>(layer_parallelize, batch_size, 2 * out_size,
+                         out_size, &hs[0], out_size, &W_s[0], &gates[0],
+                         gates_size);
+
+  for_i(layer_parallelize, batch_size, [&](size_t sample) {
+    float_t *g = &gates[sample * gates_size];
+    vectorize::sigmoid(g, 2 * out_size, g);
+
+    const vec_t &h_prev_ = h_prev[sample];
+    const float_t *gr    = g + out_size;
+    float_t *hr_         = &hrs[sample * out_size];
+    for (size_t o = 0; o < out_size; o++) {
+      hr_[o] = h_prev_[o] * gr[o];
+    }
+    std::copy(g, g + out_size, z[sample].begin());
+    std::copy(gr, gr + out_size, r[sample].begin());
+    std::copy(hr_, hr_ + out_size, hr[sample].begin());
+  });
+
+  // h += (h(t-1) * r) W_hr2c
+  cell_batch_gemm<false>(layer_parallelize, batch_size, out_size, out_size,
+                         &hrs[0], out_size, &W_hr2c[0], &gates[2 * out_size],
+                         gates_size);
+
+  for_i(layer_parallelize, batch_size, [&](size_t sample) {
+    float_t *gh          = &gates[sample * gates_size + 2 * out_size];
+    const vec_t &h_prev_ = h_prev[sample];
+    const vec_t &z_      = z[sample];
+    vec_t &h_            = h[sample];
+    vec_t &out_          = out[sample];
+    vec_t &z_neg_        = z_neg[sample];
+
+    vectorize::tanh(gh, out_size, &h_[0]);
+    for (size_t o = 0; o < out_size; o++) {
+      z_neg_[o] = 1 - z_[o];
+      out_[o]   = h_prev_[o] * z_[o] + z_neg_[o] * h_[o];
+    }
+  });
 }
 
 inline void gru_cell_op_internal(const tensor_t &x,
                                  const tensor_t &h_prev,
-                                 const vec_t &W_x2z,
-                                 const vec_t &W_x2r,
-                                 const vec_t &W_x2h,
+                                 const vec_t &W_x,
                                  const vec_t &W_hr2c,
-                                 const vec_t &W_s2z,
-                                 const vec_t &W_s2r,
-                                 tensor_t &dW_x2z,
-                                 tensor_t &dW_x2r,
-                                 tensor_t &dW_x2h,
+                                 const vec_t &W_s,
+                                 tensor_t &dW_x,
                                  tensor_t &dW_hr2c,
-                                 tensor_t &dW_s2z,
-                                 tensor_t &dW_s2r,
-                                 tensor_t &db_2z,
-                                 tensor_t &db_2r,
-                                 tensor_t &db_2h,
+                                 tensor_t &dW_s,
+                                 tensor_t &db,
                                  const tensor_t &d_o_next,
-                                 tensor_t &d_s_next,
+                                 const tensor_t &d_s_next,
                                  tensor_t &d_x_prev,
                                  tensor_t &d_h_prev,
                                  const tensor_t &h,
@@ -120,147 +120,76 @@ inline void gru_cell_op_internal(const tensor_t &x,
                                  const tensor_t &z_neg,
                                  const core::gru_cell_params &params,
                                  const bool layer_parallelize) {
-  for_(
-    layer_parallelize, 0u, x.size(),
-    [&](const blocked_range &range) {
-      const size_t in_size  = params.in_size_;
-      const size_t out_size = params.out_size_;
-      auto tanh             = params.tanh_;
-      auto sigmoid          = params.sigmoid_;
-      const bool has_bias   = params.has_bias_;
-
-      for (size_t sample = range.begin(); sample < range.end(); sample++) {
-        const vec_t x_         = x[sample];
-        const vec_t h_prev_    = h_prev[sample];
-        vec_t &dW_x2z_         = dW_x2z[sample];
-        vec_t &dW_x2r_         = dW_x2r[sample];
-        vec_t &dW_x2h_         = dW_x2h[sample];
-        vec_t &dW_hr2c_        = dW_hr2c[sample];
-        vec_t &dW_s2z_         = dW_s2z[sample];
-        vec_t &dW_s2r_         = dW_s2r[sample];
-        vec_t &db_2z_          = db_2z[sample];
-        vec_t &db_2r_          = db_2r[sample];
-        vec_t &db_2h_          = db_2h[sample];
-        const vec_t &d_o_next_ = d_o_next[sample];
-        vec_t d_s_next_        = d_s_next[sample];
-        vec_t &d_x_prev_       = d_x_prev[sample];
-        vec_t &d_h_prev_       = d_h_prev[sample];
-        const vec_t &h_        = h[sample];
-        const vec_t &r_        = r[sample];
-        const vec_t &z_        = z[sample];
-        const vec_t &hr_       = hr[sample];
-        const vec_t &z_neg_    = z_neg[sample];
-
-        vec_t aux1(out_size, 0.0);
-        vec_t aux2(out_size, 0.0);
-
-        vectorize::add(&d_o_next_[0], out_size, &d_s_next_[0]);
-
-        // do -> ds(t-1), do -> dz
-        for (size_t o = 0; o < out_size; o++) {
-          d_h_prev_[o] = d_s_next_[o] * z_[o];
-          // dz = do / dh(t-1) + do / dh(t)
-          aux1[o] = d_s_next_[o] * (h_prev_[o] - h_[o]);  // aux1 = dz
-        }
-        sigmoid->backward_activation(z_, z_, aux1, aux1);
-
-        // dz -> db2z
-        if (has_bias) {
-          for (size_t o = 0; o < out_size; o++) {
-            db_2z_[o] = aux1[o];
-          }
-        }
-        // from dz -> x
-        for (size_t i = 0; i < in_size; i++) {
-          d_x_prev_[i] +=
-            vectorize::dot(&aux1[0], &W_x2z[i * out_size], out_size);
-        }
-        // dW_x2z
-        for (size_t i = 0; i < in_size; i++) {
-          vectorize::muladd(&aux1[0], x_[i], out_size, &dW_x2z_[i * out_size]);
-        }
-        // from dz -> h_prev
-        for (size_t o = 0; o < out_size; o++) {
-          d_h_prev_[o] +=
-            vectorize::dot(&aux1[0], &W_s2z[o * out_size], out_size);
-        }
-        // dW_s2z
-        for (size_t o = 0; o < out_size; o++) {
-          vectorize::muladd(&aux1[0], h_prev_[o], out_size,
-                            &dW_s2z_[o * out_size]);
-        }
-        // do->dh_next
-        for (size_t o = 0; o < out_size; o++) {
-          aux1[o] = d_s_next_[o] * z_neg_[o];
-        }
-
-        tanh->backward_activation(h_, h_, aux1, aux1);
-
-        // dh -> db2h
-        if (has_bias) {
-          for (size_t o = 0; o < out_size; o++) {
-            db_2h_[o] = aux1[o];
-          }
-        }
-
-        // dh_prev -> dx
-        for (size_t i = 0; i < in_size; i++) {
-          d_x_prev_[i] +=
-            vectorize::dot(&aux1[0], &W_x2h[i * out_size], out_size);
-        }
-        // dh_prev -> dWx2h
-        for (size_t i = 0; i < in_size; i++) {
-          vectorize::muladd(&aux1[0], x_[i], out_size, &dW_x2h_[i * out_size]);
-        }
-        // dh_prev -> dWhr2c
-        for (size_t o = 0; o < out_size; o++) {
-          vectorize::muladd(&aux1[0], hr_[o], out_size,
-                            &dW_hr2c_[o * out_size]);
-        }
-        // dWhr -> dhr
-        for (size_t o = 0; o < out_size; o++) {
-          aux2[o] = vectorize::dot(&aux1[0], &W_hr2c[o * out_size], out_size);
-        }
-        // dhr -> dh_prev
-        for (size_t o = 0; o < out_size; o++) {
-          d_h_prev_[o] += aux2[o] * r_[o];
-        }
-        // dhr -> dr
-        for (size_t o = 0; o < out_size; o++) {
-          aux2[o] = aux2[o] * h_prev_[o];
-        }
-
-        sigmoid->backward_activation(r_, r_, aux2, aux2);
-
-        // dr -> db2r
-        if (has_bias) {
-          for (size_t o = 0; o < out_size; o++) {
-            db_2r_[o] = aux2[o];
-          }
-        }
-
-        // dr -> dx
-        for (size_t i = 0; i < in_size; i++) {
-          d_x_prev_[i] +=
-            vectorize::dot(&aux2[0], &W_x2r[i * out_size], out_size);
-        }
-        // dr -> dWx2r
-        for (size_t i = 0; i < in_size; i++) {
-          vectorize::muladd(&aux2[0], x_[i], out_size, &dW_x2r_[out_size * i]);
-        }
-        // dr -> dh_prev
-        for (size_t o = 0; o < out_size; o++) {
-          d_h_prev_[o] +=
-            vectorize::dot(&aux2[0], &W_s2r[o * out_size], out_size);
-        }
-        // dr -> dWs2r
-        for (size_t o = 0; o < out_size; o++) {
-          vectorize::muladd(&aux2[0], h_prev_[o], out_size,
-                            &dW_s2r_[out_size * o]);
-        }
-      }
-    },
-    0u);  // for_i
+  const size_t batch_size = x.size();
+  const size_t in_size    = params.in_size_;
+  const size_t out_size   = params.out_size_;
+  const size_t gates_size = 3 * out_size;
+
+  // deltas of the gate pre-activations [z | r | h]
+  vec_t d_gates(batch_size * gates_size);
+  vec_t d_hrs(batch_size * out_size);
+
+  for_i(layer_parallelize, batch_size, [&](size_t sample) {
+    const vec_t &d_o_next_ = d_o_next[sample];
+    const vec_t &d_s_next_ = d_s_next[sample];
+    const vec_t &h_prev_   = h_prev[sample];
+    const vec_t &h_        = h[sample];
+    const vec_t &z_        = z[sample];
+    const vec_t &z_neg_    = z_neg[sample];
+    vec_t &d_h_prev_       = d_h_prev[sample];
+
+    float_t *dg  = &d_gates[sample * gates_size];
+    float_t *dgz = dg;
+    float_t *dgh = dg + 2 * out_size;
+
+    for (size_t o = 0; o < out_size; o++) {
+      // s(t) = z(t)s(t-1) + (1 - z(t))h(t)
+      const float_t d_s = d_o_next_[o] + d_s_next_[o];
+      d_h_prev_[o]      = d_s * z_[o];
+      dgz[o] = d_s * (h_prev_[o] - h_[o]) * z_[o] * (float_t(1) - z_[o]);
+      dgh[o] = d_s * z_neg_[o] * (float_t(1) - h_[o] * h_[o]);
+    }
+  });
+
+  // dh -> d(h(t-1) * r)
+  cell_batch_gemm<true>(layer_parallelize, batch_size, out_size, out_size,
+                        &d_gates[2 * out_size], gates_size, &W_hr2c[0],
+                        &d_hrs[0], out_size);
+
+  for_i(layer_parallelize, batch_size, [&](size_t sample) {
+    const vec_t &h_prev_ = h_prev[sample];
+    const vec_t &r_      = r[sample];
+    const float_t *d_hr  = &d_hrs[sample * out_size];
+    vec_t &d_h_prev_     = d_h_prev[sample];
+
+    float_t *dg  = &d_gates[sample * gates_size];
+    float_t *dgr = dg + out_size;
+
+    for (size_t o = 0; o < out_size; o++) {
+      d_h_prev_[o] += d_hr[o] * r_[o];
+      dgr[o] = d_hr[o] * h_prev_[o] * r_[o] * (float_t(1) - r_[o]);
+    }
+
+    cell_outer_product(in_size, gates_size, &x[sample][0], dg,
+                       &dW_x[sample][0]);
+    cell_outer_product(out_size, 2 * out_size, &h_prev_[0], dg,
+                       &dW_s[sample][0]);
+    cell_outer_product(out_size, out_size, &hr[sample][0], dg + 2 * out_size,
+                       &dW_hr2c[sample][0]);
+    if (params.has_bias_) {
+      std::copy(dg, dg + gates_size, db[sample].begin());
+    }
+  });
+
+  // propagate the gate deltas to x(t) and s(t-1)
+  vec_t d_xs(batch_size * in_size), d_hs(batch_size * out_size);
+  cell_batch_gemm<true>(layer_parallelize, batch_size, in_size, gates_size,
+                        &d_gates[0], gates_size, &W_x[0], &d_xs[0], in_size);
+  cell_batch_gemm<true>(layer_parallelize, batch_size, out_size, 2 * out_size,
+                        &d_gates[0], gates_size, &W_s[0], &d_hs[0], out_size);
+  cell_accumulate_batch(d_xs, in_size, d_x_prev);
+  cell_accumulate_batch(d_hs, out_size, d_h_prev);
 }
+
 }  // namespace kernels
 }  // namespace tiny_dnn
@@ -0,0 +1,195 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "tiny_dnn/util/util.h"
+
+#if defined(CNN_USE_F16C) && defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
+
+namespace tiny_dnn {
+namespace kernels {
+
+// IEEE 754 half-precision value, as its bits
+typedef uint16_t fp16_t;
+
+/**
+ * nearest half-precision value of @a f (ties to even). values beyond the
+ * half range become infinities.
+ **/
+inline fp16_t float_to_fp16(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  const uint32_t sign = (x >> 16) & 0x8000u;
+  const uint32_t bits = x & 0x7fffffffu;
+
+  if (bits >= 0x7f800000u) {  // inf or nan
+    const uint32_t nan = bits > 0x7f800000u ? 0x200u : 0;
+    return static_cast<fp16_t>(sign | 0x7c00u | nan);
+  }
+  if (bits >= 0x477ff000u) {  // rounds to 65536 or more
+    return static_cast<fp16_t>(sign | 0x7c00u);
+  }
+  if (bits < 0x38800000u) {  // subnormal half, or zero
+    if (bits < 0x33000001u) return static_cast<fp16_t>(sign);
+    // in units of 2^-24, the smallest subnormal half
+    const uint32_t shift    = 126 - (bits >> 23);
+    const uint32_t mantissa = (bits & 0x7fffffu) | 0x800000u;
+    const uint32_t half     = mantissa >> shift;
+    const uint32_t rest     = mantissa & ((1u << shift) - 1);
+    const uint32_t tie      = 1u << (shift - 1);
+    const uint32_t round    = rest > tie || (rest == tie && (half & 1));
+    return static_cast<fp16_t>(sign | (half + round));
+  }
+  // normal: rebias the exponent and round the 13 dropped mantissa bits
+  const uint32_t h     = (bits - 0x38000000u) >> 13;
+  const uint32_t rest  = bits & 0x1fffu;
+  const uint32_t round = rest > 0x1000u || (rest == 0x1000u && (h & 1));
+  return static_cast<fp16_t>(sign | (h + round));
+}
+
+inline float fp16_to_float(fp16_t h) {
+  const uint32_t sign     = static_cast<uint32_t>(h & 0x8000u) << 16;
+  const uint32_t exponent = (h >> 10) & 0x1fu;
+  uint32_t mantissa       = h & 0x3ffu;
+  uint32_t x;
+
+  if (exponent == 0x1f) {
+    x = sign | 0x7f800000u | (mantissa << 13);
+  } else if (exponent != 0) {
+    x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    x = sign;
+  } else {
+    // subnormal half: normalize the mantissa
+    uint32_t e = 113;
+    while (!(mantissa & 0x400u)) {
+      mantissa <<= 1;
+      e--;
+    }
+    x = sign | (e << 23) | ((mantissa & 0x3ffu) << 13);
+  }
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+/**
+ * convert @a n values to half precision
+ **/
+inline void float_to_fp16(const float_t *src, fp16_t *dst, size_t n) {
+  size_t i = 0;
+#if defined(CNN_USE_F16C) && defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                      _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+  }
+#endif
+  for (; i < n; i++) dst[i] = float_to_fp16(static_cast<float>(src[i]));
+}
+
+/**
+ * convert @a n half-precision values back
+ **/
+inline void fp16_to_float(const fp16_t *src, float_t *dst, size_t n) {
+  size_t i = 0;
+#if defined(CNN_USE_F16C) && defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+  }
+#endif
+  for (; i < n; i++) dst[i] = fp16_to_float(src[i]);
+}
+
+inline std::vector<fp16_t> to_fp16(const vec_t &v) {
+  std::vector<fp16_t> h(v.size());
+  float_to_fp16(v.data(), h.data(), v.size());
+  return h;
+}
+
+inline vec_t from_fp16(const std::vector<fp16_t> &h) {
+  vec_t v(h.size());
+  fp16_to_float(h.data(), v.data(), h.size());
+  return v;
+}
+
+/**
+ * sum_k W[k] * x[k] over n half-precision weights, accumulated in single
+ * precision. with F16C, the weights are widened by vcvtph2ps as they are
+ * loaded, so only their half-precision bytes are read from memory.
+ **/
+inline float_t fp16_dot(const fp16_t *W, const float_t *x, size_t n) {
+  size_t k    = 0;
+  float_t sum = 0;
+#if defined(CNN_USE_F16C) && defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  __m256 sum0 = _mm256_setzero_ps();
+  __m256 sum1 = _mm256_setzero_ps();
+  for (; k + 16 <= n; k += 16) {
+    const __m128i h0 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(W + k));
+    const __m128i h1 =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(W + k + 8));
+    sum0 = madd256_ps(_mm256_cvtph_ps(h0), _mm256_loadu_ps(x + k), sum0);
+    sum1 = madd256_ps(_mm256_cvtph_ps(h1), _mm256_loadu_ps(x + k + 8), sum1);
+  }
+  sum = _mm_cvtss_f32(hsum256_ps(_mm256_add_ps(sum0, sum1)));
+#endif
+  for (; k < n; k++) sum += fp16_to_float(W[k]) * x[k];
+  return sum;
+}
+
+/**
+ * out[s][i] = bias[i] + sum_c W[i * in_size + c] * in[s][c], with the
+ * out_size x in_size weights stored in half precision, row by row.
+ *
+ * each row is read once for the whole batch, as it stays in cache from one
+ * sample to the next.
+ *
+ * @param bias [in] empty when the layer has no bias
+ **/
+inline void half_fully_connected_kernel(const std::vector<fp16_t> &W,
+                                        const vec_t &bias,
+                                        const tensor_t &in_data,
+                                        tensor_t &out_data,
+                                        size_t in_size,
+                                        size_t out_size,
+                                        const bool layer_parallelize) {
+  for_(layer_parallelize, 0, out_size, [&](const blocked_range &r) {
+#if !defined(CNN_USE_F16C) || !defined(CNN_USE_AVX) || defined(CNN_USE_DOUBLE)
+    // without F16C, a row is widened once and shared by the samples
+    vec_t row(in_size);
+#endif
+    for (size_t i = r.begin(); i < r.end(); i++) {
+      const fp16_t *w = &W[i * in_size];
+      const float_t b = bias.empty() ? float_t{0} : bias[i];
+#if defined(CNN_USE_F16C) && defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+      for (size_t s = 0; s < in_data.size(); s++) {
+        out_data[s][i] = b + fp16_dot(w, in_data[s].data(), in_size);
+      }
+#else
+      fp16_to_float(w, row.data(), in_size);
+      for (size_t s = 0; s < in_data.size(); s++) {
+        float_t sum = b;
+        for (size_t c = 0; c < in_size; c++) sum += row[c] * in_data[s][c];
+        out_data[s][i] = sum;
+      }
+#endif
+    }
+  });
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
@@ -24,19 +24,9 @@ class LSTMCellOp : public core::OpKernel {
     const tensor_t &x      = context.input(0);   // x
     const tensor_t &h_prev = context.input(1);   // h(t-1)
     const tensor_t &c_prev = context.input(2);   // c(t-1)
-    const tensor_t &W_x2i  = context.input(3);   // W[x->i]
-    const tensor_t &W_x2f  = context.input(4);   // W[x->f]
-    const tensor_t &W_x2c  = context.input(5);   // W[x->c]
-    const tensor_t &W_x2o  = context.input(6);   // W[x->o]
-    const tensor_t &W_h2i  = context.input(7);   // W[h->i]
-    const tensor_t &W_h2f  = context.input(8);   // W[h->f]
-    const tensor_t &W_h2c  = context.input(9);   // W[h->c]
-    const tensor_t &W_h2o  = context.input(10);  // W[h->o]
-
-    const tensor_t *b_2i = params.has_bias_ ? &context.input(11) : nullptr;
-    const tensor_t *b_2f = params.has_bias_ ? &context.input(12) : nullptr;
-    const tensor_t *b_2c = params.has_bias_ ? &context.input(13) : nullptr;
-    const tensor_t *b_2o = params.has_bias_ ? &context.input(14) : nullptr;
+    const tensor_t &W_x    = context.input(3);   // W[x->ifoc]
+    const tensor_t &W_h    = context.input(4);   // W[h->ifoc]
+    const tensor_t *b      = params.has_bias_ ? &context.input(5) : nullptr;
 
     tensor_t &out_data = context.output(0);
     tensor_t &h_next   = context.output(1);
@@ -61,12 +51,8 @@ class LSTMCellOp : public core::OpKernel {
 
     if (engine == core::backend_t::internal || engine == core::backend_t::avx) {
       kernels::lstm_cell_op_internal(
-        x, h_prev, c_prev, W_x2i[0], W_x2f[0], W_x2c[0], W_x2o[0], W_h2i[0],
-        W_h2f[0], W_h2c[0], W_h2o[0], params.has_bias_ ? (*b_2i)[0] : vec_t(),
-        params.has_bias_ ? (*b_2f)[0] : vec_t(),
-        params.has_bias_ ? (*b_2c)[0] : vec_t(),
-        params.has_bias_ ? (*b_2o)[0] : vec_t(), out_data, h_next, c_next, i, f,
-        z, c, params, context.parallelize());
+        x, h_prev, c_prev, W_x[0], W_h[0], params.has_bias_ ? (*b)[0] : vec_t(),
+        out_data, h_next, c_next, i, f, z, c, params, context.parallelize());
     } else {
       throw nn_error("Not supported engine: " + to_string(engine));
     }
@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <limits>
 #include <vector>
 
 #include "tiny_dnn/core/kernels/maxpool_op_internal.h"
@@ -14,20 +15,157 @@
 namespace tiny_dnn {
 namespace kernels {
 
-inline void maxpool_op_avx(const tensor_t &in_data,
-                           tensor_t &out_data,
-                           std::vector<std::vector<size_t>> &max_idx,
-                           const std::vector<std::vector<size_t>> &out2in,
-                           const bool layer_parallelize) {
-  maxpool_op_internal(in_data, out_data, max_idx, out2in, layer_parallelize);
+#ifdef CNN_USE_AVX
+
+/**
+ * loads in[0], in[Stride], ..., in[7 * Stride]. for Stride == 2 the lanes come
+ * out as {0, 1, 4, 5, 2, 3, 6, 7}; avx_maxpool_reorder restores the order.
+ **/
+template <size_t Stride>
+inline __m256 avx_maxpool_load8(const float *in);
+
+template <>
+inline __m256 avx_maxpool_load8<1>(const float *in) {
+  return _mm256_loadu_ps(in);
+}
+
+template <>
+inline __m256 avx_maxpool_load8<2>(const float *in) {
+  return _mm256_shuffle_ps(_mm256_loadu_ps(in), _mm256_loadu_ps(in + 8),
+                           _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+template <size_t Stride>
+inline __m256 avx_maxpool_reorder(__m256 v);
+
+template <>
+inline __m256 avx_maxpool_reorder<1>(__m256 v) {
+  return v;
+}
+
+template <>
+inline __m256 avx_maxpool_reorder<2>(__m256 v) {
+  // {01, 45 | 23, 67} => {01, 23 | 45, 67} as 64bit pairs
+  __m256d d       = _mm256_castps_pd(v);
+  __m256d swapped = _mm256_permute_pd(_mm256_permute2f128_pd(d, d, 1), 0x5);
+  return _mm256_castpd_ps(_mm256_blend_pd(d, swapped, 0x6));
+}
+
+/**
+ * max-pools 8 adjacent outputs at a time while their windows (and the
+ * strided loads) stay inside the input row. returns the first output column
+ * left for the scalar tail.
+ **/
+template <size_t Stride>
+inline size_t avx_maxpool_row_kernel(const float *in_row,
+                                     size_t window_height,
+                                     const core::maxpool_params &params,
+                                     float *out_row,
+                                     core::maxpool_index_t *max_row) {
+  const size_t in_width  = params.in.width_;
+  const size_t out_width = params.out.width_;
+  const size_t pool_x    = params.pool_size_x;
+  size_t ox              = 0;
+
+  for (; ox + 8 <= out_width &&
+         ox * Stride + pool_x + 8 * Stride - 1 <= in_width;
+       ox += 8) {
+    const float *window = in_row + ox * Stride;
+    __m256 max_value    = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    __m256 max_offset   = _mm256_setzero_ps();
+
+    for (size_t dy = 0; dy < window_height; dy++) {
+      for (size_t dx = 0; dx < pool_x; dx++) {
+        __m256 v    = avx_maxpool_load8<Stride>(window + dy * in_width + dx);
+        __m256 mask = _mm256_cmp_ps(v, max_value, _CMP_GT_OQ);
+        max_value   = _mm256_blendv_ps(max_value, v, mask);
+        max_offset  = _mm256_blendv_ps(
+          max_offset, _mm256_set1_ps(static_cast<float>(dy * pool_x + dx)),
+          mask);
+      }
+    }
+
+    _mm256_storeu_ps(out_row + ox, avx_maxpool_reorder<Stride>(max_value));
+    __m256i offset =
+      _mm256_cvttps_epi32(avx_maxpool_reorder<Stride>(max_offset));
+    _mm_storeu_si128(
+      reinterpret_cast<__m128i *>(max_row + ox),
+      _mm_packus_epi32(_mm256_castsi256_si128(offset),
+                       _mm256_extractf128_si256(offset, 1)));
+  }
+  return ox;
+}
+
+template <typename Allocator>
+inline void avx_maxpool_kernel(
+  const std::vector<std::vector<float, Allocator>> &in_data,
+  std::vector<std::vector<float, Allocator>> &out_data,
+  std::vector<std::vector<core::maxpool_index_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+  if (params.stride_x > 2) {
+    maxpool_op_internal(in_data, out_data, max_idx, params, layer_parallelize);
+    return;
+  }
+
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const auto &in                          = in_data[sample];
+    auto &out                               = out_data[sample];
+    std::vector<core::maxpool_index_t> &max = max_idx[sample];
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        const float *in_row =
+          &in[params.in.get_index(0, oy * params.stride_y, c)];
+        const size_t o  = params.out.get_index(0, oy, c);
+        const size_t wh = params.window_height(oy);
+
+        size_t ox =
+          params.stride_x == 1
+            ? avx_maxpool_row_kernel<1>(in_row, wh, params, &out[o], &max[o])
+            : avx_maxpool_row_kernel<2>(in_row, wh, params, &out[o], &max[o]);
+
+        maxpool_row_internal(in_row, wh, ox, params.out.width_, params,
+                             &out[o], &max[o]);
+      }
+    }
+  });
+}
+
+template <typename Allocator>
+inline void avx_maxpool_kernel(
+  const std::vector<std::vector<double, Allocator>> &in_data,
+  std::vector<std::vector<double, Allocator>> &out_data,
+  std::vector<std::vector<core::maxpool_index_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+  maxpool_op_internal(in_data, out_data, max_idx, params, layer_parallelize);
+}
+
+#endif  // CNN_USE_AVX
+
+inline void maxpool_op_avx(
+  const tensor_t &in_data,
+  tensor_t &out_data,
+  std::vector<std::vector<core::maxpool_index_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+#ifdef CNN_USE_AVX
+  avx_maxpool_kernel(in_data, out_data, max_idx, params, layer_parallelize);
+#else
+  maxpool_op_internal(in_data, out_data, max_idx, params, layer_parallelize);
+#endif
 }
 
-inline void maxpool_grad_op_avx(tensor_t &prev_delta,
-                                const tensor_t &curr_delta,
-                                std::vector<std::vector<size_t>> &max_idx,
-                                const std::vector<size_t> &in2out,
-                                const bool layer_parallelize) {
-  maxpool_grad_op_internal(prev_delta, curr_delta, max_idx, in2out,
+// the backward pass is a scatter of one value per window, which AVX
+// (without scatter stores) can't do better than the scalar loop
+inline void maxpool_grad_op_avx(
+  tensor_t &prev_delta,
+  const tensor_t &curr_delta,
+  const std::vector<std::vector<core::maxpool_index_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+  maxpool_grad_op_internal(prev_delta, curr_delta, max_idx, params,
                            layer_parallelize);
 }
 
@@ -10,48 +10,89 @@
 #include <limits>
 #include <vector>
 
+#include "tiny_dnn/core/params/maxpool_params.h"
+
 namespace tiny_dnn {
 namespace kernels {
 
-inline void maxpool_op_internal(const tensor_t &in_data,
-                                tensor_t &out_data,
-                                std::vector<std::vector<size_t>> &max_idx,
-                                const std::vector<std::vector<size_t>> &out2in,
-                                const bool layer_parallelize) {
-  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
-    const vec_t &in          = in_data[sample];
-    vec_t &out               = out_data[sample];
-    std::vector<size_t> &max = max_idx[sample];
-
-    for (size_t i = 0; i < out2in.size(); i++) {
-      const auto &in_index = out2in[i];
-      float_t max_value    = std::numeric_limits<float_t>::lowest();
-      size_t idx           = 0;
-      for (auto j : in_index) {
-        if (in[j] > max_value) {
-          max_value = in[j];
-          idx       = j;
+/**
+ * max-pools output columns [ox_begin, ox_end) of one output row.
+ * the window of output ox starts at column ox * stride_x of in_row, and the
+ * argmax is recorded as its offset (dy * pool_size_x + dx) in the window.
+ **/
+inline void maxpool_row_internal(const float_t *in_row,
+                                 size_t window_height,
+                                 size_t ox_begin,
+                                 size_t ox_end,
+                                 const core::maxpool_params &params,
+                                 float_t *out_row,
+                                 core::maxpool_index_t *max_row) {
+  const size_t in_width = params.in.width_;
+
+  for (size_t ox = ox_begin; ox < ox_end; ox++) {
+    const float_t *window = in_row + ox * params.stride_x;
+    const size_t dxmax    = params.window_width(ox);
+    float_t max_value     = std::numeric_limits<float_t>::lowest();
+    size_t idx            = 0;
+
+    for (size_t dy = 0; dy < window_height; dy++) {
+      for (size_t dx = 0; dx < dxmax; dx++) {
+        if (window[dy * in_width + dx] > max_value) {
+          max_value = window[dy * in_width + dx];
+          idx       = dy * params.pool_size_x + dx;
         }
       }
-      max[i] = idx;
-      out[i] = max_value;
+    }
+    max_row[ox] = static_cast<core::maxpool_index_t>(idx);
+    out_row[ox] = max_value;
+  }
+}
+
+inline void maxpool_op_internal(
+  const tensor_t &in_data,
+  tensor_t &out_data,
+  std::vector<std::vector<core::maxpool_index_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
+  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
+    const vec_t &in                         = in_data[sample];
+    vec_t &out                              = out_data[sample];
+    std::vector<core::maxpool_index_t> &max = max_idx[sample];
+
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        const size_t o = params.out.get_index(0, oy, c);
+        const size_t i = params.in.get_index(0, oy * params.stride_y, c);
+        maxpool_row_internal(&in[i], params.window_height(oy), 0,
+                             params.out.width_, params, &out[o], &max[o]);
+      }
     }
   });
 }
 
-inline void maxpool_grad_op_internal(tensor_t &prev_delta,
-                                     const tensor_t &curr_delta,
-                                     std::vector<std::vector<size_t>> &max_idx,
-                                     const std::vector<size_t> &in2out,
-                                     const bool layer_parallelize) {
+inline void maxpool_grad_op_internal(
+  tensor_t &prev_delta,
+  const tensor_t &curr_delta,
+  const std::vector<std::vector<core::maxpool_index_t>> &max_idx,
+  const core::maxpool_params &params,
+  const bool layer_parallelize) {
   for_i(layer_parallelize, prev_delta.size(), [&](size_t sample) {
-    vec_t &prev                    = prev_delta[sample];
-    const vec_t &curr              = curr_delta[sample];
-    const std::vector<size_t> &max = max_idx[sample];
+    vec_t &prev                                   = prev_delta[sample];
+    const vec_t &curr                             = curr_delta[sample];
+    const std::vector<core::maxpool_index_t> &max = max_idx[sample];
 
-    for (size_t i = 0; i < in2out.size(); i++) {
-      size_t outi = in2out[i];
-      prev[i]     = (max[outi] == i) ? curr[outi] : float_t{0};
+    // prev_delta is zero-initialized by the caller; accumulating keeps
+    // overlapping windows (stride < pool size) correct
+    for (size_t c = 0; c < params.out.depth_; c++) {
+      for (size_t oy = 0; oy < params.out.height_; oy++) {
+        for (size_t ox = 0; ox < params.out.width_; ox++) {
+          const size_t o  = params.out.get_index(ox, oy, c);
+          const size_t dy = max[o] / params.pool_size_x;
+          const size_t dx = max[o] % params.pool_size_x;
+          prev[params.in.get_index(ox * params.stride_x + dx,
+                                   oy * params.stride_y + dy, c)] += curr[o];
+        }
+      }
     }
   });
 }
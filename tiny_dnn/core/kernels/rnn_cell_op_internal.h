@@ -7,11 +7,18 @@
 */
 #pragma once
 
+#include <algorithm>
+
+#include "tiny_dnn/core/kernels/cell_op_internal.h"
 #include "tiny_dnn/core/params/rnn_cell_params.h"
 
 namespace tiny_dnn {
 namespace kernels {
 
+/**
+ * h(t) = f(U x(t) + W h(t-1) + b) and o(t) = V h(t) + c are computed for the
+ * whole batch at once, with one GEMM per weight matrix.
+ **/
 inline void rnn_cell_op_internal(const tensor_t &in_data,
                                  const tensor_t &prev_h,
                                  const vec_t &U,
@@ -23,46 +30,51 @@ inline void rnn_cell_op_internal(const tensor_t &in_data,
                                  tensor_t &out_h,
                                  const core::rnn_cell_params &params,
                                  const bool layer_parallelize) {
-  for_i(layer_parallelize, in_data.size(), [&](size_t sample) {
-    const vec_t &in         = in_data[sample];
-    const vec_t &prev_state = prev_h[sample];
-    vec_t &out              = out_data[sample];
-    vec_t &next_state       = out_h[sample];
-
-    for (size_t o = 0; o < params.out_size_; o++) {
-      float_t next_state_ = 0;
-
-      // W * h(t-1)
-      for (size_t o_2 = 0; o_2 < params.out_size_; o_2++) {
-        next_state_ += W[o_2 * params.out_size_ + o] * prev_state[o_2];
-      }
-
-      // U*x(t)
-      for (size_t i = 0; i < params.in_size_; i++) {
-        next_state_ += U[i * params.out_size_ + o] * in[i];
-      }
-
-      if (params.has_bias_) {
-        next_state_ += bias[o];
-      }
-      next_state[o] = next_state_;
-    }
+  const size_t batch_size = in_data.size();
+  const size_t in_size    = params.in_size_;
+  const size_t out_size   = params.out_size_;
+
+  core::cell_workspace local;
+  core::cell_workspace &ws = params.workspace_ ? *params.workspace_ : local;
+  vec_t &hs                = ws.hs;
+  vec_t &states            = ws.gates;
+  vec_t &outs              = ws.aux;
+
+  // b + U*x(t), unless the recurrent layer projected the whole sequence
+  if (params.x_projection_) {
+    states.assign(params.x_projection_,
+                  params.x_projection_ + batch_size * out_size);
+  } else {
+    cell_project_inputs(layer_parallelize, in_data, in_size, U, bias,
+                        params.has_bias_, out_size, states, ws.xs);
+  }
+  if (params.has_bias_) {
+    cell_broadcast_row(c, batch_size, outs);
+  } else {
+    outs.assign(batch_size * out_size, float_t{0});
+  }
 
-    params.activation_->forward_activation(next_state, next_state);
+  // W*h(t-1)
+  cell_pack_batch(prev_h, out_size, hs);
+  cell_batch_gemm<false>(layer_parallelize, batch_size, out_size, out_size,
+                         &hs[0], out_size, &W[0], &states[0], out_size);
 
-    // V matrix is out_size_ x out_size_
-    for (size_t o = 0; o < params.out_size_; o++) {
-      float_t out_ = 0;
-      for (size_t o_2 = 0; o_2 < params.out_size_; o_2++) {
-        out_ += V[o_2 * params.out_size_ + o] * next_state[o_2];
-      }
-
-      if (params.has_bias_) {
-        out_ += c[o];
-      }
-      out[o] = out_;
-    }
+  for_i(layer_parallelize, batch_size, [&](size_t sample) {
+    vec_t &next_state = out_h[sample];
+    std::copy(&states[sample * out_size], &states[sample * out_size] + out_size,
+              next_state.begin());
+    params.activation_->forward_activation(next_state, next_state);
+    std::copy(next_state.begin(), next_state.end(),
+              &states[sample * out_size]);
   });
+
+  // V*h(t)
+  cell_batch_gemm<false>(layer_parallelize, batch_size, out_size, out_size,
+                         &states[0], out_size, &V[0], &outs[0], out_size);
+  for (size_t sample = 0; sample < batch_size; sample++) {
+    std::copy(&outs[sample * out_size], &outs[sample * out_size] + out_size,
+              out_data[sample].begin());
+  }
 }
 
 inline void rnn_cell_op_internal(const tensor_t &prev_out,
@@ -82,80 +94,50 @@ inline void rnn_cell_op_internal(const tensor_t &prev_out,
                                  const tensor_t &out_h,
                                  const core::rnn_cell_params &params,
                                  const bool layer_parallelize) {
-  for (size_t sample = 0; sample < prev_out.size(); sample++) {
-    const vec_t &prev_out_          = prev_out[sample];
-    const vec_t &prev_h_            = prev_h[sample];
-    vec_t &dU_                      = dU[sample];
-    vec_t &dW_                      = dW[sample];
-    vec_t &dV_                      = dV[sample];
-    vec_t &db_                      = db[sample];
-    vec_t &dc_                      = dc[sample];
-    const vec_t &curr_output_delta_ = curr_output_delta[sample];
-    vec_t &curr_state_delta_        = curr_state_delta[sample];
-    vec_t &prev_output_delta_       = prev_output_delta[sample];
-    vec_t &prev_state_delta_        = prev_state_delta[sample];
-    const vec_t &out_h_             = out_h[sample];
-
-    // from output to h
-    for (size_t o = 0; o < params.out_size_; o++) {
-      // propagate delta from output to h.
-      curr_state_delta_[o] += vectorize::dot(
-        &curr_output_delta_[0], &V[o * params.out_size_], params.out_size_);
-    }
+  const size_t batch_size = prev_out.size();
+  const size_t in_size    = params.in_size_;
+  const size_t out_size   = params.out_size_;
+
+  // propagate delta from output to h
+  vec_t d_outs, d_states(batch_size * out_size);
+  cell_pack_batch(curr_output_delta, out_size, d_outs);
+  cell_batch_gemm<true>(layer_parallelize, batch_size, out_size, out_size,
+                        &d_outs[0], out_size, &V[0], &d_states[0], out_size);
+  cell_accumulate_batch(d_states, out_size, curr_state_delta);
+
+  for_i(layer_parallelize, batch_size, [&](size_t sample) {
+    const vec_t &prev_h_     = prev_h[sample];
+    const vec_t &out_h_      = out_h[sample];
+    vec_t &curr_state_delta_ = curr_state_delta[sample];
+    const float_t *d_out     = &d_outs[sample * out_size];
 
     // h'(t)
     params.activation_->backward_activation(prev_h_, out_h_, curr_state_delta_,
                                             curr_state_delta_);
-
-    // \delta h(t) -W-> h(t-1)
-    for (size_t o = 0; o < params.out_size_; o++) {
-      prev_state_delta_[o] += vectorize::dot(
-        &curr_state_delta_[0], &W[o * params.out_size_], params.out_size_);
-    }
-
-    // \delta h(t) -U-> \delta x(t)
-    for (size_t i = 0; i < params.in_size_; i++) {
-      prev_output_delta_[i] += vectorize::dot(
-        &curr_state_delta_[0], &U[i * params.out_size_], params.out_size_);
+    std::copy(curr_state_delta_.begin(), curr_state_delta_.end(),
+              &d_states[sample * out_size]);
+
+    // accumulate weight-step using delta
+    cell_outer_product(out_size, out_size, &out_h_[0], d_out, &dV[sample][0]);
+    cell_outer_product(out_size, out_size, &prev_h_[0], &curr_state_delta_[0],
+                       &dW[sample][0]);
+    cell_outer_product(in_size, out_size, &prev_out[sample][0],
+                       &curr_state_delta_[0], &dU[sample][0]);
+
+    if (params.has_bias_) {
+      vectorize::add(d_out, out_size, &dc[sample][0]);
+      vectorize::add(&curr_state_delta_[0], out_size, &db[sample][0]);
     }
+  });
 
-    for_(layer_parallelize, 0, size_t(params.out_size_),
-         [&](const blocked_range &r) {
-           // accumulate weight-step using delta
-           // dW[c * out_size + i] += current_delta[i] * prev_out[o]
-           const size_t begin  = r.begin();
-           const size_t end    = r.end();
-           const size_t stride = end - begin;
-           for (size_t o = 0; o < params.out_size_; o++) {
-             vectorize::muladd(&curr_output_delta_[begin], out_h_[o], stride,
-                               &dV_[o * params.out_size_ + begin]);
-           }
-
-           if (params.has_bias_) {
-             // vec_t& dc;
-             for (size_t o = begin; o < end; o++) {
-               dc_[o] += curr_output_delta_[o];
-             }
-           }
-
-           for (size_t o = 0; o < params.out_size_; o++) {
-             vectorize::muladd(&curr_state_delta_[begin], prev_h_[o], stride,
-                               &dW_[o * params.out_size_ + begin]);
-           }
-
-           for (size_t i = 0; i < params.in_size_; i++) {
-             vectorize::muladd(&curr_state_delta[sample][begin], prev_out_[i],
-                               stride, &dU_[i * params.out_size_ + begin]);
-           }
-
-           if (params.has_bias_) {
-             // vec_t& db;
-             for (size_t o = begin; o < end; o++) {
-               db_[o] += curr_state_delta_[o];
-             }
-           }
-         });
-  }
+  // \delta h(t) -W-> h(t-1), \delta h(t) -U-> \delta x(t)
+  vec_t d_hs(batch_size * out_size), d_xs(batch_size * in_size);
+  cell_batch_gemm<true>(layer_parallelize, batch_size, out_size, out_size,
+                        &d_states[0], out_size, &W[0], &d_hs[0], out_size);
+  cell_batch_gemm<true>(layer_parallelize, batch_size, in_size, out_size,
+                        &d_states[0], out_size, &U[0], &d_xs[0], in_size);
+  cell_accumulate_batch(d_hs, out_size, prev_state_delta);
+  cell_accumulate_batch(d_xs, in_size, prev_output_delta);
 }
 
 }  // namespace kernels
@@ -0,0 +1,148 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#ifdef CNN_USE_AVX
+#include "tiny_dnn/core/kernels/avx_kernel_common.h"
+#endif
+
+namespace tiny_dnn {
+namespace kernels {
+
+/**
+ * rows x cols matrix in compressed sparse row format: the non-zero values of
+ * row r are values[row_ptr[r] .. row_ptr[r + 1]), in the columns given by
+ * columns[] at the same positions.
+ **/
+struct csr_matrix {
+  size_t rows = 0;
+  size_t cols = 0;
+  vec_t values;
+  std::vector<uint32_t> columns;
+  std::vector<uint32_t> row_ptr;
+
+  size_t nnz() const { return values.size(); }
+};
+
+/**
+ * the non-zero weights of fully_connected_layer, whose W[c * out_size + i]
+ * connects input c to output i, as an out_size x in_size CSR matrix
+ **/
+inline csr_matrix dense_to_csr(const vec_t &W,
+                               size_t in_size,
+                               size_t out_size) {
+  csr_matrix m;
+  m.rows = out_size;
+  m.cols = in_size;
+  m.row_ptr.assign(1, 0);
+  for (size_t i = 0; i < out_size; i++) {
+    for (size_t c = 0; c < in_size; c++) {
+      const float_t w = W[c * out_size + i];
+      if (w == float_t{0}) continue;
+      m.values.push_back(w);
+      m.columns.push_back(static_cast<uint32_t>(c));
+    }
+    m.row_ptr.push_back(static_cast<uint32_t>(m.values.size()));
+  }
+  return m;
+}
+
+// samples multiplied together by the sparse kernel
+static const size_t sparse_block_size = 8;
+
+/**
+ * acc[s] += sum_k values[k] * x[columns[k] * sparse_block_size + s] for the
+ * sparse_block_size samples s of a block of x, stored input by input
+ **/
+inline void sparse_row_block(const float_t *values,
+                             const uint32_t *columns,
+                             size_t n,
+                             const float_t *x,
+                             float_t *acc) {
+#if defined(CNN_USE_AVX) && !defined(CNN_USE_DOUBLE)
+  static_assert(sparse_block_size == 8, "one __m256 per block");
+  __m256 sum0 = _mm256_loadu_ps(acc);
+  __m256 sum1 = _mm256_setzero_ps();
+  size_t k    = 0;
+  for (; k + 2 <= n; k += 2) {
+    const float *x0 = x + columns[k] * sparse_block_size;
+    const float *x1 = x + columns[k + 1] * sparse_block_size;
+    sum0 = madd256_ps(_mm256_set1_ps(values[k]), _mm256_load_ps(x0), sum0);
+    sum1 = madd256_ps(_mm256_set1_ps(values[k + 1]), _mm256_load_ps(x1), sum1);
+  }
+  if (k < n) {
+    const float *x0 = x + columns[k] * sparse_block_size;
+    sum0 = madd256_ps(_mm256_set1_ps(values[k]), _mm256_load_ps(x0), sum0);
+  }
+  _mm256_storeu_ps(acc, _mm256_add_ps(sum0, sum1));
+#else
+  for (size_t k = 0; k < n; k++) {
+    const float_t *xk = x + columns[k] * sparse_block_size;
+    for (size_t s = 0; s < sparse_block_size; s++) acc[s] += values[k] * xk[s];
+  }
+#endif
+}
+
+/**
+ * out[s][i] = bias[i] + sum_c W(i, c) * in[s][c], only visiting the non-zero
+ * weights of W.
+ *
+ * the batch is processed by blocks of sparse_block_size samples, gathered
+ * input by input, so that every non-zero weight is loaded once per block and
+ * multiplied by a whole vector of samples.
+ *
+ * @param bias [in] empty when the layer has no bias
+ **/
+inline void sparse_fully_connected_kernel(const csr_matrix &W,
+                                          const vec_t &bias,
+                                          const tensor_t &in_data,
+                                          tensor_t &out_data,
+                                          const bool layer_parallelize) {
+  const size_t B = sparse_block_size;
+  vec_t x(W.cols * B);
+
+  for (size_t begin = 0; begin < in_data.size(); begin += B) {
+    const size_t n = std::min(B, in_data.size() - begin);
+    if (n == 1) {
+      // a single sample gathers its inputs row by row
+      const vec_t &in = in_data[begin];
+      vec_t &out      = out_data[begin];
+      for_i(layer_parallelize, W.rows, [&](size_t i) {
+        float_t sum = bias.empty() ? float_t{0} : bias[i];
+        for (size_t k = W.row_ptr[i]; k < W.row_ptr[i + 1]; k++) {
+          sum += W.values[k] * in[W.columns[k]];
+        }
+        out[i] = sum;
+      });
+      continue;
+    }
+    if (n < B) std::fill(x.begin(), x.end(), float_t{0});
+    for (size_t s = 0; s < n; s++) {
+      const vec_t &in = in_data[begin + s];
+      for (size_t c = 0; c < W.cols; c++) x[c * B + s] = in[c];
+    }
+
+    for_(layer_parallelize, 0, W.rows, [&](const blocked_range &r) {
+      float_t acc[sparse_block_size];
+      for (size_t i = r.begin(); i < r.end(); i++) {
+        std::fill(acc, acc + B, bias.empty() ? float_t{0} : bias[i]);
+        const size_t k = W.row_ptr[i];
+        sparse_row_block(W.values.data() + k, W.columns.data() + k,
+                         W.row_ptr[i + 1] - k, x.data(), acc);
+        for (size_t s = 0; s < n; s++) out_data[begin + s][i] = acc[s];
+      }
+    });
+  }
+}
+
+}  // namespace kernels
+}  // namespace tiny_dnn
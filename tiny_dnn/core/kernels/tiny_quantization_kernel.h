@@ -8,6 +8,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
 #include <limits>
 #include <vector>
 
@@ -113,6 +114,23 @@ void quantization_range_for_multiplication(float_t min_a,
   *max_c = c_float_for_one_quant_level * c_highest;
 }
 
+// the ranges of the products of a with each output channel of b, whose
+// channels have their own ranges
+template <class T1, class T2, class T3>
+void quantization_range_for_multiplication(float_t min_a,
+                                           float_t max_a,
+                                           const std::vector<float_t> &min_b,
+                                           const std::vector<float_t> &max_b,
+                                           std::vector<float_t> *min_c,
+                                           std::vector<float_t> *max_c) {
+  min_c->resize(min_b.size());
+  max_c->resize(min_b.size());
+  for (size_t i = 0; i < min_b.size(); i++) {
+    quantization_range_for_multiplication<T1, T2, T3>(
+      min_a, max_a, min_b[i], max_b[i], &(*min_c)[i], &(*max_c)[i]);
+  }
+}
+
 template <class T1, class T2>
 inline T2 requantize_in_new_range(T1 input,
                                   float_t min_input,
@@ -151,19 +169,18 @@ inline void requantize_many_in_new_range<int32_t, uint8_t>(int32_t *input,
                                                            float_t max_output,
                                                            uint8_t *output) {
   // Initially we calculate all the constants we need once, before we go into
-  // the inner loop.
-  const int fp_shift             = 16;
-  const float input_range        = max_input - min_input;
-  const float output_range       = max_output - min_output;
-  const float recip_output_range = (255.0f / output_range);
-  const int64_t recip_output_range_fp =
-    static_cast<int64_t>(recip_output_range * (1 << fp_shift));
+  // the inner loop. They are taken in double, and the offset holds the whole
+  // distance from min_output to the middle of the input range: its terms are
+  // far larger than one output step and nearly cancel, and rounding them
+  // apart in float moved the outputs by up to two steps.
+  const int fp_shift           = 16;
+  const double input_range     = static_cast<double>(max_input) - min_input;
+  const double output_range    = static_cast<double>(max_output) - min_output;
+  const double output_scale_fp = (255.0 / output_range) * (1 << fp_shift);
   const int64_t range_scale_fp =
-    static_cast<int64_t>(255.0f * (1 << fp_shift) * input_range / output_range);
-  const int64_t input_offset_fp = static_cast<int64_t>(
-    (min_input * recip_output_range_fp) + (range_scale_fp >> 1));
-  const int64_t output_offset_fp =
-    static_cast<int64_t>(round((min_output * 255.0f) / output_range));
+    static_cast<int64_t>(round(output_scale_fp * input_range));
+  const int64_t offset_fp = static_cast<int64_t>(
+    round((min_input + input_range / 2 - min_output) * output_scale_fp));
   const int64_t rounding_delta = 1 << (fp_shift - 1);
   // Inside this loop we just do minimal adds, multiplies, and shifts, in a
   // way
@@ -173,12 +190,8 @@ inline void requantize_many_in_new_range<int32_t, uint8_t>(int32_t *input,
   for (size_t index = 0; index < count; ++index) {
     const int64_t input_value = static_cast<int64_t>(input[index]);
     const int64_t fp_value =
-      ((input_value * range_scale_fp) >> 32) + input_offset_fp;
-    const int64_t round_intermediate =
-      ((fp_value >= 0) ? (fp_value + rounding_delta)
-                       : (fp_value - rounding_delta)) >>
-      fp_shift;
-    int64_t quantized_int64 = (round_intermediate - output_offset_fp);
+      ((input_value * range_scale_fp) >> 32) + offset_fp;
+    int64_t quantized_int64 = (fp_value + rounding_delta) >> fp_shift;
     quantized_int64         = std::max<int64_t>(quantized_int64, 0LL);
     quantized_int64         = std::min<int64_t>(quantized_int64, 255LL);
     output[index] = static_cast<uint8_t>(static_cast<int32_t>(quantized_int64));
@@ -253,6 +266,261 @@ void quantize_down_and_shrink_range(std::vector<T1> &input,
                                                  *max_new, &(*output)[0]);
 }
 
+/**
+ * uint8 filter and bias of a quantized layer, with the float ranges they were
+ * quantized from. the layers keep one so that the weights are quantized once
+ * rather than on every forward call.
+ **/
+struct quantized_weights {
+  std::vector<uint8_t> W;
+  std::vector<uint8_t> bias;
+  float_t min_filter = 0;
+  float_t max_filter = 0;
+  // range of each output channel of W, empty when all the channels share
+  // [min_filter, max_filter]
+  std::vector<float_t> min_filters;
+  std::vector<float_t> max_filters;
+  float_t min_bias   = 0;
+  float_t max_bias   = 0;
+  bool valid         = false;  // cleared whenever the float weights change
+
+  // static range of the input found by calibration. when unset, the range
+  // of each input is scanned on every call.
+  bool has_input_range = false;
+  float_t min_input    = 0;
+  float_t max_input    = 0;
+  // the input already holds the uint8 codes of [min_input, max_input]
+  bool quantized_input = false;
+
+  // static range of the output. when set, the output holds the uint8 codes
+  // of [min_output, max_output] rather than floats.
+  bool has_output_range = false;
+  float_t min_output    = 0;
+  float_t max_output    = 0;
+};
+
+/**
+ * the uint8 input of a quantized layer, and its range: the codes of an input
+ * already quantized, or the input quantized to the static range of q or to
+ * its own range.
+ **/
+inline std::vector<uint8_t> quantize_input(const vec_t &in,
+                                           const quantized_weights &q,
+                                           float_t *min_input,
+                                           float_t *max_input) {
+  *min_input = q.min_input;
+  *max_input = q.max_input;
+  if (q.quantized_input) {
+    std::vector<uint8_t> codes(in.size());
+    for (size_t i = 0; i < in.size(); i++) {
+      codes[i] = static_cast<uint8_t>(in[i]);
+    }
+    return codes;
+  }
+  if (!q.has_input_range) {
+    const auto input_range = std::minmax_element(in.begin(), in.end());
+    *min_input             = *input_range.first;
+    *max_input             = *input_range.second;
+  }
+  return float_tensor_to_quantized<uint8_t>(in, *min_input, *max_input);
+}
+
+/**
+ * the output of a quantized layer from its int32 accumulators in
+ * [min_acc, max_acc]: the uint8 codes of the static output range of q, or
+ * floats requantized through the range actually used by the accumulators.
+ **/
+inline void requantize_output(std::vector<int32_t> &acc,
+                              float_t min_acc,
+                              float_t max_acc,
+                              const quantized_weights &q,
+                              vec_t &out) {
+  std::vector<uint8_t> requantized(acc.size(), static_cast<uint8_t>(0));
+  if (q.has_output_range) {
+    requantize_many_in_new_range<int32_t, uint8_t>(
+      &acc[0], acc.size(), min_acc, max_acc, q.min_output, q.max_output,
+      &requantized[0]);
+    out.assign(requantized.begin(), requantized.end());
+    return;
+  }
+  float_t min_output_requantized;
+  float_t max_output_requantized;
+  quantize_down_and_shrink_range<int32_t, uint8_t>(
+    acc, min_acc, max_acc, &min_output_requantized, &max_output_requantized,
+    &requantized);
+  out = quantized_tensor_to_float<uint8_t>(requantized, min_output_requantized,
+                                           max_output_requantized);
+}
+
+inline void quantize_filter(const vec_t &W,
+                            float_t min_filter,
+                            float_t max_filter,
+                            quantized_weights *q) {
+  if (min_filter == max_filter) {
+    max_filter = W[0] + 1e-3f;
+    min_filter = W[0] - 1e-3f;
+  }
+  q->W          = float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+  q->min_filter = min_filter;
+  q->max_filter = max_filter;
+  q->min_filters.clear();
+  q->max_filters.clear();
+}
+
+/**
+ * quantize each output channel of W to its own range, so that channels of
+ * small weights keep their precision next to channels of large ones. the
+ * k-th weight of channel o is W[o * channel_stride + k * weight_stride].
+ **/
+inline void quantize_filter_per_channel(const vec_t &W,
+                                        size_t channels,
+                                        size_t channel_stride,
+                                        size_t weight_stride,
+                                        quantized_weights *q) {
+  const size_t size = W.size() / channels;
+  q->W.resize(W.size());
+  q->min_filters.resize(channels);
+  q->max_filters.resize(channels);
+  for (size_t o = 0; o < channels; o++) {
+    const float_t *w = &W[o * channel_stride];
+    float_t min_filter(w[0]);
+    float_t max_filter(w[0]);
+    for (size_t k = 0; k < size; k++) {
+      min_filter = std::min(min_filter, w[k * weight_stride]);
+      max_filter = std::max(max_filter, w[k * weight_stride]);
+    }
+    if (min_filter == max_filter) {
+      max_filter = w[0] + 1e-3f;
+      min_filter = w[0] - 1e-3f;
+    }
+    for (size_t k = 0; k < size; k++) {
+      const size_t idx = o * channel_stride + k * weight_stride;
+      q->W[idx] = float_to_quantized<uint8_t>(W[idx], min_filter, max_filter);
+    }
+    q->min_filters[o] = min_filter;
+    q->max_filters[o] = max_filter;
+  }
+  q->min_filter =
+    *std::min_element(q->min_filters.begin(), q->min_filters.end());
+  q->max_filter =
+    *std::max_element(q->max_filters.begin(), q->max_filters.end());
+}
+
+/**
+ * round W in place to the values of its quantization by
+ * quantize_filter_per_channel(), as seen by a quantized layer
+ **/
+inline void fake_quantize_filter_per_channel(vec_t &W,
+                                             size_t channels,
+                                             size_t channel_stride,
+                                             size_t weight_stride) {
+  quantized_weights q;
+  quantize_filter_per_channel(W, channels, channel_stride, weight_stride, &q);
+  const size_t size = W.size() / channels;
+  for (size_t o = 0; o < channels; o++) {
+    for (size_t k = 0; k < size; k++) {
+      const size_t idx = o * channel_stride + k * weight_stride;
+      W[idx] = quantized_to_float<uint8_t>(q.W[idx], q.min_filters[o],
+                                           q.max_filters[o]);
+    }
+  }
+}
+
+// the range of the first size elements of bias, widened to include zero
+inline void quantize_bias(const vec_t &bias,
+                          size_t size,
+                          quantized_weights *q) {
+  float_t min_bias(0);
+  float_t max_bias(0);
+  for (size_t i = 0; i < size; i++) {
+    min_bias = std::min(min_bias, bias[i]);
+    max_bias = std::max(max_bias, bias[i]);
+  }
+  if (min_bias == max_bias) {
+    max_bias = bias[0] + 1e-3f;
+    min_bias = bias[0] - 1e-3f;
+  }
+  q->bias     = float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
+  q->min_bias = min_bias;
+  q->max_bias = max_bias;
+}
+
+// the i-th quantized bias of q in the int32 space of the accumulator, whose
+// zero is zero_output
+inline int32_t quantized_bias_in_output_range(const quantized_weights &q,
+                                              size_t i,
+                                              float_t min_output,
+                                              float_t max_output,
+                                              int32_t zero_output) {
+  return requantize_in_new_range<uint8_t, int32_t>(
+           q.bias[i], q.min_bias, q.max_bias, min_output, max_output) -
+         zero_output;
+}
+
+/**
+ * requantization of the int32 accumulators of a product with a filter
+ * quantized per output channel. the accumulators of each channel are in the
+ * range of that channel, and are rescaled to the range of the widest one so
+ * that all of them requantize to 8 bits together.
+ **/
+struct channel_requantization {
+  std::vector<float_t> min_output;      // accumulator range of each channel
+  std::vector<float_t> max_output;
+  std::vector<int32_t> offset_filter;   // quantized 0 of each channel filter
+  std::vector<int32_t> zero_output;     // quantized 0 of each channel output
+  std::vector<double> scale;            // from each channel to the common one
+  float_t min_common = 0;
+  float_t max_common = 0;
+
+  channel_requantization(float_t min_input,
+                         float_t max_input,
+                         const quantized_weights &q,
+                         size_t channels) {
+    std::vector<float_t> min_filters(q.min_filters), max_filters(q.max_filters);
+    if (min_filters.empty()) {
+      min_filters.assign(channels, q.min_filter);
+      max_filters.assign(channels, q.max_filter);
+    }
+    quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
+      min_input, max_input, min_filters, max_filters, &min_output,
+      &max_output);
+
+    size_t widest = 0;
+    for (size_t o = 1; o < channels; o++) {
+      if (max_output[o] - min_output[o] >
+          max_output[widest] - min_output[widest]) {
+        widest = o;
+      }
+    }
+    min_common = min_output[widest];
+    max_common = max_output[widest];
+
+    offset_filter.resize(channels);
+    zero_output.resize(channels);
+    scale.resize(channels);
+    for (size_t o = 0; o < channels; o++) {
+      offset_filter[o] = int64_to_int32(float_to_quantized_unclamped<uint8_t>(
+        0.0f, min_filters[o], max_filters[o]));
+      zero_output[o] = int64_to_int32(
+        float_to_quantized<int32_t>(0.0f, min_output[o], max_output[o]));
+      scale[o] = (static_cast<double>(max_output[o]) - min_output[o]) /
+                 (static_cast<double>(max_common) - min_common);
+    }
+  }
+
+  // accumulator of channel o, plus the bias of q if any, in the common range
+  int32_t to_common(const quantized_weights &q,
+                    size_t o,
+                    int32_t acc,
+                    bool has_bias) const {
+    if (has_bias) {
+      acc += quantized_bias_in_output_range(q, o, min_output[o], max_output[o],
+                                            zero_output[o]);
+    }
+    return static_cast<int32_t>(std::round(acc * scale[o]));
+  }
+};
+
 }  // namespace kernels
 }  // namespace core
 }  // namespace tiny_dnn
@@ -11,140 +11,132 @@
 #include <vector>
 
 #include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_gemm_kernel.h"
 #include "tiny_dnn/core/params/conv_params.h"
 
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_conv2d_kernel(const conv_params &params,
-                                         const vec_t &in,
+/**
+ * a_quantized += conv((in_quantized - offset_input),
+ *                     (W_quantized - offset_filter[o]))
+ * lowered onto tiny_quantized_gemm(): the filters are the rows of A, and the
+ * padded image is gathered into one row of in.depth * kh * kw inputs per
+ * output position.
+ **/
+inline void tiny_quantized_conv2d_accumulate(
+  const conv_params &params,
+  const std::vector<uint8_t> &in_quantized,
+  int32_t offset_input,
+  const std::vector<uint8_t> &W_quantized,
+  const int32_t *offset_filter,
+  std::vector<int32_t> &a_quantized,
+  const bool layer_parallelize) {
+  const size_t kw   = params.weight.width_;
+  const size_t kk   = params.weight.width_ * params.weight.height_;
+  const size_t K    = params.in.depth_ * kk;
+  const size_t area = params.out.width_ * params.out.height_;
+
+  std::vector<uint8_t> col(area * K);
+  for_i(layer_parallelize, params.out.height_, [&](size_t y) {
+    for (size_t x = 0; x < params.out.width_; x++) {
+      uint8_t *dst = &col[(y * params.out.width_ + x) * K];
+      for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        for (size_t wy = 0; wy < params.weight.height_; wy++) {
+          const uint8_t *src = &in_quantized[params.in_padded.get_index(
+            x * params.w_stride, y * params.h_stride + wy, inc)];
+          dst = std::copy(src, src + kw, dst);
+        }
+      }
+    }
+  });
+
+  for_(layer_parallelize, 0, params.out.depth_, [&](const blocked_range &r) {
+    const size_t o = r.begin();
+    if (params.tbl.is_empty()) {
+      tiny_quantized_gemm(r.end() - o, area, K, &W_quantized[o * K], K,
+                          &offset_filter[o], &col[0], K, offset_input,
+                          &a_quantized[o * area], area);
+      return;
+    }
+    // one product per connected (output, input) channel pair
+    for (size_t oc = o; oc < r.end(); oc++) {
+      for (size_t inc = 0; inc < params.in.depth_; inc++) {
+        if (!params.tbl.is_connected(oc, inc)) continue;
+        tiny_quantized_gemm(1, area, kk, &W_quantized[oc * K + inc * kk], kk,
+                            &offset_filter[oc], &col[inc * kk], K,
+                            offset_input, &a_quantized[oc * area], area);
+      }
+    }
+  });
+}
+
+inline void tiny_quantize_conv2d_weights(const conv_params &params,
                                          const vec_t &W,
                                          const vec_t &bias,
+                                         quantized_weights *q) {
+  // filter quantization, one range per output channel
+  const size_t out_channels = params.out.depth_;
+  quantize_filter_per_channel(W, out_channels, W.size() / out_channels, 1, q);
+  // bias quantization
+  q->min_bias = q->max_bias = float_t(0);
+  q->bias.clear();
+  if (params.has_bias) quantize_bias(bias, params.out.depth_, q);
+  q->valid = true;
+}
+
+/**
+ * convolution of a float image with weights already quantized by
+ * tiny_quantize_conv2d_weights(); only the image is quantized here.
+ **/
+inline void tiny_quantized_conv2d_kernel(const conv_params &params,
+                                         const vec_t &in,
+                                         const quantized_weights &q,
                                          vec_t &a,
                                          const bool layer_parallelize) {
   // image quantization
-  float_t min_input(in[0]);
-  float_t max_input(in[0]);
-  for (size_t inc = 0; inc < params.in.depth_; inc++) {
-    for (size_t ins = 0;
-         ins < params.in_padded.height_ * params.in_padded.height_; ins++) {
-      size_t idx = params.in_padded.get_index(0, 0, inc);
-      min_input  = std::min(min_input, (&in[idx])[ins]);
-      max_input  = std::max(max_input, (&in[idx])[ins]);
-    }
-  }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
-  // filter quantization
-  float_t min_filter(W[0]);
-  float_t max_filter(W[0]);
-  for (size_t inc = 0; inc < params.in_padded.depth_; inc++) {
-    for (size_t ins = 0; ins < params.weight.height_ * params.weight.height_;
-         ins++) {
-      size_t idx = params.in_padded.get_index(0, 0, inc);
-      min_filter = std::min(min_filter, (&W[idx])[ins]);
-      max_filter = std::max(max_filter, (&W[idx])[ins]);
-    }
-  }
-  if (min_filter == max_filter) {
-    max_filter = W[0] + 1e-3f;
-    min_filter = W[0] - 1e-3f;
-  }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
-  // bias quantization
-  float_t min_bias(0);
-  float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
-  if (params.has_bias) {
-    for (size_t inc = 0; inc < params.out.depth_; inc++) {
-      min_bias = std::min(min_bias, bias[inc]);
-      max_bias = std::max(max_bias, bias[inc]);
-    }
-    if (min_bias == max_bias) {
-      max_bias = bias[0] + 1e-3f;
-      min_bias = bias[0] - 1e-3f;
-    }
-    bias_quantized =
-      float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
-  }
-  // output range
-  float_t min_output_value;
-  float_t max_output_value;
-  quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-    min_input, max_input, min_filter, max_filter, &min_output_value,
-    &max_output_value);
+  float_t min_input;
+  float_t max_input;
+  const std::vector<uint8_t> in_quantized =
+    quantize_input(in, q, &min_input, &max_input);
+  const std::vector<uint8_t> &W_quantized = q.W;
+  // output range and filter offset of each channel
+  const channel_requantization rq(min_input, max_input, q, params.out.depth_);
 
   std::vector<int32_t> a_quantized(a.size(), static_cast<int32_t>(0));
 
   // calculating offset
   const int32_t offset_input = int64_to_int32(
     float_to_quantized_unclamped<uint8_t>(0.0f, min_input, max_input));
-  const int32_t offset_filter = int64_to_int32(
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_filter, max_filter));
-  const int32_t zero_in_total_space = int64_to_int32(
-    float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
-  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
+  tiny_quantized_conv2d_accumulate(params, in_quantized, offset_input,
+                                   W_quantized, &rq.offset_filter[0],
+                                   a_quantized, layer_parallelize);
 
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx               = params.in_padded.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
-
-      idx                   = params.out.get_index(0, 0, o);
-      int32_t *pa_quantized = &a_quantized[idx];
-
-      for (size_t y = 0; y < params.out.height_; y++) {
-        for (size_t x = 0; x < params.out.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi +
-                               params.in_padded.width_ * (y * params.h_stride) +
-                               x * params.w_stride;
-          int32_t sum = 0;
-
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              idx = wy * params.in_padded.width_ + wx;
-              sum += (static_cast<int32_t>(*ppw++) - offset_filter) *
-                     (static_cast<int32_t>(ppi[idx]) - offset_input);
-            }
-          }
-          pa_quantized[y * params.out.width_ + x] += sum;
-        }
-      }
-    }
-    if (params.has_bias) {
-      int32_t *pa_quantized = &a_quantized[params.out.get_index(0, 0, o)];
-      int32_t *paa_quantized =
-        pa_quantized + params.out.width_ * params.out.height_;
-      std::for_each(pa_quantized, paa_quantized, [&](int32_t &f) {
-        f += (bias_quantized[o] - zero_in_total_space);
-      });
-    }
+  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
+    // bias, and rescaling to the range shared by all the channels
+    int32_t *pa_quantized = &a_quantized[params.out.get_index(0, 0, o)];
+    int32_t *paa_quantized =
+      pa_quantized + params.out.width_ * params.out.height_;
+    std::for_each(pa_quantized, paa_quantized, [&](int32_t &f) {
+      f = rq.to_common(q, o, f, params.has_bias);
+    });
   });
 
-  float_t min_output_requantized;
-  float_t max_output_requantized;
-  std::vector<uint8_t> a_requantized(a_quantized.size(),
-                                     static_cast<uint8_t>(0));
-
   // Requantize from 32bits to 8 bits for next layer
-  quantize_down_and_shrink_range<int32_t, uint8_t>(
-    a_quantized, min_output_value, max_output_value, &min_output_requantized,
-    &max_output_requantized, &a_requantized);
+  requantize_output(a_quantized, rq.min_common, rq.max_common, q, a);
+}
 
-  // dequantize to flaot, this could be removed within concatenated quantized
-  // network
-  a = quantized_tensor_to_float<uint8_t>(a_requantized, min_output_requantized,
-                                         max_output_requantized);
+inline void tiny_quantized_conv2d_kernel(const conv_params &params,
+                                         const vec_t &in,
+                                         const vec_t &W,
+                                         const vec_t &bias,
+                                         vec_t &a,
+                                         const bool layer_parallelize) {
+  quantized_weights q;
+  tiny_quantize_conv2d_weights(params, W, bias, &q);
+  tiny_quantized_conv2d_kernel(params, in, q, a, layer_parallelize);
 }
 
 inline void tiny_quantized_conv2d_back_kernel(const conv_params &params,
@@ -395,41 +387,12 @@ inline void tiny_quantized_conv2d_kernel(const conv_params &params,
   const int32_t zero_in_total_space = int64_to_int32(
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
-  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx               = params.in_padded.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
-
-      idx                   = params.out.get_index(0, 0, o);
-      int32_t *pa_quantized = &a_quantized[idx];
+  const std::vector<int32_t> offset_filters(params.out.depth_, offset_filter);
+  tiny_quantized_conv2d_accumulate(params, in_quantized, offset_input,
+                                   W_quantized, &offset_filters[0],
+                                   a_quantized, layer_parallelize);
 
-      for (size_t y = 0; y < params.out.height_; y++) {
-        for (size_t x = 0; x < params.out.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi +
-                               params.in_padded.width_ * (y * params.h_stride) +
-                               x * params.w_stride;
-          int32_t sum = 0;
-
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              idx = wy * params.in_padded.width_ + wx;
-              sum += (static_cast<int32_t>(*ppw++) - offset_filter) *
-                     (static_cast<int32_t>(ppi[idx]) - offset_input);
-            }
-          }
-          pa_quantized[y * params.out.width_ + x] += sum;
-        }
-      }
-    }
+  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
     if (params.has_bias) {
       int32_t *pa_quantized = &a_quantized[params.out.get_index(0, 0, o)];
       int32_t *paa_quantized =
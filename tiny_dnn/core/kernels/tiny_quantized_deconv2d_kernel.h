@@ -10,31 +10,88 @@
 #include <algorithm>
 #include <vector>
 
+#include "tiny_dnn/core/kernels/deconv2d_col2im.h"
 #include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_gemm_kernel.h"
 #include "tiny_dnn/core/params/deconv_params.h"
 
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
-inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
-                                           const vec_t &in,
-                                           const vec_t &W,
-                                           const vec_t &bias,
-                                           vec_t &out,
-                                           const bool layer_parallelize) {
-  // image quantization
-  float_t min_input(in[0]);
-  float_t max_input(in[0]);
-  for (size_t inc = 0; inc < params.in.depth_; inc++) {
-    for (size_t ins = 0; ins < params.in.height_ * params.in.height_; ins++) {
-      size_t idx = params.in.get_index(0, 0, inc);
-      min_input  = std::min(min_input, (&in[idx])[ins]);
-      max_input  = std::max(max_input, (&in[idx])[ins]);
+/**
+ * out_quantized += deconv((in_quantized - offset_input),
+ *                         (W_quantized - offset_filter))
+ * lowered per output channel onto a GEMM followed by col2im. the uint8
+ * tiny_quantized_gemm() needs the input channels innermost on both sides;
+ * with a connection table, the masked weights are zeroed in an int32 copy
+ * instead.
+ **/
+inline void tiny_quantized_deconv2d_accumulate(
+  const deconv_params &params,
+  const std::vector<uint8_t> &in_quantized,
+  int32_t offset_input,
+  const std::vector<uint8_t> &W_quantized,
+  int32_t offset_filter,
+  std::vector<int32_t> &out_quantized,
+  const bool layer_parallelize) {
+  const size_t in_area  = params.in.width_ * params.in.height_;
+  const size_t kk       = params.weight.width_ * params.weight.height_;
+  const size_t col_size = kk * in_area;
+
+  if (params.tbl.is_empty()) {
+    const size_t depth = params.in.depth_;
+    // in as in_area x depth, and the block of each output as kk x depth
+    std::vector<uint8_t> in_rows(in_quantized.size());
+    for (size_t inc = 0; inc < depth; inc++) {
+      for (size_t j = 0; j < in_area; j++) {
+        in_rows[j * depth + inc] = in_quantized[inc * in_area + j];
+      }
     }
+    std::vector<uint8_t> W_rows(params.weight.size());
+    for (size_t o = 0; o < params.out.depth_; o++) {
+      const uint8_t *src = &W_quantized[o * depth * kk];
+      uint8_t *dst       = &W_rows[o * depth * kk];
+      for (size_t inc = 0; inc < depth; inc++) {
+        for (size_t i = 0; i < kk; i++) {
+          dst[i * depth + inc] = src[inc * kk + i];
+        }
+      }
+    }
+    const std::vector<int32_t> offset_filters(kk, offset_filter);
+
+    for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
+      std::vector<int32_t> col(col_size, 0);
+      tiny_quantized_gemm(kk, in_area, depth, &W_rows[o * depth * kk], depth,
+                          &offset_filters[0], &in_rows[0], depth,
+                          offset_input, &col[0], in_area);
+      deconv2d_col2im(params, &col[0],
+                      &out_quantized[params.out.get_index(0, 0, o)]);
+    });
+    return;
   }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+
+  std::vector<int32_t> in_shifted(params.in.size());
+  for (size_t i = 0; i < in_shifted.size(); i++) {
+    in_shifted[i] = static_cast<int32_t>(in_quantized[i]) - offset_input;
+  }
+  std::vector<int32_t> W_shifted(params.weight.size());
+  for (size_t i = 0; i < W_shifted.size(); i++) {
+    W_shifted[i] = static_cast<int32_t>(W_quantized[i]) - offset_filter;
+  }
+  deconv2d_mask_weight(params, W_shifted);
+
+  for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
+    std::vector<int32_t> col(col_size);
+    deconv2d_gemm_forward(params, &in_shifted[0], &W_shifted[0], o, &col[0],
+                          &out_quantized[params.out.get_index(0, 0, o)]);
+  });
+}
+
+inline void tiny_quantize_deconv2d_weights(const deconv_params &params,
+                                           const vec_t &W,
+                                           const vec_t &bias,
+                                           quantized_weights *q) {
   // filter quantization
   float_t min_filter(W[0]);
   float_t max_filter(W[0]);
@@ -46,28 +103,42 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
       max_filter = std::max(max_filter, (&W[idx])[ins]);
     }
   }
-  if (min_filter == max_filter) {
-    max_filter = W[0] + 1e-3f;
-    min_filter = W[0] - 1e-3f;
-  }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
+  quantize_filter(W, min_filter, max_filter, q);
   // bias quantization
-  float_t min_bias(0);
-  float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
-  if (params.has_bias) {
-    for (size_t inc = 0; inc < params.out.depth_; inc++) {
-      min_bias = std::min(min_bias, bias[inc]);
-      max_bias = std::max(max_bias, bias[inc]);
-    }
-    if (min_bias == max_bias) {
-      max_bias = bias[0] + 1e-3f;
-      min_bias = bias[0] - 1e-3f;
+  q->min_bias = q->max_bias = float_t(0);
+  q->bias.clear();
+  if (params.has_bias) quantize_bias(bias, params.out.depth_, q);
+  q->valid = true;
+}
+
+/**
+ * deconvolution of a float image with weights already quantized by
+ * tiny_quantize_deconv2d_weights(); only the image is quantized here.
+ **/
+inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
+                                           const vec_t &in,
+                                           const quantized_weights &q,
+                                           vec_t &out,
+                                           const bool layer_parallelize) {
+  // image quantization
+  float_t min_input(q.min_input);
+  float_t max_input(q.max_input);
+  if (!q.has_input_range) {
+    min_input = max_input = in[0];
+    for (size_t inc = 0; inc < params.in.depth_; inc++) {
+      for (size_t ins = 0; ins < params.in.height_ * params.in.height_; ins++) {
+        size_t idx = params.in.get_index(0, 0, inc);
+        min_input  = std::min(min_input, (&in[idx])[ins]);
+        max_input  = std::max(max_input, (&in[idx])[ins]);
+      }
     }
-    bias_quantized =
-      float_tensor_to_quantized<uint8_t>(bias, min_bias, max_bias);
   }
+  std::vector<uint8_t> in_quantized =
+    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
+  const std::vector<uint8_t> &W_quantized    = q.W;
+  const std::vector<uint8_t> &bias_quantized = q.bias;
+  const float_t min_filter                   = q.min_filter;
+  const float_t max_filter                   = q.max_filter;
 
   // output range
   float_t min_output_value;
@@ -86,38 +157,11 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
   const int32_t zero_in_total_space = int64_to_int32(
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
+  tiny_quantized_deconv2d_accumulate(params, in_quantized, offset_input,
+                                     W_quantized, offset_filter, out_quantized,
+                                     layer_parallelize);
+
   for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx               = params.in.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
-
-      idx                     = params.out.get_index(0, 0, o);
-      int32_t *pout_quantized = &out_quantized[idx];
-
-      for (size_t y = 0; y < params.in.height_; y++) {
-        for (size_t x = 0; x < params.in.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi + y * params.in.width_ + x;
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              pout_quantized[(y * params.h_stride + wy) * params.out.width_ +
-                             (x * params.w_stride + wx)] +=
-                static_cast<int32_t>(ppw[wy * params.weight.width_ + wx] -
-                                     offset_filter) *
-                static_cast<int32_t>(*ppi - offset_input);
-            }
-          }
-        }
-      }
-    }
     if (params.has_bias) {
       int32_t *pout_quantized = &out_quantized[params.out.get_index(0, 0, o)];
       int32_t *ppout_quantized =
@@ -144,6 +188,17 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
     out_requantized, min_output_requantized, max_output_requantized);
 }
 
+inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
+                                           const vec_t &in,
+                                           const vec_t &W,
+                                           const vec_t &bias,
+                                           vec_t &out,
+                                           const bool layer_parallelize) {
+  quantized_weights q;
+  tiny_quantize_deconv2d_weights(params, W, bias, &q);
+  tiny_quantized_deconv2d_kernel(params, in, q, out, layer_parallelize);
+}
+
 inline void tiny_quantized_deconv2d_back_kernel(const deconv_params &params,
                                                 const vec_t &prev_out,
                                                 const vec_t &W,
@@ -228,45 +283,33 @@ inline void tiny_quantized_deconv2d_back_kernel(const deconv_params &params,
   //    float_to_quantized<int32_t>(0.0f, min_prev_delta_value,
   //    max_prev_delta_value);
 
-  // propagate delta to previous layer
-  for_i(params.in.depth_, [&](size_t inc) {
-    for (size_t outc = 0; outc < params.out.depth_; outc++) {
-      if (!params.tbl.is_connected(outc, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * outc + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx                       = params.out_unpadded.get_index(0, 0, outc);
-      const uint8_t *pdelta_src = &curr_delta_quantized[idx];
-
-      idx                           = params.in.get_index(0, 0, inc);
-      int32_t *pdelta_quantized_dst = &(prev_delta_quantized)[idx];
-
-      for (size_t y = 0; y < params.in.height_; y++) {
-        for (size_t x = 0; x < params.in.width_; x++) {
-          const uint8_t *ppw = pw;
-          int32_t *ppdelta_quantized_dst =
-            pdelta_quantized_dst + y * params.in.width_ + x;
-          int32_t sum = int32_t(0);
-
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              sum +=
-                static_cast<int32_t>(ppw[wy * params.weight.width_ + wx] -
-                                     offset_filter) *
-                static_cast<int32_t>(
-                  pdelta_src[(y * params.h_stride + wy) * params.out.width_ +
-                             (x * params.w_stride + wx)] -
-                  offset_curr_delta);
-            }
-          }
-          *ppdelta_quantized_dst += sum;
-        }
-      }
-    }
-  });
+  // propagate delta to previous layer and accumulate dw, both on an int32
+  // GEMM over the im2col of the current delta
+  std::vector<int32_t> prev_out_shifted(params.in.size());
+  for (size_t i = 0; i < prev_out_shifted.size(); i++) {
+    prev_out_shifted[i] =
+      static_cast<int32_t>(prev_out_quantized[i]) - offset_prev_out;
+  }
+  std::vector<int32_t> W_shifted(params.weight.size());
+  for (size_t i = 0; i < W_shifted.size(); i++) {
+    W_shifted[i] = static_cast<int32_t>(W_quantized[i]) - offset_filter;
+  }
+  deconv2d_mask_weight(params, W_shifted);
+  std::vector<int32_t> curr_delta_shifted(params.out.size());
+  for (size_t i = 0; i < curr_delta_shifted.size(); i++) {
+    curr_delta_shifted[i] =
+      static_cast<int32_t>(curr_delta_quantized[i]) - offset_curr_delta;
+  }
+
+  std::vector<int32_t> col(params.weight.width_ * params.weight.height_ *
+                           params.in.width_ * params.in.height_);
+  for (size_t outc = 0; outc < params.out.depth_; outc++) {
+    deconv2d_gemm_backward(
+      params, &prev_out_shifted[0], &W_shifted[0],
+      &curr_delta_shifted[params.out.get_index(0, 0, outc)], outc, &col[0],
+      &dW_quantized[0], &prev_delta_quantized[0]);
+  }
+  deconv2d_mask_weight(params, dW_quantized);
 
   float_t min_prev_delta_requantized;
   float_t max_prev_delta_requantized;
@@ -285,39 +328,6 @@ inline void tiny_quantized_deconv2d_back_kernel(const deconv_params &params,
     prev_delta_requantized, min_prev_delta_requantized,
     max_prev_delta_requantized);
 
-  // Accumulate dw
-  for_i(params.in.depth_, [&](size_t inc) {
-    for (size_t outc = 0; outc < params.out.depth_; outc++) {
-      if (!params.tbl.is_connected(outc, inc)) continue;
-
-      for (size_t wy = 0; wy < params.weight.height_; wy++) {
-        for (size_t wx = 0; wx < params.weight.width_; wx++) {
-          int32_t dst = int32_t(0);
-
-          size_t idx           = 0;
-          idx                  = params.in.get_index(0, 0, inc);
-          const uint8_t *prevo = &prev_out_quantized[idx];
-
-          idx                  = params.out.get_index(wx, wy, outc);
-          const uint8_t *delta = &curr_delta_quantized[idx];
-
-          for (size_t y = 0; y < params.in.height_; y++) {
-            for (size_t x = 0; x < params.in.width_; x++) {
-              dst +=
-                (static_cast<int32_t>(*(prevo + y * params.in.width_ + x)) -
-                 offset_prev_out) *
-                (static_cast<int32_t>(*(delta + y * params.out.width_ + x)) -
-                 offset_curr_delta);
-            }
-          }
-
-          idx = params.in.depth_ * outc + inc;
-          dW_quantized[params.weight.get_index(wx, wy, idx)] += dst;
-        }
-      }
-    }
-  });
-
   float_t min_dW_requantized;
   float_t max_dW_requantized;
   std::vector<uint8_t> dW_requantized(dW_quantized.size(),
@@ -391,38 +401,11 @@ inline void tiny_quantized_deconv2d_kernel(const deconv_params &params,
   const int32_t zero_in_total_space = int64_to_int32(
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value));
 
+  tiny_quantized_deconv2d_accumulate(params, in_quantized, offset_input,
+                                     W_quantized, offset_filter, out_quantized,
+                                     layer_parallelize);
+
   for_i(layer_parallelize, params.out.depth_, [&](size_t o) {
-    for (size_t inc = 0; inc < params.in.depth_; inc++) {
-      if (!params.tbl.is_connected(o, inc)) continue;
-
-      size_t idx        = 0;
-      idx               = params.in.depth_ * o + inc;
-      idx               = params.weight.get_index(0, 0, idx);
-      const uint8_t *pw = &W_quantized[idx];
-
-      idx               = params.in.get_index(0, 0, inc);
-      const uint8_t *pi = &in_quantized[idx];
-
-      idx                     = params.out.get_index(0, 0, o);
-      int32_t *pout_quantized = &out_quantized[idx];
-
-      for (size_t y = 0; y < params.in.height_; y++) {
-        for (size_t x = 0; x < params.in.width_; x++) {
-          const uint8_t *ppw = pw;
-          const uint8_t *ppi = pi + y * params.in.width_ + x;
-          // should be optimized for small kernel(3x3,5x5)
-          for (size_t wy = 0; wy < params.weight.height_; wy++) {
-            for (size_t wx = 0; wx < params.weight.width_; wx++) {
-              pout_quantized[(y * params.h_stride + wy) * params.out.width_ +
-                             (x * params.w_stride + wx)] +=
-                static_cast<int32_t>(ppw[wy * params.weight.width_ + wx] -
-                                     offset_filter) *
-                static_cast<int32_t>(*ppi - offset_input);
-            }
-          }
-        }
-      }
-    }
     if (params.has_bias) {
       int32_t *pout_quantized = &out_quantized[params.out.get_index(0, 0, o)];
       int32_t *poutout_quantized =
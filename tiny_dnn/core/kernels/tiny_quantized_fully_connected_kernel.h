@@ -10,121 +10,88 @@
 #include <algorithm>
 #include <vector>
 
-#ifdef CNN_USE_GEMMLOWP
 #include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
-#include "tiny_dnn/core/kernels/tiny_quantized_matmul_kernel.h"
+#include "tiny_dnn/core/kernels/tiny_quantized_gemm_kernel.h"
 #include "tiny_dnn/core/params/fully_params.h"
 
 namespace tiny_dnn {
 namespace core {
 namespace kernels {
 
+inline void tiny_quantize_fully_connected_weights(const fully_params &params,
+                                                  const vec_t &W,
+                                                  const vec_t &b,
+                                                  quantized_weights *q) {
+  // filter quantization, one range per output; W[c * out_size_ + i]
+  // connects input c to output i
+  quantize_filter_per_channel(W, params.out_size_, 1, params.out_size_, q);
+  // stored transposed, one row of in_size_ weights per output
+  std::vector<uint8_t> rows(q->W.size());
+  for (size_t c = 0; c < params.in_size_; c++) {
+    for (size_t i = 0; i < params.out_size_; i++) {
+      rows[i * params.in_size_ + c] = q->W[c * params.out_size_ + i];
+    }
+  }
+  q->W.swap(rows);
+  // bias quantization
+  q->min_bias = q->max_bias = float_t(0);
+  q->bias.clear();
+  if (params.has_bias_) quantize_bias(b, b.size(), q);
+  q->valid = true;
+}
+
+/**
+ * fully-connected layer with weights already quantized by
+ * tiny_quantize_fully_connected_weights(); only the input is quantized here.
+ **/
 inline void tiny_quantized_fully_connected_kernel(
   const fully_params &params,
   const vec_t &in,
-  const vec_t &W,
-  const vec_t &b,
+  const quantized_weights &q,
   vec_t &out,
   const bool layer_parallelize) {
   // input quantization
-  float_t min_input(in[0]);
-  float_t max_input(in[0]);
-  for (size_t c = 0; c < params.in_size_; c++) {
-    min_input = std::min(min_input, in[c]);
-    max_input = std::max(max_input, in[c]);
-  }
-  std::vector<uint8_t> in_quantized =
-    float_tensor_to_quantized<uint8_t>(in, min_input, max_input);
-  // filter quantization
-  float_t min_filter(W[0]);
-  float_t max_filter(W[0]);
-  for (size_t c = 0; c < W.size(); c++) {
-    min_filter = std::min(min_filter, W[c]);
-    max_filter = std::max(max_filter, W[c]);
-  }
-  if (min_filter == max_filter) {
-    max_filter = W[0] + 1e-3f;
-    min_filter = W[0] - 1e-3f;
-  }
-  std::vector<uint8_t> W_quantized =
-    float_tensor_to_quantized<uint8_t>(W, min_filter, max_filter);
-  // output range
-  float_t min_output_value;
-  float_t max_output_value;
-  quantization_range_for_multiplication<uint8_t, uint8_t, int32_t>(
-    min_input, max_input, min_filter, max_filter, &min_output_value,
-    &max_output_value);
-  // bias quantization
-  float_t min_bias(0);
-  float_t max_bias(0);
-  std::vector<uint8_t> bias_quantized;
-  if (params.has_bias_) {
-    for (size_t inc = 0; inc < b.size(); inc++) {
-      min_bias = std::min(min_bias, b[inc]);
-      max_bias = std::max(max_bias, b[inc]);
-    }
-    if (min_bias == max_bias) {
-      max_bias = b[0] + 1e-3f;
-      min_bias = b[0] - 1e-3f;
-    }
-    bias_quantized = float_tensor_to_quantized<uint8_t>(b, min_bias, max_bias);
-  }
-  min_output_value += min_bias;
-  max_output_value += max_bias;
+  float_t min_input;
+  float_t max_input;
+  const std::vector<uint8_t> in_quantized =
+    quantize_input(in, q, &min_input, &max_input);
+  const std::vector<uint8_t> &W_quantized = q.W;
+  // output range and filter offset of each output
+  const channel_requantization rq(min_input, max_input, q, params.out_size_);
 
   std::vector<int32_t> out_quantized(out.size(), static_cast<int32_t>(0));
 
   // calculating offset
-  const int32_t offset_input =
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_input, max_input);
-  const int32_t offset_filter =
-    float_to_quantized_unclamped<uint8_t>(0.0f, min_filter, max_filter);
-  const int32_t zero_in_total_space =
-    float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value);
-
-  const int32_t offset_output = 0;
-  const int32_t mult_output   = 1;
-  const int32_t shift_output  = 0;
-
-  bool use_gemm = false;
-  if (use_gemm) {
-    std::vector<size_t> shape{params.in_size_, 1, params.out_size_,
-                              params.in_size_};
-    tiny_quantized_matmul(in_quantized, W_quantized, out_quantized, shape,
-                          offset_input, offset_filter, offset_output,
-                          mult_output, shift_output);
-    if (params.has_bias_) {
-      for_i(layer_parallelize, params.out_size_,
-            [&](size_t i) { out[i] += b[i]; });
+  const int32_t offset_input = int64_to_int32(
+    float_to_quantized_unclamped<uint8_t>(0.0f, min_input, max_input));
+
+  for_(layer_parallelize, 0, params.out_size_, [&](const blocked_range &r) {
+    tiny_quantized_gemm(r.end() - r.begin(), 1, params.in_size_,
+                        &W_quantized[r.begin() * params.in_size_],
+                        params.in_size_, &rq.offset_filter[r.begin()],
+                        &in_quantized[0], params.in_size_, offset_input,
+                        &out_quantized[r.begin()], 1);
+    // bias, and rescaling to the range shared by all the outputs
+    for (size_t i = r.begin(); i < r.end(); i++) {
+      out_quantized[i] =
+        rq.to_common(q, i, out_quantized[i], params.has_bias_);
     }
-  } else {
-    for_i(layer_parallelize, params.out_size_, [&](size_t i) {
-      for (size_t c = 0; c < params.in_size_; c++) {
-        out_quantized[i] +=
-          static_cast<int32_t>(W_quantized[c * params.out_size_ + i] -
-                               offset_filter) *
-          static_cast<int32_t>(in_quantized[c] - offset_input);
-      }
-      if (params.has_bias_) {
-        out_quantized[i] += (bias_quantized[i] - zero_in_total_space);
-      }
-    });
-  }
-
-  float_t min_output_requantized;
-  float_t max_output_requantized;
-  std::vector<uint8_t> out_requantized(out_quantized.size(),
-                                       static_cast<uint8_t>(0));
+  });
 
   // Requantize from 32bits to 8 bits for next layer
-  quantize_down_and_shrink_range<int32_t, uint8_t>(
-    out_quantized, min_output_value, max_output_value, &min_output_requantized,
-    &max_output_requantized, &out_requantized);
+  requantize_output(out_quantized, rq.min_common, rq.max_common, q, out);
+}
 
-  // dequantize to flaot, this could be removed within concatenated quantized
-  // network
-  out = quantized_tensor_to_float<uint8_t>(
-    out_requantized, min_output_requantized, max_output_requantized);
+inline void tiny_quantized_fully_connected_kernel(
+  const fully_params &params,
+  const vec_t &in,
+  const vec_t &W,
+  const vec_t &b,
+  vec_t &out,
+  const bool layer_parallelize) {
+  quantized_weights q;
+  tiny_quantize_fully_connected_weights(params, W, b, &q);
+  tiny_quantized_fully_connected_kernel(params, in, q, out, layer_parallelize);
 }
 
 inline void tiny_quantized_fully_connected_back_kernel(
@@ -304,8 +271,13 @@ inline void tiny_quantized_fully_connected_kernel(
   for (size_t i = 0; i < in.size(); i++) {
     in_quantized.push_back(static_cast<uint8_t>(in[i]));
   }
-  for (size_t i = 0; i < W.size(); i++) {
-    W_quantized.push_back(static_cast<uint8_t>(W[i]));
+  // transposed, one row of in_size_ weights per output
+  W_quantized.resize(W.size());
+  for (size_t c = 0; c < params.in_size_; c++) {
+    for (size_t i = 0; i < params.out_size_; i++) {
+      W_quantized[i * params.in_size_ + c] =
+        static_cast<uint8_t>(W[c * params.out_size_ + i]);
+    }
   }
   for (size_t i = 0; i < b.size(); i++) {
     bias_quantized.push_back(static_cast<uint8_t>(b[i]));
@@ -323,34 +295,19 @@ inline void tiny_quantized_fully_connected_kernel(
   const int32_t zero_in_total_space =
     float_to_quantized<int32_t>(0.0f, min_output_value, max_output_value);
 
-  const int32_t offset_output = 0;
-  const int32_t mult_output   = 1;
-  const int32_t shift_output  = 0;
-
-  bool use_gemm = false;
-  if (use_gemm) {
-    std::vector<size_t> shape{params.in_size_, 1, params.out_size_,
-                              params.in_size_};
-    tiny_quantized_matmul(in_quantized, W_quantized, out_quantized, shape,
-                          offset_input, offset_filter, offset_output,
-                          mult_output, shift_output);
+  const std::vector<int32_t> offset_filters(params.out_size_, offset_filter);
+  for_(layer_parallelize, 0, params.out_size_, [&](const blocked_range &r) {
+    tiny_quantized_gemm(r.end() - r.begin(), 1, params.in_size_,
+                        &W_quantized[r.begin() * params.in_size_],
+                        params.in_size_, &offset_filters[r.begin()],
+                        &in_quantized[0], params.in_size_, offset_input,
+                        &out_quantized[r.begin()], 1);
     if (params.has_bias_) {
-      for_i(layer_parallelize, params.out_size_,
-            [&](size_t i) { out[i] += b[i]; });
-    }
-  } else {
-    for_i(layer_parallelize, params.out_size_, [&](size_t i) {
-      for (size_t c = 0; c < params.in_size_; c++) {
-        out_quantized[i] +=
-          static_cast<int32_t>(W_quantized[c * params.out_size_ + i] -
-                               offset_filter) *
-          static_cast<int32_t>(in_quantized[c] - offset_input);
-      }
-      if (params.has_bias_) {
+      for (size_t i = r.begin(); i < r.end(); i++) {
         out_quantized[i] += (bias_quantized[i] - zero_in_total_space);
       }
-    });
-  }
+    }
+  });
 
   float_t min_output_requantized;
   float_t max_output_requantized;
@@ -372,5 +329,3 @@ inline void tiny_quantized_fully_connected_kernel(
 }  // namespace kernels
 }  // namespace core
 }  // namespace tiny_dnn
-
-#endif  // CNN_USE_GEMMLOWP
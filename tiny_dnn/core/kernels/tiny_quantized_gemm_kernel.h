@@ -0,0 +1,206 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#ifdef CNN_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+
+namespace tiny_dnn {
+namespace core {
+namespace kernels {
+
+namespace detail {
+
+// sum of the K elements of a
+inline int32_t quantized_row_sum(const uint8_t *a, size_t K) {
+  int32_t sum = 0;
+  size_t k    = 0;
+#ifdef CNN_USE_AVX2
+  __m256i acc = _mm256_setzero_si256();
+  for (; k + 32 <= K; k += 32) {
+    const __m256i va =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + k));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(va, _mm256_setzero_si256()));
+  }
+  alignas(32) int64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  sum = static_cast<int32_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+  for (; k < K; k++) sum += a[k];
+  return sum;
+}
+
+#ifdef CNN_USE_AVX2
+inline int32_t hsum256_epi32(__m256i x) {
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(x),
+                            _mm256_extracti128_si256(x, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(s);
+}
+
+// 16 uint8 widened to int16
+inline __m256i load_epu8_epi16(const uint8_t *p) {
+  return _mm256_cvtepu8_epi16(
+    _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+}
+
+#if defined(__AVXVNNI__) || (defined(__AVX512VNNI__) && defined(__AVX512VL__))
+#define CNN_QUANTIZED_GEMM_VNNI
+// acc += sums of 4 adjacent products of unsigned a and signed b
+inline __m256i dpbusd256_epi32(__m256i acc, __m256i a, __m256i b) {
+#ifdef __AVXVNNI__
+  return _mm256_dpbusd_avx_epi32(acc, a, b);
+#else
+  return _mm256_dpbusd_epi32(acc, a, b);
+#endif
+}
+
+// 32 uint8 minus 128, as int8
+inline __m256i load_epu8_minus128(const uint8_t *p) {
+  return _mm256_xor_si256(
+    _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)),
+    _mm256_set1_epi8(static_cast<char>(0x80)));
+}
+#endif
+
+/**
+ * dst[r] = sum_k a[r * lda + k] * b[k] for the 4 rows r of a.
+ *
+ * vpmaddubsw would saturate its 16 bit pair sums with two full-range uint8
+ * operands, so without VNNI both sides are widened to 16 bits and multiplied
+ * with vpmaddwd, which is exact. vpdpbusd accumulates u8 x s8 products in
+ * 32 bits, and is fed with a - 128 as the signed operand.
+ **/
+inline void quantized_dot4(const uint8_t *a,
+                           size_t lda,
+                           const uint8_t *b,
+                           size_t K,
+                           int32_t *dst) {
+  const uint8_t *a0 = a;
+  const uint8_t *a1 = a + lda;
+  const uint8_t *a2 = a + 2 * lda;
+  const uint8_t *a3 = a + 3 * lda;
+  __m256i acc0      = _mm256_setzero_si256();
+  __m256i acc1      = _mm256_setzero_si256();
+  __m256i acc2      = _mm256_setzero_si256();
+  __m256i acc3      = _mm256_setzero_si256();
+  size_t k          = 0;
+#ifdef CNN_QUANTIZED_GEMM_VNNI
+  const __m256i ones = _mm256_set1_epi8(1);
+  __m256i sum_b      = _mm256_setzero_si256();
+  for (; k + 32 <= K; k += 32) {
+    const __m256i vb =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + k));
+    acc0  = dpbusd256_epi32(acc0, vb, load_epu8_minus128(a0 + k));
+    acc1  = dpbusd256_epi32(acc1, vb, load_epu8_minus128(a1 + k));
+    acc2  = dpbusd256_epi32(acc2, vb, load_epu8_minus128(a2 + k));
+    acc3  = dpbusd256_epi32(acc3, vb, load_epu8_minus128(a3 + k));
+    sum_b = dpbusd256_epi32(sum_b, vb, ones);
+  }
+  // a * b = (a - 128) * b + 128 * b
+  const int32_t bias = 128 * hsum256_epi32(sum_b);
+#else
+  for (; k + 16 <= K; k += 16) {
+    const __m256i vb = load_epu8_epi16(b + k);
+    acc0 =
+      _mm256_add_epi32(acc0, _mm256_madd_epi16(load_epu8_epi16(a0 + k), vb));
+    acc1 =
+      _mm256_add_epi32(acc1, _mm256_madd_epi16(load_epu8_epi16(a1 + k), vb));
+    acc2 =
+      _mm256_add_epi32(acc2, _mm256_madd_epi16(load_epu8_epi16(a2 + k), vb));
+    acc3 =
+      _mm256_add_epi32(acc3, _mm256_madd_epi16(load_epu8_epi16(a3 + k), vb));
+  }
+  const int32_t bias = 0;
+#endif
+  dst[0] = hsum256_epi32(acc0) + bias;
+  dst[1] = hsum256_epi32(acc1) + bias;
+  dst[2] = hsum256_epi32(acc2) + bias;
+  dst[3] = hsum256_epi32(acc3) + bias;
+  for (; k < K; k++) {
+    const int32_t bk = b[k];
+    dst[0] += a0[k] * bk;
+    dst[1] += a1[k] * bk;
+    dst[2] += a2[k] * bk;
+    dst[3] += a3[k] * bk;
+  }
+}
+#endif  // CNN_USE_AVX2
+
+// sum_k a[k] * b[k]
+inline int32_t quantized_dot(const uint8_t *a, const uint8_t *b, size_t K) {
+  int32_t sum = 0;
+  for (size_t k = 0; k < K; k++) {
+    sum += static_cast<int32_t>(a[k]) * static_cast<int32_t>(b[k]);
+  }
+  return sum;
+}
+
+}  // namespace detail
+
+/**
+ * C[i * ldc + j] += sum_k (A[i * lda + k] - offset_a[i]) *
+ *                         (B[j * ldb + k] - offset_b)
+ *
+ * on row-major uint8 matrices, A being M x K with one zero point per row
+ * (the filter of an output channel) and B being N x K (the inputs seen by
+ * each output position). the products of the raw operands are accumulated
+ * first, and the zero points are applied afterwards with the row sums:
+ *
+ *   sum (a - oa)(b - ob) = sum ab - ob sum a - oa sum b + K oa ob
+ *
+ * so the result is the one of the int32 loop it replaces.
+ **/
+inline void tiny_quantized_gemm(size_t M,
+                                size_t N,
+                                size_t K,
+                                const uint8_t *A,
+                                size_t lda,
+                                const int32_t *offset_a,
+                                const uint8_t *B,
+                                size_t ldb,
+                                int32_t offset_b,
+                                int32_t *C,
+                                size_t ldc) {
+  std::vector<int32_t> sum_a(M);
+  for (size_t i = 0; i < M; i++) {
+    sum_a[i] = detail::quantized_row_sum(A + i * lda, K);
+  }
+
+  auto store = [&](size_t i, size_t j, int32_t dot, int64_t sum_b) {
+    const int64_t oa = offset_a[i];
+    C[i * ldc + j] += static_cast<int32_t>(
+      dot - offset_b * static_cast<int64_t>(sum_a[i]) - oa * sum_b +
+      static_cast<int64_t>(K) * oa * offset_b);
+  };
+
+  for (size_t j = 0; j < N; j++) {
+    const uint8_t *b    = B + j * ldb;
+    const int64_t sum_b = detail::quantized_row_sum(b, K);
+    size_t i            = 0;
+#ifdef CNN_USE_AVX2
+    for (; i + 4 <= M; i += 4) {
+      int32_t dot[4];
+      detail::quantized_dot4(A + i * lda, lda, b, K, dot);
+      for (size_t r = 0; r < 4; r++) store(i + r, j, dot[r], sum_b);
+    }
+#endif
+    for (; i < M; i++) {
+      store(i, j, detail::quantized_dot(A + i * lda, b, K), sum_b);
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace core
+}  // namespace tiny_dnn
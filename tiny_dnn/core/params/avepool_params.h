@@ -0,0 +1,44 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+
+#include "tiny_dnn/core/params/params.h"
+
+namespace tiny_dnn {
+namespace core {
+
+/**
+ * shared by average pooling and average unpooling. for pooling, each output
+ * averages the window at (ox * stride_x, oy * stride_y) of the input; for
+ * unpooling, each input is spread over the window at
+ * (x * stride_x, y * stride_y) of the output.
+ **/
+class avepool_params : public Params {
+ public:
+  shape3d in;
+  shape3d out;
+  size_t pool_size_x;
+  size_t pool_size_y;
+  size_t stride_x;
+  size_t stride_y;
+  float_t scale_factor;
+
+  /* windows neither overlap nor leave gaps between them */
+  bool non_overlapping() const {
+    return stride_x == pool_size_x && stride_y == pool_size_y;
+  }
+};
+
+inline avepool_params &Params::avepool() {
+  return *(static_cast<avepool_params *>(this));
+}
+
+}  // namespace core
+}  // namespace tiny_dnn
@@ -0,0 +1,26 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+namespace tiny_dnn {
+namespace core {
+
+/**
+ * scratch matrices of the forward cell kernels, (batch x width) row-major.
+ * kept by the caller so that they are reused from one timestep to the next
+ * instead of being allocated by every call.
+ **/
+struct cell_workspace {
+  vec_t xs;     // packed inputs
+  vec_t hs;     // packed previous state
+  vec_t gates;  // pre-activations of the gates (rnn: of the state)
+  vec_t aux;    // gru: h(t-1) * r, rnn: outputs
+};
+
+}  // namespace core
+}  // namespace tiny_dnn
@@ -7,9 +7,7 @@
 */
 #pragma once
 
-#include <memory>
-#include "tiny_dnn/activations/sigmoid_layer.h"
-#include "tiny_dnn/activations/tanh_layer.h"
+#include "tiny_dnn/core/params/cell_workspace.h"
 #include "tiny_dnn/core/params/params.h"
 
 namespace tiny_dnn {
@@ -19,9 +17,12 @@ class lstm_cell_params : public Params {
  public:
   size_t in_size_;
   size_t out_size_;
-  std::shared_ptr<tanh_layer> tanh_;
-  std::shared_ptr<sigmoid_layer> sigmoid_;
   bool has_bias_;
+  // b + W[x->*]x(t) of the current timestep, precomputed by the recurrent
+  // layer for the whole sequence; computed by the cell when null
+  const float_t *x_projection_ = nullptr;
+  // scratch of the forward kernel, which uses its own when null
+  cell_workspace *workspace_ = nullptr;
 };
 
 inline lstm_cell_params &Params::lstm_cell() {
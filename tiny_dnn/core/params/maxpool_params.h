@@ -7,6 +7,8 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #include "tiny_dnn/core/params/params.h"
@@ -14,6 +16,9 @@
 namespace tiny_dnn {
 namespace core {
 
+/* position of the maximum inside its pooling window (dy * pool_size_x + dx) */
+typedef uint16_t maxpool_index_t;
+
 class maxpool_params : public Params {
  public:
   index3d<size_t> in;
@@ -25,12 +30,18 @@ class maxpool_params : public Params {
   bool ceil_mode;
   padding pad_type;
 
-  /* mapping out => max_index(in) (1:1) */
-  std::vector<std::vector<size_t>> out2inmax;
-  /* mapping out => in (1:N) */
-  std::vector<std::vector<size_t>> out2in;
-  /* mapping in => out (N:1) */
-  std::vector<size_t> in2out;
+  /* mapping out => offset of max_index(in) in the window (1:1) */
+  std::vector<std::vector<maxpool_index_t>> out2inmax;
+
+  /* number of valid rows of the window which produces output row oy */
+  size_t window_height(size_t oy) const {
+    return std::min(pool_size_y, in.height_ - oy * stride_y);
+  }
+
+  /* number of valid columns of the window which produces output column ox */
+  size_t window_width(size_t ox) const {
+    return std::min(pool_size_x, in.width_ - ox * stride_x);
+  }
 };
 
 struct max_pooling_layer_worker_specific_storage {
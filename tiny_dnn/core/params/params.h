@@ -13,6 +13,7 @@ namespace core {
 class conv_params;
 class fully_params;
 class maxpool_params;
+class avepool_params;
 class global_avepool_params;
 class gru_cell_params;
 class rnn_cell_params;
@@ -26,6 +27,7 @@ class Params {
   conv_params &conv();
   fully_params &fully();
   maxpool_params &maxpool();
+  avepool_params &avepool();
   global_avepool_params &global_avepool();
   gru_cell_params &gru_cell();
   rnn_cell_params &rnn_cell();
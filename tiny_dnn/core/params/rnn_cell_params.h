@@ -10,6 +10,7 @@
 #include <memory>
 
 #include "tiny_dnn/activations/activation_layer.h"
+#include "tiny_dnn/core/params/cell_workspace.h"
 #include "tiny_dnn/core/params/params.h"
 
 namespace tiny_dnn {
@@ -21,6 +22,11 @@ class rnn_cell_params : public Params {
   size_t out_size_;
   std::shared_ptr<activation_layer> activation_{};
   bool has_bias_;
+  // b + U x(t) of the current timestep, precomputed by the recurrent
+  // layer for the whole sequence; computed by the cell when null
+  const float_t *x_projection_ = nullptr;
+  // scratch of the forward kernel, which uses its own when null
+  cell_workspace *workspace_ = nullptr;
 };
 
 inline rnn_cell_params &Params::rnn_cell() {
@@ -8,11 +8,14 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
-#include "tiny_dnn/layers/partial_connected_layer.h"
+#include "tiny_dnn/core/kernels/avepool_grad_op.h"
+#include "tiny_dnn/core/kernels/avepool_op.h"
+#include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/util/util.h"
 
 #ifdef DNN_USE_IMAGE_API
@@ -21,96 +24,12 @@
 
 namespace tiny_dnn {
 
-// forward_propagation
-inline void tiny_average_pooling_kernel(
-  bool parallelize,
-  const std::vector<tensor_t *> &in_data,
-  std::vector<tensor_t *> &out_data,
-  const shape3d &out_dim,
-  float_t scale_factor,
-  std::vector<typename partial_connected_layer::wi_connections> &out2wi) {
-  for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
-    const vec_t &in = (*in_data[0])[sample];
-    const vec_t &W  = (*in_data[1])[0];
-    const vec_t &b  = (*in_data[2])[0];
-    vec_t &out      = (*out_data[0])[sample];
-
-    auto oarea = out_dim.area();
-    size_t idx = 0;
-    for (size_t d = 0; d < out_dim.depth_; ++d) {
-      float_t weight = W[d] * scale_factor;
-      float_t bias   = b[d];
-      for (size_t i = 0; i < oarea; ++i, ++idx) {
-        const auto &connections = out2wi[idx];
-        float_t value{0};
-        for (auto connection : connections) value += in[connection.second];
-        value *= weight;
-        value += bias;
-        out[idx] = value;
-      }
-    }
-
-    assert(out.size() == out2wi.size());
-  });
-}
-
-// back_propagation
-inline void tiny_average_pooling_back_kernel(
-  bool parallelize,
-  const std::vector<tensor_t *> &in_data,
-  const std::vector<tensor_t *> &out_data,
-  std::vector<tensor_t *> &out_grad,
-  std::vector<tensor_t *> &in_grad,
-  const shape3d &in_dim,
-  float_t scale_factor,
-  std::vector<typename partial_connected_layer::io_connections> &weight2io,
-  std::vector<typename partial_connected_layer::wo_connections> &in2wo,
-  std::vector<std::vector<size_t>> &bias2out) {
-  CNN_UNREFERENCED_PARAMETER(out_data);
-  for_i(parallelize, in_data[0]->size(), [&](size_t sample) {
-    const vec_t &prev_out = (*in_data[0])[sample];
-    const vec_t &W        = (*in_data[1])[0];
-    vec_t &dW             = (*in_grad[1])[sample];
-    vec_t &db             = (*in_grad[2])[sample];
-    vec_t &prev_delta     = (*in_grad[0])[sample];
-    vec_t &curr_delta     = (*out_grad[0])[sample];
-
-    auto inarea = in_dim.area();
-    size_t idx  = 0;
-    for (size_t i = 0; i < in_dim.depth_; ++i) {
-      float_t weight = W[i] * scale_factor;
-      for (size_t j = 0; j < inarea; ++j, ++idx) {
-        prev_delta[idx] = weight * curr_delta[in2wo[idx][0].second];
-      }
-    }
-
-    for (size_t i = 0; i < weight2io.size(); ++i) {
-      const auto &connections = weight2io[i];
-      float_t diff{0};
-
-      for (auto connection : connections)
-        diff += prev_out[connection.first] * curr_delta[connection.second];
-
-      dW[i] += diff * scale_factor;
-    }
-
-    for (size_t i = 0; i < bias2out.size(); i++) {
-      const std::vector<size_t> &outs = bias2out[i];
-      float_t diff{0};
-
-      for (auto o : outs) diff += curr_delta[o];
-
-      db[i] += diff;
-    }
-  });
-}
-
 /**
  * average pooling with trainable weights
  **/
-class average_pooling_layer : public partial_connected_layer {
+class average_pooling_layer : public layer {
  public:
-  using Base = partial_connected_layer;
+  using Base = layer;
 
   /**
    * @param in_width     [in] width of input image
@@ -182,6 +101,7 @@ class average_pooling_layer : public partial_connected_layer {
    * @param ceil_mode    [in] when True, will use `ceil` instead of `floor` to
    *compute the output shape
    * @param pad_type     [in] padding mode(same/valid)
+   * @param backend_type [in] specify backend engine you use
    **/
   average_pooling_layer(size_t in_width,
                         size_t in_height,
@@ -190,17 +110,10 @@ class average_pooling_layer : public partial_connected_layer {
                         size_t pool_size_y,
                         size_t stride_x,
                         size_t stride_y,
-                        bool ceil_mode   = false,
-                        padding pad_type = padding::valid)
-    : Base(
-        in_width * in_height * in_channels,
-        pool_out_length(in_width, pool_size_x, stride_x, ceil_mode, pad_type) *
-          pool_out_length(
-            in_height, pool_size_y, stride_y, ceil_mode, pad_type) *
-          in_channels,
-        in_channels,
-        in_channels,
-        float_t(1) / (pool_size_x * pool_size_y)),
+                        bool ceil_mode               = false,
+                        padding pad_type             = padding::valid,
+                        core::backend_t backend_type = core::default_engine())
+    : Base(std_input_order(true), {vector_type::data}),
       stride_x_(stride_x),
       stride_y_(stride_y),
       pool_size_x_(pool_size_x),
@@ -217,7 +130,32 @@ class average_pooling_layer : public partial_connected_layer {
       pooling_size_mismatch(in_width, in_height, pool_size_x, pool_size_y);
     }
 
-    init_connection(pool_size_x, pool_size_y);
+    set_avepool_params();
+    init_backend(backend_type);
+  }
+
+  // move constructor
+  average_pooling_layer(average_pooling_layer &&other)  // NOLINT
+    : Base(std::move(other)),
+      stride_x_(other.stride_x_),
+      stride_y_(other.stride_y_),
+      pool_size_x_(other.pool_size_x_),
+      pool_size_y_(other.pool_size_y_),
+      pad_type_(other.pad_type_),
+      ceil_mode_(other.ceil_mode_),
+      in_(other.in_),
+      out_(other.out_),
+      w_(other.w_),
+      params_(std::move(other.params_)) {
+    init_backend(std::move(Base::engine()));
+  }
+
+  size_t fan_in_size() const override { return pool_size_x_ * pool_size_y_; }
+
+  // number of windows sharing an input
+  size_t fan_out_size() const override {
+    return ((pool_size_x_ + stride_x_ - 1) / stride_x_) *
+           ((pool_size_y_ + stride_y_ - 1) / stride_y_);
   }
 
   std::vector<index3d<size_t>> in_shape() const override {
@@ -230,24 +168,51 @@ class average_pooling_layer : public partial_connected_layer {
 
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
-    tiny_average_pooling_kernel(parallelize_, in_data, out_data, out_,
-                                Base::scale_factor_, Base::out2wi_);
+    fwd_ctx_.set_in_out(in_data, out_data);
+    fwd_ctx_.setParallelize(Base::parallelize());
+    fwd_ctx_.setEngine(Base::engine());
+
+    kernel_fwd_->compute(fwd_ctx_);
   }
 
   void back_propagation(const std::vector<tensor_t *> &in_data,
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
                         std::vector<tensor_t *> &in_grad) override {
-    tiny_average_pooling_back_kernel(
-      parallelize_, in_data, out_data, out_grad, in_grad, in_,
-      Base::scale_factor_, Base::weight2io_, Base::in2wo_, Base::bias2out_);
+    bwd_ctx_.set_in_out(in_data, out_data, out_grad, in_grad);
+    bwd_ctx_.setParallelize(Base::parallelize());
+    bwd_ctx_.setEngine(Base::engine());
+
+    kernel_back_->compute(bwd_ctx_);
   }
 
   std::pair<size_t, size_t> pool_size() const {
     return std::make_pair(pool_size_x_, pool_size_y_);
   }
 
+  channel_pruning input_channel_pruning() const override {
+    return channel_pruning::forwards;
+  }
+
+  void prune_input_channels(const std::vector<size_t> &kept,
+                            size_t channels) override {
+    CNN_UNREFERENCED_PARAMETER(channels);
+    const vec_t W = *weights()[0];
+    const vec_t b = *weights()[1];
+    in_.depth_    = kept.size();
+    out_.depth_   = kept.size();
+    w_.depth_     = kept.size();
+    set_avepool_params();
+    reshape_edges();
+    // a single weight and bias per channel
+    for (size_t c = 0; c < kept.size(); c++) {
+      (*weights()[0])[c] = W[kept[c]];
+      (*weights()[1])[c] = b[kept[c]];
+    }
+  }
+
   friend struct serialization_buddy;
+  friend class quantized_average_pooling_layer;
 
  private:
   size_t stride_x_;
@@ -260,47 +225,42 @@ class average_pooling_layer : public partial_connected_layer {
   shape3d out_;
   shape3d w_;
 
-  static size_t pool_out_dim(size_t in_size,
-                             size_t pooling_size,
-                             size_t stride) {
-    return static_cast<int>(
-      std::ceil((static_cast<float_t>(in_size) - pooling_size) / stride) + 1);
-  }
+  /* The Average Pooling operation params */
+  core::avepool_params params_;
 
-  void init_connection(size_t pooling_size_x, size_t pooling_size_y) {
-    for (size_t c = 0; c < in_.depth_; ++c) {
-      for (size_t y = 0; y < in_.height_ - pooling_size_y + 1; y += stride_y_) {
-        for (size_t x = 0; x < in_.width_ - pooling_size_x + 1;
-             x += stride_x_) {
-          connect_kernel(pooling_size_x, pooling_size_y, x, y, c);
-        }
-      }
-    }
+  /* forward op context */
+  core::OpKernelContext fwd_ctx_;
 
-    for (size_t c = 0; c < in_.depth_; ++c) {
-      for (size_t y = 0; y < out_.height_; ++y) {
-        for (size_t x = 0; x < out_.width_; ++x) {
-          this->connect_bias(c, out_.get_index(x, y, c));
-        }
-      }
-    }
+  /* backward op context */
+  core::OpKernelContext bwd_ctx_;
+
+  /* Forward and backward ops */
+  std::shared_ptr<core::OpKernel> kernel_fwd_;
+  std::shared_ptr<core::OpKernel> kernel_back_;
+
+  void set_avepool_params() {
+    params_.in           = in_;
+    params_.out          = out_;
+    params_.pool_size_x  = pool_size_x_;
+    params_.pool_size_y  = pool_size_y_;
+    params_.stride_x     = stride_x_;
+    params_.stride_y     = stride_y_;
+    params_.scale_factor = float_t(1) / (pool_size_x_ * pool_size_y_);
   }
 
-  void connect_kernel(size_t pooling_size_x,
-                      size_t pooling_size_y,
-                      size_t x,
-                      size_t y,
-                      size_t inc) {
-    size_t dymax  = std::min(pooling_size_y, in_.height_ - y);
-    size_t dxmax  = std::min(pooling_size_x, in_.width_ - x);
-    size_t dstx   = x / stride_x_;
-    size_t dsty   = y / stride_y_;
-    size_t outidx = out_.get_index(dstx, dsty, inc);
-    for (size_t dy = 0; dy < dymax; ++dy) {
-      for (size_t dx = 0; dx < dxmax; ++dx) {
-        this->connect_weight(in_.get_index(x + dx, y + dy, inc), outidx, inc);
-      }
+  void init_backend(core::backend_t backend_type) {
+    core::OpKernelConstruction ctx =
+      core::OpKernelConstruction(Base::device(), &params_);
+
+    if (backend_type == core::backend_t::internal ||
+        backend_type == core::backend_t::nnpack ||
+        backend_type == core::backend_t::avx) {
+      kernel_fwd_.reset(new AvePoolOp(ctx));
+      kernel_back_.reset(new AvePoolGradOp(ctx));
+    } else {
+      throw nn_error("Not supported engine: " + to_string(backend_type));
     }
+    Base::set_backend_type(backend_type);
   }
 };
 
@@ -211,10 +211,33 @@ class batch_normalization_layer : public layer {
     calc_stddev(variance);
   }
 
+  const vec_t &mean() const { return mean_; }
+
+  const vec_t &variance() const { return variance_; }
+
   float_t epsilon() const { return eps_; }
 
   float_t momentum() const { return momentum_; }
 
+  channel_pruning input_channel_pruning() const override {
+    return channel_pruning::forwards;
+  }
+
+  void prune_input_channels(const std::vector<size_t> &kept,
+                            size_t channels) override {
+    CNN_UNREFERENCED_PARAMETER(channels);
+    vec_t mean(kept.size()), variance(kept.size());
+    for (size_t c = 0; c < kept.size(); c++) {
+      mean[c]     = mean_[kept[c]];
+      variance[c] = variance_[kept[c]];
+    }
+    in_channels_ = kept.size();
+    init();
+    mean_ = mean;
+    set_variance(variance);
+    reshape_edges();
+  }
+
   friend struct serialization_buddy;
 
  private:
@@ -9,6 +9,7 @@
 #include <vector>
 #include "tiny_dnn/core/backend.h"
 #include "tiny_dnn/core/framework/device.fwd.h"
+#include "tiny_dnn/core/params/cell_workspace.h"
 
 namespace tiny_dnn {
 
@@ -33,6 +34,34 @@ class cell : public layer {
 
   virtual core::backend_t backend_type() const { return wrapper_->engine(); }
 
+  /**
+   * Computes the input-to-hidden products of every row of in_data[0] (all the
+   * timesteps of a sequence) in one go. Returns false if the cell does not
+   * support it, in which case they are computed at each timestep.
+   **/
+  virtual bool project_inputs(const std::vector<tensor_t *> &in_data) {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    return false;
+  }
+
+  /**
+   * Makes the following forward_propagation calls read the rows starting at
+   * first_row of the products computed by project_inputs, or compute their
+   * own products again if use is false.
+   **/
+  virtual void use_projected_inputs(bool use, size_t first_row = 0) {
+    CNN_UNREFERENCED_PARAMETER(use);
+    CNN_UNREFERENCED_PARAMETER(first_row);
+  }
+
+  /**
+   * Makes the following forward_propagation calls keep their scratch
+   * matrices in workspace, or allocate their own if it is null.
+   **/
+  virtual void use_workspace(core::cell_workspace *workspace) {
+    CNN_UNREFERENCED_PARAMETER(workspace);
+  }
+
   virtual void init_backend(const layer *wrapper) = 0;
 
  protected:
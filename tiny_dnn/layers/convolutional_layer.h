@@ -8,6 +8,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cmath>
 #include <memory>
 #include <string>
 #include <utility>
@@ -17,6 +18,7 @@
 #include "tiny_dnn/core/kernels/conv2d_op.h"
 #include "tiny_dnn/core/kernels/conv2d_op_libdnn.h"
 #include "tiny_dnn/core/kernels/conv2d_op_opencl.h"
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
 
 #include "tiny_dnn/util/util.h"
 
@@ -26,6 +28,9 @@
 
 namespace tiny_dnn {
 
+class half_convolutional_layer;
+class quantized_convolutional_layer;
+
 /**
  * 2D convolution layer
  *
@@ -261,7 +266,8 @@ class convolutional_layer : public layer {
       padding_op_(std::move(other.padding_op_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
       kernel_back_(std::move(other.kernel_back_)),
-      cws_(std::move(other.cws_)) {
+      cws_(std::move(other.cws_)),
+      fake_quantize_(other.fake_quantize_) {
     init_backend(std::move(other.engine()));
   }
 
@@ -295,7 +301,9 @@ class convolutional_layer : public layer {
     fwd_ctx_.setEngine(layer::engine());
 
     // launch convolutional kernel
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], true);
     kernel_fwd_->compute(fwd_ctx_);
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], false);
   }
 
   /**
@@ -330,12 +338,23 @@ class convolutional_layer : public layer {
     bwd_ctx_.setEngine(layer::engine());
 
     // launch convolutional kernel
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], true);
     kernel_back_->compute(bwd_ctx_);
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], false);
 
     // unpad deltas
     padding_op_.copy_and_unpad_delta(cws_.prev_delta_padded_, *in_grad[0]);
   }
 
+  /**
+   * round the weights as quantized_convolutional_layer does, in forward and
+   * backward, for quantization-aware training. the gradients still update
+   * the float weights (straight-through estimator).
+   **/
+  void set_fake_quantization(bool enable) { fake_quantize_ = enable; }
+
+  bool fake_quantization() const { return fake_quantize_; }
+
   void set_sample_count(size_t sample_count) override {
     layer::set_sample_count(sample_count);
     cws_.prev_delta_padded_.resize(sample_count,
@@ -357,6 +376,69 @@ class convolutional_layer : public layer {
 
   std::string layer_type() const override { return std::string("conv"); }
 
+  bool fold_channel_affine(const vec_t &scale, const vec_t &shift) override {
+    // weights of output channel o are contiguous: weight(wx, wy, in.depth*o+i)
+    return fold_channel_affine_blocks(
+      scale, shift, params_.out.depth_,
+      params_.weight.width_ * params_.weight.height_ * params_.in.depth_,
+      &params_.has_bias);
+  }
+
+  vec_t output_channel_norms() const override {
+    if (!params_.tbl.is_empty()) return vec_t();
+    const vec_t &W = *weights()[0];
+    const size_t block =
+      params_.weight.width_ * params_.weight.height_ * params_.in.depth_;
+    vec_t norms(params_.out.depth_);
+    for (size_t o = 0; o < norms.size(); o++) {
+      float_t sum = 0;
+      for (size_t k = 0; k < block; k++) {
+        sum += W[o * block + k] * W[o * block + k];
+      }
+      norms[o] = std::sqrt(sum);
+    }
+    return norms;
+  }
+
+  void prune_output_channels(const std::vector<size_t> &kept) override {
+    const vec_t W = *weights()[0];
+    const vec_t b = params_.has_bias ? *weights()[1] : vec_t();
+    const size_t block =
+      params_.weight.width_ * params_.weight.height_ * params_.in.depth_;
+
+    reset_shape(params_.in, kept.size());
+    vec_t &new_W = *weights()[0];
+    for (size_t o = 0; o < kept.size(); o++) {
+      std::copy(W.begin() + kept[o] * block, W.begin() + (kept[o] + 1) * block,
+                new_W.begin() + o * block);
+      if (params_.has_bias) (*weights()[1])[o] = b[kept[o]];
+    }
+  }
+
+  channel_pruning input_channel_pruning() const override {
+    return params_.tbl.is_empty() ? channel_pruning::consumes
+                                  : channel_pruning::none;
+  }
+
+  void prune_input_channels(const std::vector<size_t> &kept,
+                            size_t channels) override {
+    CNN_UNREFERENCED_PARAMETER(channels);
+    const vec_t W       = *weights()[0];
+    const size_t area   = params_.weight.width_ * params_.weight.height_;
+    const size_t in_old = params_.in.depth_;
+
+    reset_shape(shape3d(params_.in.width_, params_.in.height_, kept.size()),
+                params_.out.depth_);
+    vec_t &new_W = *weights()[0];
+    for (size_t o = 0; o < params_.out.depth_; o++) {
+      for (size_t i = 0; i < kept.size(); i++) {
+        std::copy(W.begin() + (o * in_old + kept[i]) * area,
+                  W.begin() + (o * in_old + kept[i] + 1) * area,
+                  new_W.begin() + (o * kept.size() + i) * area);
+      }
+    }
+  }
+
   // TODO(edgar): check this
   std::string kernel_file() const override {
     return std::string(
@@ -422,6 +504,8 @@ class convolutional_layer : public layer {
 #endif  // DNN_USE_IMAGE_API
 
   friend struct serialization_buddy;
+  friend class half_convolutional_layer;
+  friend class quantized_convolutional_layer;
 
  private:
   tensor_t *in_data_padded(const std::vector<tensor_t *> &in) {
@@ -429,6 +513,16 @@ class convolutional_layer : public layer {
                                                 : &cws_.prev_out_padded_;
   }
 
+  // change the input or output depth, reallocating the weights
+  void reset_shape(const shape3d &in, size_t out_channels) {
+    cws_.prev_delta_padded_.clear();
+    conv_set_params(in, params_.weight.width_, params_.weight.height_,
+                    out_channels, params_.pad_type, params_.has_bias,
+                    params_.w_stride, params_.h_stride, params_.w_dilation,
+                    params_.h_dilation);
+    reshape_edges();
+  }
+
   void conv_set_params(
     const shape3d &in,
     size_t w_width,
@@ -556,6 +650,20 @@ class convolutional_layer : public layer {
     tensor_t prev_out_padded_;
     tensor_t prev_delta_padded_;
   } cws_;
+
+  /* exchange the float weights with their rounded values, and back */
+  void swap_fake_quantized_weights(tensor_t &W, bool round) {
+    if (round) {
+      const size_t channels = params_.out.depth_;
+      fake_W_               = W[0];
+      core::kernels::fake_quantize_filter_per_channel(
+        fake_W_, channels, fake_W_.size() / channels, 1);
+    }
+    W[0].swap(fake_W_);
+  }
+
+  bool fake_quantize_ = false;
+  vec_t fake_W_;
 };
 
 }  // namespace tiny_dnn
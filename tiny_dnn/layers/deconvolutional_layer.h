@@ -268,6 +268,14 @@ class deconvolutional_layer : public layer {
 
   std::string layer_type() const override { return "deconv"; }
 
+  bool fold_channel_affine(const vec_t &scale, const vec_t &shift) override {
+    // weights of output channel o are contiguous: weight(wx, wy, in.depth*o+i)
+    return fold_channel_affine_blocks(
+      scale, shift, params_.out.depth_,
+      params_.weight.width_ * params_.weight.height_ * params_.in.depth_,
+      &params_.has_bias);
+  }
+
 #ifdef DNN_USE_IMAGE_API
   image<> weight_to_image() const {
     image<> img;
@@ -0,0 +1,79 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * float values of the uint8 codes of [min_input, max_input], closing a
+ * chain of quantized layers whose output range is set
+ **/
+class dequantize_layer : public layer {
+ public:
+  /**
+   * @param in_shape  [in] shape of input tensor
+   * @param min_input [in] range coded by the input
+   * @param max_input [in] range coded by the input
+   **/
+  dequantize_layer(const shape3d &in_shape,
+                   float_t min_input,
+                   float_t max_input)
+    : layer({vector_type::data}, {vector_type::data}),
+      in_shape_(in_shape),
+      table_(256) {
+    if (!(min_input < max_input)) {
+      throw nn_error("invalid range for " + layer_type());
+    }
+    for (size_t code = 0; code < table_.size(); code++) {
+      table_[code] = core::kernels::quantized_to_float<uint8_t>(
+        static_cast<uint8_t>(code), min_input, max_input);
+    }
+  }
+
+  std::string layer_type() const override { return "dequantize"; }
+
+  std::vector<shape3d> in_shape() const override { return {in_shape_}; }
+
+  std::vector<shape3d> out_shape() const override { return {in_shape_}; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    tensor_t &y       = *out_data[0];
+
+    for_i(x.size(), [&](size_t i) {
+      std::transform(x[i].begin(), x[i].end(), y[i].begin(), [&](float_t q) {
+        return table_[static_cast<uint8_t>(q)];
+      });
+    });
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    CNN_UNREFERENCED_PARAMETER(out_grad);
+    CNN_UNREFERENCED_PARAMETER(in_grad);
+    throw nn_error(layer_type() + " is inference only");
+  }
+
+ private:
+  shape3d in_shape_;
+  vec_t table_;
+};
+
+}  // namespace tiny_dnn
@@ -0,0 +1,139 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * simulated uint8 quantization of the activations, for quantization-aware
+ * training.
+ *
+ * the input is rounded to the uint8 codes of [min, max] and given back as
+ * floats. in the train phase the range follows the moving average of the
+ * range of each batch, always including 0; in the test phase it is fixed.
+ * the gradient goes through unchanged inside the range and is 0 outside
+ * (straight-through estimator).
+ *
+ * placed before a convolutional or fully-connected layer, it gives the
+ * input range of its quantized version, see export_quantized().
+ **/
+class fake_quantize_layer : public layer {
+ public:
+  /**
+   * @param in_shape [in] shape of input tensor
+   * @param momentum [in] momentum of the moving average of the range
+   * @param phase    [in] specify the current context (train/test)
+   **/
+  explicit fake_quantize_layer(const shape3d &in_shape,
+                               float_t momentum = 0.999,
+                               net_phase phase  = net_phase::train)
+    : layer({vector_type::data}, {vector_type::data}),
+      in_shape_(in_shape),
+      momentum_(momentum),
+      phase_(phase) {}
+
+  std::string layer_type() const override { return "fake-quantize"; }
+
+  std::vector<shape3d> in_shape() const override { return {in_shape_}; }
+
+  std::vector<shape3d> out_shape() const override { return {in_shape_}; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    tensor_t &y       = *out_data[0];
+
+    if (phase_ == net_phase::train) update_range(x);
+    if (!has_range()) {
+      y = x;
+      return;
+    }
+    for_i(x.size(), [&](size_t i) {
+      std::transform(x[i].begin(), x[i].end(), y[i].begin(), [&](float_t v) {
+        return core::kernels::quantized_to_float<uint8_t>(
+          core::kernels::float_to_quantized<uint8_t>(v, min_, max_), min_,
+          max_);
+      });
+    });
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    const tensor_t &x  = *in_data[0];
+    const tensor_t &dy = *out_grad[0];
+    tensor_t &dx       = *in_grad[0];
+    const bool clip    = has_range();
+
+    for_i(x.size(), [&](size_t i) {
+      for (size_t j = 0; j < x[i].size(); j++) {
+        const bool inside = !clip || (min_ <= x[i][j] && x[i][j] <= max_);
+        dx[i][j]          = inside ? dy[i][j] : float_t{0};
+      }
+    });
+  }
+
+  void set_context(net_phase ctx) override { phase_ = ctx; }
+
+  /**
+   * the range the input is quantized to, empty (min == max) before the
+   * first batch of the train phase
+   **/
+  std::pair<float_t, float_t> range() const {
+    return std::make_pair(min_, max_);
+  }
+
+  void set_range(float_t min, float_t max) {
+    if (!(min <= max)) {
+      throw nn_error("invalid range for " + layer_type());
+    }
+    min_ = min;
+    max_ = max;
+  }
+
+  bool has_range() const { return min_ < max_; }
+
+  float_t momentum() const { return momentum_; }
+
+  friend struct serialization_buddy;
+
+ private:
+  void update_range(const tensor_t &x) {
+    float_t lo = 0, hi = 0;
+    for (const vec_t &v : x) {
+      if (v.empty()) continue;
+      const auto r = std::minmax_element(v.begin(), v.end());
+      lo           = std::min(lo, *r.first);
+      hi           = std::max(hi, *r.second);
+    }
+    if (has_range()) {
+      lo = momentum_ * min_ + (1 - momentum_) * lo;
+      hi = momentum_ * max_ + (1 - momentum_) * hi;
+    }
+    min_ = lo;
+    max_ = hi;
+  }
+
+  shape3d in_shape_;
+  float_t momentum_;
+  net_phase phase_;
+  float_t min_ = 0;
+  float_t max_ = 0;
+};
+
+}  // namespace tiny_dnn
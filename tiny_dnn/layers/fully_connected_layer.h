@@ -7,6 +7,7 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -16,6 +17,7 @@
 
 #include "tiny_dnn/core/kernels/fully_connected_grad_op.h"
 #include "tiny_dnn/core/kernels/fully_connected_op.h"
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
 
 namespace tiny_dnn {
 
@@ -44,7 +46,8 @@ class fully_connected_layer : public layer {
     : layer(std::move(other)),
       params_(std::move(other.params_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
-      kernel_back_(std::move(other.kernel_back_)) {
+      kernel_back_(std::move(other.kernel_back_)),
+      fake_quantize_(other.fake_quantize_) {
     init_backend(std::move(other.engine()));
   }
 
@@ -75,7 +78,9 @@ class fully_connected_layer : public layer {
     fwd_ctx_.setEngine(layer::engine());
 
     // launch fully connected kernel
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], true);
     kernel_fwd_->compute(fwd_ctx_);
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], false);
   }
 
   void back_propagation(const std::vector<tensor_t *> &in_data,
@@ -88,11 +93,64 @@ class fully_connected_layer : public layer {
     bwd_ctx_.setEngine(layer::engine());
 
     // launch fully connected kernel
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], true);
     kernel_back_->compute(bwd_ctx_);
+    if (fake_quantize_) swap_fake_quantized_weights(*in_data[1], false);
   }
 
   std::string layer_type() const override { return "fully-connected"; }
 
+  /**
+   * round the weights as quantized_fully_connected_layer does, in forward
+   * and backward, for quantization-aware training. the gradients still
+   * update the float weights (straight-through estimator).
+   **/
+  void set_fake_quantization(bool enable) { fake_quantize_ = enable; }
+
+  bool fake_quantization() const { return fake_quantize_; }
+
+  bool fold_channel_affine(const vec_t &scale, const vec_t &shift) override {
+    // per-output or a single scalar for the (out_size, 1, 1) output
+    const size_t out = params_.out_size_;
+    if (scale.size() != out && scale.size() != 1) return false;
+    if (!params_.has_bias_) {
+      params_.has_bias_ = true;
+      append_bias_input();
+    }
+    vec_t &W = *weights()[0];
+    vec_t &b = *weights()[1];
+    for (size_t i = 0; i < out; i++) {
+      const float_t s = scale.size() == 1 ? scale[0] : scale[i];
+      const float_t t = shift.size() == 1 ? shift[0] : shift[i];
+      for (size_t c = 0; c < params_.in_size_; c++) {
+        W[c * out + i] *= s;
+      }
+      b[i] = b[i] * s + t;
+    }
+    return true;
+  }
+
+  channel_pruning input_channel_pruning() const override {
+    return channel_pruning::consumes;
+  }
+
+  void prune_input_channels(const std::vector<size_t> &kept,
+                            size_t channels) override {
+    // input c * area + p is the pixel p of the channel c
+    const vec_t W     = *weights()[0];
+    const size_t out  = params_.out_size_;
+    const size_t area = params_.in_size_ / channels;
+
+    set_params(kept.size() * area, out, params_.has_bias_);
+    reshape_edges();
+    vec_t &new_W = *weights()[0];
+    for (size_t c = 0; c < kept.size(); c++) {
+      std::copy(W.begin() + kept[c] * area * out,
+                W.begin() + (kept[c] + 1) * area * out,
+                new_W.begin() + c * area * out);
+    }
+  }
+
   friend struct serialization_buddy;
 
  protected:
@@ -131,6 +189,20 @@ class fully_connected_layer : public layer {
   /* Forward and backward ops */
   std::shared_ptr<core::OpKernel> kernel_fwd_;
   std::shared_ptr<core::OpKernel> kernel_back_;
+
+  /* exchange the float weights with their rounded values, and back */
+  void swap_fake_quantized_weights(tensor_t &W, bool round) {
+    if (round) {
+      // one range per output; W[c * out_size_ + i] connects input c to i
+      fake_W_ = W[0];
+      core::kernels::fake_quantize_filter_per_channel(
+        fake_W_, params_.out_size_, 1, params_.out_size_);
+    }
+    W[0].swap(fake_W_);
+  }
+
+  bool fake_quantize_ = false;
+  vec_t fake_W_;
 };
 
 }  // namespace tiny_dnn
@@ -8,8 +8,6 @@
 #pragma once
 #include <string>
 #include <vector>
-#include "tiny_dnn/activations/sigmoid_layer.h"
-#include "tiny_dnn/activations/tanh_layer.h"
 #include "tiny_dnn/core/kernels/gru_cell_grad_op.h"
 #include "tiny_dnn/core/kernels/gru_cell_op.h"
 #include "tiny_dnn/layers/cell.h"
@@ -35,6 +33,9 @@ struct gru_cell_parameters {
  * h[t] = tanh(W[x->h]x[t] + W[hr->c](s[t−1]r[t]) + b[1->h])  (3)
  * s[t] = (1-z[t])h[t] + z[t]s[t-1]                           (4)
  * ```
+ * The gate weights are stored stacked, W[x->zrh] and W[s->zr] (and one bias
+ * b[1->zrh]), so that each timestep of a batch is computed with three matrix
+ * products.
  *
  * References
  * * [A Theoretically Grounded Application of Dropout in Recurrent Neural
@@ -60,6 +61,7 @@ class gru_cell : public cell {
   gru_cell(gru_cell &&other)
     : cell(std::move(other)),
       params_(std::move(other.params_)),
+      x_projection_(std::move(other.x_projection_)),
       fwd_ctx_(std::move(other.fwd_ctx_)),
       bwd_ctx_(std::move(other.bwd_ctx_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
@@ -68,16 +70,11 @@ class gru_cell : public cell {
   inline std::vector<vector_type> input_order() {
     std::vector<vector_type> types = {vector_type::data,     // input vector
                                       vector_type::aux,      // h(t-1)
-                                      vector_type::weight,   // W[x->z]
-                                      vector_type::weight,   // W[x->r]
-                                      vector_type::weight,   // W[x->h]
+                                      vector_type::weight,   // W[x->zrh]
                                       vector_type::weight,   // W[hr->c]
-                                      vector_type::weight,   // W[s->z]
-                                      vector_type::weight};  // W[s->r]
+                                      vector_type::weight};  // W[s->zr]
     if (params_.has_bias_) {
-      types.push_back(vector_type::bias);  // bz
-      types.push_back(vector_type::bias);  // br
-      types.push_back(vector_type::bias);  // bh
+      types.push_back(vector_type::bias);  // b[1->zrh]
     }
     return types;
   }
@@ -97,19 +94,15 @@ class gru_cell : public cell {
   inline size_t fan_out_size(size_t i) const { return in_shape()[i].height_; }
 
   inline std::vector<index3d<size_t>> in_shape() const {
+    // the gates are stacked as [z | r | h] along the depth
     std::vector<index3d<size_t>> shape = {
       index3d<size_t>(params_.in_size_, 1, 1),                    // x[t]
       index3d<size_t>(params_.out_size_, 1, 1),                   // s[t-1]
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->x]
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->r]
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->h]
+      index3d<size_t>(params_.in_size_, params_.out_size_, 3),    // W[x->zrh]
       index3d<size_t>(params_.out_size_, params_.out_size_, 1),   // W[hr->c]
-      index3d<size_t>(params_.out_size_, params_.out_size_, 1),   // W[s->z]
-      index3d<size_t>(params_.out_size_, params_.out_size_, 1)};  // W[s->r]
+      index3d<size_t>(params_.out_size_, params_.out_size_, 2)};  // W[s->zr]
     if (params_.has_bias_) {
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // bz
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // br
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // bh
+      shape.push_back(index3d<size_t>(params_.out_size_, 1, 3));  // b[1->zrh]
     }
     return shape;
   }
@@ -151,6 +144,23 @@ class gru_cell : public cell {
 
   inline std::string layer_type() const { return "gru-cell"; }
 
+  bool project_inputs(const std::vector<tensor_t *> &in_data) override {
+    kernels::cell_project_inputs(
+      cell::wrapper_->parallelize(), *in_data[0], params_.in_size_,
+      (*in_data[2])[0], params_.has_bias_ ? (*in_data[5])[0] : vec_t(),
+      params_.has_bias_, 3 * params_.out_size_, x_projection_);
+    return true;
+  }
+
+  void use_projected_inputs(bool use, size_t first_row = 0) override {
+    params_.x_projection_ =
+      use ? &x_projection_[first_row * 3 * params_.out_size_] : nullptr;
+  }
+
+  void use_workspace(core::cell_workspace *workspace) override {
+    params_.workspace_ = workspace;
+  }
+
   friend struct serialization_buddy;
 
  protected:
@@ -158,8 +168,6 @@ class gru_cell : public cell {
     params_.in_size_  = in_size;
     params_.out_size_ = out_size;
     params_.has_bias_ = has_bias;
-    params_.tanh_     = std::make_shared<tanh_layer>(tanh_layer());
-    params_.sigmoid_  = std::make_shared<sigmoid_layer>(sigmoid_layer());
   }
 
   void init_backend(const layer *wrapper) {
@@ -175,6 +183,9 @@ class gru_cell : public cell {
   /* The layer parameters */
   core::gru_cell_params params_;
 
+  /* b + W[x->*]x of all the rows of a sequence */
+  vec_t x_projection_;
+
   /* forward op context */
   core::OpKernelContext fwd_ctx_;
 
@@ -0,0 +1,121 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/conv2d_op_avx.h"
+#include "tiny_dnn/core/kernels/conv2d_op_internal.h"
+#include "tiny_dnn/core/kernels/half_precision_kernel.h"
+#include "tiny_dnn/layers/convolutional_layer.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * 2D convolution layer storing its weights in IEEE half precision.
+ *
+ * made from a trained convolutional_layer. every filter weight is reused
+ * over the whole image, so the weights are widened to single precision once
+ * per batch and the convolution itself runs in single precision. the
+ * weights are fixed: the layer is inference only.
+ **/
+class half_convolutional_layer : public layer {
+ public:
+  /**
+   * @param geometry [in] convolution giving the shapes, padding and strides
+   * @param W        [in] weights in the layout of convolutional_layer
+   * @param bias     [in] one bias per output channel, or empty for no bias
+   **/
+  half_convolutional_layer(const convolutional_layer &geometry,
+                           std::vector<kernels::fp16_t> W,
+                           vec_t bias)
+    : layer({vector_type::data}, {vector_type::data}),
+      params_(geometry.params_),
+      padding_op_(geometry.params_),
+      W_(std::move(W)),
+      bias_(std::move(bias)) {
+    params_.has_bias = !bias_.empty();
+    if (W_.size() != params_.weight.size() ||
+        (!bias_.empty() && bias_.size() != params_.out.depth_)) {
+      throw nn_error("invalid weights for " + layer_type());
+    }
+    set_backend_type(geometry.engine());
+  }
+
+  /**
+   * the rounded weights of a trained convolutional layer
+   **/
+  explicit half_convolutional_layer(const convolutional_layer &l)
+    : half_convolutional_layer(
+        l,
+        kernels::to_fp16(*l.weights()[0]),
+        l.weights().size() > 1 ? *l.weights()[1] : vec_t()) {}
+
+  std::string layer_type() const override { return "half-conv"; }
+
+  std::vector<shape3d> in_shape() const override { return {params_.in}; }
+
+  std::vector<shape3d> out_shape() const override { return {params_.out}; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t *in = in_data[0];
+    if (params_.pad_type == padding::same) {
+      padding_op_.copy_and_pad_input(*in, padded_);
+      in = &padded_;
+    }
+    W_buf_.resize(W_.size());
+    kernels::fp16_to_float(W_.data(), W_buf_.data(), W_.size());
+
+    // the kernels read bias[o] unconditionally
+    const vec_t no_bias =
+      bias_.empty() ? vec_t(params_.out.depth_, float_t{0}) : vec_t();
+    const vec_t &bias = bias_.empty() ? no_bias : bias_;
+
+    tensor_t &out = *out_data[0];
+    fill_tensor(out, float_t{0});
+    if (engine() == core::backend_t::avx) {
+      kernels::conv2d_op_avx(*in, W_buf_, bias, out, params_, parallelize());
+    } else {
+      kernels::conv2d_op_internal(*in, W_buf_, bias, out, params_,
+                                  parallelize());
+    }
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    CNN_UNREFERENCED_PARAMETER(out_grad);
+    CNN_UNREFERENCED_PARAMETER(in_grad);
+    throw nn_error(layer_type() + " is inference only");
+  }
+
+  const std::vector<kernels::fp16_t> &half_weights() const { return W_; }
+
+  const vec_t &bias() const { return bias_; }
+
+  friend struct serialization_buddy;
+
+ private:
+  core::conv_params params_;
+  core::Conv2dPadding padding_op_;
+  std::vector<kernels::fp16_t> W_;
+  vec_t bias_;
+
+  // single precision weights and padded input of the current batch
+  vec_t W_buf_;
+  tensor_t padded_;
+};
+
+}  // namespace tiny_dnn
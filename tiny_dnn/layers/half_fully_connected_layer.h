@@ -0,0 +1,114 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/half_precision_kernel.h"
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * fully-connected layer storing its weights in IEEE half precision.
+ *
+ * made from a trained fully_connected_layer, it holds half of the weight
+ * bytes, and its kernel accumulates in single precision. the weights are
+ * fixed: the layer is inference only.
+ **/
+class half_fully_connected_layer : public layer {
+ public:
+  /**
+   * @param in_dim  [in] number of elements of the input
+   * @param out_dim [in] number of elements of the output
+   * @param W       [in] out_dim x in_dim weights, row by row
+   * @param bias    [in] out_dim biases, or empty for no bias
+   **/
+  half_fully_connected_layer(size_t in_dim,
+                             size_t out_dim,
+                             std::vector<kernels::fp16_t> W,
+                             vec_t bias)
+    : layer({vector_type::data}, {vector_type::data}),
+      in_size_(in_dim),
+      out_size_(out_dim),
+      W_(std::move(W)),
+      bias_(std::move(bias)) {
+    if (W_.size() != in_size_ * out_size_ ||
+        (!bias_.empty() && bias_.size() != out_size_)) {
+      throw nn_error("invalid weights for " + layer_type());
+    }
+  }
+
+  /**
+   * the rounded weights of a trained fully-connected layer
+   **/
+  explicit half_fully_connected_layer(const fully_connected_layer &l)
+    : half_fully_connected_layer(
+        l.fan_in_size(),
+        l.fan_out_size(),
+        transposed_fp16(*l.weights()[0], l.fan_in_size(), l.fan_out_size()),
+        l.weights().size() > 1 ? *l.weights()[1] : vec_t()) {}
+
+  std::string layer_type() const override { return "half-fully-connected"; }
+
+  std::vector<shape3d> in_shape() const override {
+    return {shape3d(in_size_, 1, 1)};
+  }
+
+  std::vector<shape3d> out_shape() const override {
+    return {shape3d(out_size_, 1, 1)};
+  }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    kernels::half_fully_connected_kernel(W_, bias_, *in_data[0], *out_data[0],
+                                         in_size_, out_size_, parallelize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    CNN_UNREFERENCED_PARAMETER(out_grad);
+    CNN_UNREFERENCED_PARAMETER(in_grad);
+    throw nn_error(layer_type() + " is inference only");
+  }
+
+  // out_size x in_size, row by row
+  const std::vector<kernels::fp16_t> &half_weights() const { return W_; }
+
+  const vec_t &bias() const { return bias_; }
+
+  friend struct serialization_buddy;
+
+ private:
+  // fully_connected_layer has W[c * out_size + i], the kernel reads rows
+  static std::vector<kernels::fp16_t> transposed_fp16(const vec_t &W,
+                                                      size_t in_size,
+                                                      size_t out_size) {
+    vec_t rows(W.size());
+    for (size_t c = 0; c < in_size; c++) {
+      for (size_t i = 0; i < out_size; i++) {
+        rows[i * in_size + c] = W[c * out_size + i];
+      }
+    }
+    return kernels::to_fp16(rows);
+  }
+
+  size_t in_size_;
+  size_t out_size_;
+  std::vector<kernels::fp16_t> W_;
+  vec_t bias_;
+};
+
+}  // namespace tiny_dnn
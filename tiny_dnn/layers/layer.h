@@ -552,6 +552,12 @@ class layer : public node {
 
     // call the forward computation kernel/routine
     forward_propagation(fwd_in_data_, fwd_out_data_);
+
+    // apply the fused activation in place while the output is still hot
+    if (fused_activation_) {
+      std::vector<tensor_t *> y{fwd_out_data_[0]};
+      fused_activation_->forward_propagation(y, y);
+    }
   }
 
   void backward() {
@@ -571,9 +577,101 @@ class layer : public node {
       bwd_out_data_[i] = nd->get_data();
       bwd_out_grad_[i] = nd->get_gradient();
     }
+    // turn dE/dy of the fused activation into dE/dy of this layer in place
+    if (fused_activation_) {
+      std::vector<tensor_t *> y{bwd_out_data_[0]};
+      std::vector<tensor_t *> dy{bwd_out_grad_[0]};
+      fused_activation_->back_propagation(y, y, dy, dy);
+    }
     back_propagation(bwd_in_data_, bwd_out_data_, bwd_out_grad_, bwd_in_grad_);
   }
 
+  /**
+   * fuse an elementwise activation layer which is the only consumer of this
+   * layer's output.
+   *
+   * the activation is applied in place on the output right after
+   * forward_propagation, and its gradient is applied in place before
+   * back_propagation. The output edge of @a act becomes the output edge of
+   * this layer, so @a act must not be executed on its own afterwards.
+   * @a act must be able to compute its gradient from its output only.
+   **/
+  void fuse_activation(layer *act) {
+    if (fused_activation_) {
+      throw nn_error("cannot fuse activation into " + layer_type());
+    }
+    take_output_of(act);
+    fused_activation_ = act;
+  }
+
+  /**
+   * take over the output edge of @a next, which must be the only consumer of
+   * this layer's single output. Used to drop @a next from the graph after it
+   * was merged into this layer.
+   **/
+  void take_output_of(layer *next) {
+    if (out_channels_ != 1 || next->in_channels_ != 1 ||
+        next->out_channels_ != 1) {
+      throw nn_error("cannot merge " + next->layer_type() + " into " +
+                     layer_type());
+    }
+    next_[0] = next->ith_out_node(0);
+    next_[0]->set_prev(this);
+  }
+
+  /**
+   * fold a per-channel affine transform y' = scale[c] * y + shift[c] of the
+   * output into the weights and bias of this layer, adding a bias if the
+   * layer has none.
+   * @return false if this layer cannot absorb the transform (no change is
+   * made in this case)
+   **/
+  virtual bool fold_channel_affine(const vec_t &scale, const vec_t &shift) {
+    CNN_UNREFERENCED_PARAMETER(scale);
+    CNN_UNREFERENCED_PARAMETER(shift);
+    return false;
+  }
+
+  /**
+   * L2 norm of the weights of each output channel, used to rank the
+   * channels in nodes::prune_channels().
+   * @return empty if the output channels of this layer can't be removed
+   **/
+  virtual vec_t output_channel_norms() const { return vec_t(); }
+
+  /**
+   * keep only the output channels @a kept (in increasing order) and their
+   * weights, shrinking the output shape.
+   **/
+  virtual void prune_output_channels(const std::vector<size_t> &kept) {
+    CNN_UNREFERENCED_PARAMETER(kept);
+    throw nn_error("cannot prune the output channels of " + layer_type());
+  }
+
+  /**
+   * how this layer follows prune_input_channels()
+   **/
+  virtual channel_pruning input_channel_pruning() const {
+    return channel_pruning::none;
+  }
+
+  /**
+   * keep only the input channels @a kept (in increasing order) out of the
+   * @a channels channels of the input, after the layer feeding this one was
+   * shrunk by prune_output_channels().
+   **/
+  virtual void prune_input_channels(const std::vector<size_t> &kept,
+                                    size_t channels) {
+    CNN_UNREFERENCED_PARAMETER(kept);
+    CNN_UNREFERENCED_PARAMETER(channels);
+    throw nn_error("cannot prune the input channels of " + layer_type());
+  }
+
+  /**
+   * return the activation fused by fuse_activation(), or nullptr
+   **/
+  layer *fused_activation() const { return fused_activation_; }
+
   /* @brief Allocates data in the computational graph and reset weights if
    * it's needed or the data is not already initialized.
    *
@@ -652,6 +750,9 @@ class layer : public node {
     // in case we succeed with data initialization, we mark the
     // layer/node as initialized.
     initialized_ = true;
+
+    // weights may have been replaced after a forward pass
+    if (!weights().empty()) post_update();
   }
 
   void clear_grads() {
@@ -661,26 +762,29 @@ class layer : public node {
   }
 
   void update_weight(optimizer *o) {
-    auto &diff = weights_diff_;
-    for (size_t i = 0; i < in_type_.size(); i++) {
-      if (trainable() && is_trainable_weight(in_type_[i])) {
-        vec_t &target = *get_weight_data(i);
-        ith_in_node(i)->merge_grads(&diff);
-        float_t rcp_batch_size =
-          float_t(1.0) / float_t(ith_in_node(i)->get_data()->size());
-        for (size_t j = 0; j < diff.size(); ++j) {
-          diff[j] *= rcp_batch_size;
-        }
-        // parallelize only when target size is big enough to mitigate
-        // thread spawning overhead.
-        bool parallelize = (target.size() >= 512);
-        o->update(diff, target, parallelize);
-      }
-    }
+    std::vector<vec_t *> weights;
+    std::vector<const tensor_t *> grads;
+    collect_weights(weights, grads);
+    if (!weights.empty()) o->update_all(grads, weights);
     clear_grads();
     post_update();
   }
 
+  /**
+   * append the trainable weights of this layer to W, and their per-sample
+   * gradients to dW, for an optimizer::update_all() of the whole model.
+   * gradients are not cleared.
+   **/
+  void collect_weights(std::vector<vec_t *> &W,
+                       std::vector<const tensor_t *> &dW) {
+    if (!trainable()) return;
+    for (size_t i = 0; i < in_type_.size(); i++) {
+      if (!is_trainable_weight(in_type_[i])) continue;
+      W.push_back(get_weight_data(i));
+      dW.push_back(ith_in_node(i)->get_gradient());
+    }
+  }
+
   bool has_same_weights(const layer &rhs, float_t eps) const {
     auto w1 = weights();
     auto w2 = rhs.weights();
@@ -748,10 +852,71 @@ class layer : public node {
   std::shared_ptr<core::backend> backend_;
   /** Pointer to the device on which the layer/node will run */
   Device *device_ptr_ = nullptr;
-  /** Used in update_weight method. Kept as a member variable to reduce
-   * frequent
-   * memory allocation */
-  vec_t weights_diff_;
+  /** Activation applied in place on the output, see fuse_activation() */
+  layer *fused_activation_ = nullptr;
+
+  /**
+   * append a zero-initialized bias input to a layer constructed without one.
+   * in_shape() must already report the shape of the bias.
+   **/
+  void append_bias_input() {
+    in_type_.push_back(vector_type::bias);
+    in_channels_++;
+    prev_.emplace_back();
+    ith_in_node(in_channels_ - 1);
+  }
+
+  /**
+   * fold_channel_affine() for weights holding the @a block weights of each
+   * of the @a channels output channels back to back, followed by one bias
+   * per channel. @a has_bias is the bias flag of the layer parameters.
+   **/
+  bool fold_channel_affine_blocks(const vec_t &scale,
+                                  const vec_t &shift,
+                                  size_t channels,
+                                  size_t block,
+                                  bool *has_bias) {
+    if (scale.size() != channels) return false;
+    if (!*has_bias) {
+      *has_bias = true;
+      append_bias_input();
+    }
+    vec_t &W = *weights()[0];
+    vec_t &b = *weights()[1];
+    for (size_t o = 0; o < channels; o++) {
+      for (size_t k = 0; k < block; k++) {
+        W[o * block + k] *= scale[o];
+      }
+      b[o] = b[o] * scale[o] + shift[o];
+    }
+    return true;
+  }
+
+  /**
+   * reallocate the edges which no longer match in_shape() and out_shape()
+   * after the layer was reshaped. the new weight and bias edges have to be
+   * filled by the caller; the new output edges keep the consumers of the
+   * old ones, which take them as input.
+   **/
+  void reshape_edges() {
+    for (size_t i = 0; i < in_channels_; i++) {
+      if (prev_[i] && !prev_[i]->prev() &&
+          prev_[i]->shape() != in_shape()[i]) {
+        alloc_input(i);
+      }
+    }
+    for (size_t i = 0; i < out_channels_; i++) {
+      edgeptr_t old = next_[i];
+      if (!old || old->shape() == out_shape()[i]) continue;
+      alloc_output(i);
+      for (node *n : old->next()) {
+        layer *consumer       = static_cast<layer *>(n);
+        const size_t port     = consumer->prev_port(*old);
+        consumer->prev_[port] = next_[i];
+        next_[i]->add_next_node(consumer);
+      }
+    }
+  }
 
   template <typename T, typename Func>
   inline void for_i(T size, Func f, size_t grainsize = 100) {
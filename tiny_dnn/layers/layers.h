@@ -14,8 +14,11 @@
 #include "tiny_dnn/layers/convolutional_layer.h"
 #include "tiny_dnn/layers/deconvolutional_layer.h"
 #include "tiny_dnn/layers/dropout_layer.h"
+#include "tiny_dnn/layers/fake_quantize_layer.h"
 #include "tiny_dnn/layers/fully_connected_layer.h"
 #include "tiny_dnn/layers/global_average_pooling_layer.h"
+#include "tiny_dnn/layers/half_convolutional_layer.h"
+#include "tiny_dnn/layers/half_fully_connected_layer.h"
 #include "tiny_dnn/layers/l2_normalization_layer.h"
 #include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/layers/linear_layer.h"
@@ -30,3 +33,4 @@
 #include "tiny_dnn/layers/quantized_fully_connected_layer.h"
 #include "tiny_dnn/layers/recurrent_layer.h"
 #include "tiny_dnn/layers/slice_layer.h"
+#include "tiny_dnn/layers/sparse_fully_connected_layer.h"
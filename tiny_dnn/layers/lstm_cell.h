@@ -8,8 +8,6 @@
 #pragma once
 #include <string>
 #include <vector>
-#include "tiny_dnn/activations/sigmoid_layer.h"
-#include "tiny_dnn/activations/tanh_layer.h"
 #include "tiny_dnn/core/kernels/lstm_cell_grad_op.h"
 #include "tiny_dnn/core/kernels/lstm_cell_op.h"
 #include "tiny_dnn/layers/cell.h"
@@ -38,6 +36,10 @@ struct lstm_cell_parameters {
  * o[t] = σ(W[x->o]x[t] + W[h->o]h[t−1] + b[1->o])                      (5)
  * h[t] = o[t]tanh(c[t])                                                (6)
  * ```
+ * The weights of the four gates are stored stacked in one matrix per input,
+ * W[x->ifoc] and W[h->ifoc] (and one bias b[1->ifoc]), so that each timestep
+ * of a batch is computed with two matrix products.
+ *
  * References
  * * [Long short-term
  *memory](http://www.mitpressjournals.org/doi/abs/10.1162/neco.1997.9.8.1735)
@@ -63,6 +65,7 @@ class lstm_cell : public cell {
   lstm_cell(lstm_cell &&other)
     : cell(std::move(other)),
       params_(std::move(other.params_)),
+      x_projection_(std::move(other.x_projection_)),
       fwd_ctx_(std::move(other.fwd_ctx_)),
       bwd_ctx_(std::move(other.bwd_ctx_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
@@ -72,19 +75,10 @@ class lstm_cell : public cell {
     std::vector<vector_type> types = {vector_type::data,  // input vector
                                       vector_type::aux,  // input state (h(t-1))
                                       vector_type::aux,  // memory (c(t-1))
-                                      vector_type::weight,   // W[x->i]
-                                      vector_type::weight,   // W[x->f]
-                                      vector_type::weight,   // W[x->c]
-                                      vector_type::weight,   // W[x->o]
-                                      vector_type::weight,   // W[h->i]
-                                      vector_type::weight,   // W[h->f]
-                                      vector_type::weight,   // W[h->c]
-                                      vector_type::weight};  // W[h->o]
+                                      vector_type::weight,   // W[x->ifoc]
+                                      vector_type::weight};  // W[h->ifoc]
     if (params_.has_bias_) {
-      types.push_back(vector_type::bias);  // bi
-      types.push_back(vector_type::bias);  // bf
-      types.push_back(vector_type::bias);  // bc
-      types.push_back(vector_type::bias);  // bo
+      types.push_back(vector_type::bias);  // b[1->ifoc]
     }
     return types;
   }
@@ -104,23 +98,15 @@ class lstm_cell : public cell {
   inline size_t fan_out_size(size_t i) const { return in_shape()[i].height_; }
 
   inline std::vector<index3d<size_t>> in_shape() const {
+    // the gates are stacked as [i | f | o | c] along the depth
     std::vector<index3d<size_t>> shape = {
       index3d<size_t>(params_.in_size_, 1, 1),                    // x
       index3d<size_t>(params_.out_size_, 1, 1),                   // h(t-1)
       index3d<size_t>(params_.out_size_, 1, 1),                   // c(t-1)
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->i]
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->f]
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->c]
-      index3d<size_t>(params_.in_size_, params_.out_size_, 1),    // W[x->o]
-      index3d<size_t>(params_.out_size_, params_.out_size_, 1),   // W[h->i]
-      index3d<size_t>(params_.out_size_, params_.out_size_, 1),   // W[h->f]
-      index3d<size_t>(params_.out_size_, params_.out_size_, 1),   // W[h->c]
-      index3d<size_t>(params_.out_size_, params_.out_size_, 1)};  // W[h->o]
+      index3d<size_t>(params_.in_size_, params_.out_size_, 4),    // W[x->ifoc]
+      index3d<size_t>(params_.out_size_, params_.out_size_, 4)};  // W[h->ifoc]
     if (params_.has_bias_) {
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // bi
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // bf
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // bc
-      shape.push_back(index3d<size_t>(params_.out_size_, 1, 1));  // bo
+      shape.push_back(index3d<size_t>(params_.out_size_, 1, 4));  // b[1->ifoc]
     }
     return shape;
   }
@@ -161,6 +147,23 @@ class lstm_cell : public cell {
 
   inline std::string layer_type() const { return "lstm-cell"; }
 
+  bool project_inputs(const std::vector<tensor_t *> &in_data) override {
+    kernels::cell_project_inputs(
+      cell::wrapper_->parallelize(), *in_data[0], params_.in_size_,
+      (*in_data[3])[0], params_.has_bias_ ? (*in_data[5])[0] : vec_t(),
+      params_.has_bias_, 4 * params_.out_size_, x_projection_);
+    return true;
+  }
+
+  void use_projected_inputs(bool use, size_t first_row = 0) override {
+    params_.x_projection_ =
+      use ? &x_projection_[first_row * 4 * params_.out_size_] : nullptr;
+  }
+
+  void use_workspace(core::cell_workspace *workspace) override {
+    params_.workspace_ = workspace;
+  }
+
   friend struct serialization_buddy;
 
  protected:
@@ -168,8 +171,6 @@ class lstm_cell : public cell {
     params_.in_size_  = in_size;
     params_.out_size_ = out_size;
     params_.has_bias_ = has_bias;
-    params_.tanh_     = std::make_shared<tanh_layer>(tanh_layer());
-    params_.sigmoid_  = std::make_shared<sigmoid_layer>(sigmoid_layer());
   }
 
   void init_backend(const layer *wrapper) {
@@ -185,6 +186,9 @@ class lstm_cell : public cell {
   /* The layer parameters */
   core::lstm_cell_params params_;
 
+  /* b + W[x->*]x of all the rows of a sequence */
+  vec_t x_projection_;
+
   /* forward op context */
   core::OpKernelContext fwd_ctx_;
 
@@ -0,0 +1,136 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/layers/average_pooling_layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * average pooling on the uint8 codes of [min_input, max_input], giving the
+ * uint8 codes of [min_output, max_output].
+ *
+ * the codes of each window are summed in integers, and the sum is rescaled
+ * to the output range with the weight and bias of its channel folded into a
+ * fixed-point multiplier and offset.
+ **/
+class quantized_average_pooling_layer : public layer {
+ public:
+  /**
+   * @param l          [in] trained average pooling layer
+   * @param min_input  [in] range coded by the input
+   * @param max_input  [in] range coded by the input
+   * @param min_output [in] range coded by the output
+   * @param max_output [in] range coded by the output
+   **/
+  quantized_average_pooling_layer(const average_pooling_layer &l,
+                                  float_t min_input,
+                                  float_t max_input,
+                                  float_t min_output,
+                                  float_t max_output)
+    : layer({vector_type::data}, {vector_type::data}), params_(l.params_) {
+    if (!(min_input < max_input) || !(min_output < max_output)) {
+      throw nn_error("invalid range for " + layer_type());
+    }
+    const vec_t &W       = *l.weights()[0];
+    const vec_t &b       = *l.weights()[1];
+    const double s_in    = (max_input - min_input) / 255.0;
+    const double s_out   = (max_output - min_output) / 255.0;
+    const double n       = double(params_.pool_size_x * params_.pool_size_y);
+    const double one     = double(int64_t(1) << shift_);
+    const size_t channel = params_.out.depth_;
+
+    // y = (s_in * sum + n * min_input) * w + b, and its code is
+    // (y - min_output) / s_out
+    multiplier_.resize(channel);
+    offset_.resize(channel);
+    empty_.resize(channel);
+    for (size_t c = 0; c < channel; c++) {
+      const double w = double(W[c]) * params_.scale_factor;
+      multiplier_[c] = std::llround(s_in * w / s_out * one);
+      offset_[c] =
+        std::llround((n * min_input * w + b[c] - min_output) / s_out * one);
+      // windows which do not fit into the input only give the bias
+      empty_[c] = core::kernels::float_to_quantized<uint8_t>(b[c], min_output,
+                                                             max_output);
+    }
+  }
+
+  std::string layer_type() const override { return "q_ave-pool"; }
+
+  std::vector<shape3d> in_shape() const override { return {params_.in}; }
+
+  std::vector<shape3d> out_shape() const override { return {params_.out}; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &in_tensor     = *in_data[0];
+    tensor_t &out_tensor          = *out_data[0];
+    const core::avepool_params &p = params_;
+    const int64_t half            = int64_t(1) << (shift_ - 1);
+
+    for_i(in_tensor.size(), [&](size_t sample) {
+      const vec_t &in = in_tensor[sample];
+      vec_t &out      = out_tensor[sample];
+
+      for (size_t c = 0; c < p.out.depth_; c++) {
+        for (size_t oy = 0; oy < p.out.height_; oy++) {
+          for (size_t ox = 0; ox < p.out.width_; ox++) {
+            const size_t x0 = ox * p.stride_x;
+            const size_t y0 = oy * p.stride_y;
+            float_t &dst    = out[p.out.get_index(ox, oy, c)];
+            if (x0 + p.pool_size_x > p.in.width_ ||
+                y0 + p.pool_size_y > p.in.height_) {
+              dst = static_cast<float_t>(empty_[c]);
+              continue;
+            }
+            const float_t *window = &in[p.in.get_index(x0, y0, c)];
+            int64_t sum           = 0;
+            for (size_t dy = 0; dy < p.pool_size_y; dy++) {
+              for (size_t dx = 0; dx < p.pool_size_x; dx++) {
+                sum += static_cast<uint8_t>(window[dy * p.in.width_ + dx]);
+              }
+            }
+            const int64_t code =
+              (sum * multiplier_[c] + offset_[c] + half) >> shift_;
+            dst = static_cast<float_t>(
+              std::min<int64_t>(std::max<int64_t>(code, 0), 255));
+          }
+        }
+      }
+    });
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    CNN_UNREFERENCED_PARAMETER(out_grad);
+    CNN_UNREFERENCED_PARAMETER(in_grad);
+    throw nn_error(layer_type() + " is inference only");
+  }
+
+ private:
+  // fractional bits of the multipliers and offsets
+  static const int shift_ = 24;
+
+  core::avepool_params params_;
+  std::vector<int64_t> multiplier_;
+  std::vector<int64_t> offset_;
+  std::vector<uint8_t> empty_;
+};
+
+}  // namespace tiny_dnn
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "tiny_dnn/core/backend_tiny.h"
+#include "tiny_dnn/layers/convolutional_layer.h"
 #ifdef CNN_USE_AVX
 #include "tiny_dnn/core/backend_avx.h"
 #endif
@@ -209,6 +210,28 @@ class quantized_convolutional_layer : public layer {
     init_backend(backend_type);
   }
 
+  /**
+   * quantized equivalent of a trained float convolutional layer, with a copy
+   * of its weights. dilated convolutions are not supported.
+   *
+   * @param l [in] the float layer to convert
+   **/
+  explicit quantized_convolutional_layer(const convolutional_layer &l)
+    : layer(std_input_order(l.params_.has_bias), {vector_type::data}) {
+    const core::conv_params &p = l.params_;
+    if (p.w_dilation != 1 || p.h_dilation != 1) {
+      throw nn_error("dilated convolution cannot be quantized");
+    }
+    conv_set_params(p.in, p.weight.width_, p.weight.height_, p.out.depth_,
+                    p.pad_type, p.has_bias, p.w_stride, p.h_stride, p.tbl);
+    init_backend(core::backend_t::internal);
+
+    std::vector<float_t> w;
+    for (const vec_t *v : l.weights()) w.insert(w.end(), v->begin(), v->end());
+    int idx = 0;
+    load(w, idx);
+  }
+
   // move constructor
   quantized_convolutional_layer(
     quantized_convolutional_layer &&other)  // NOLINT
@@ -244,6 +267,68 @@ class quantized_convolutional_layer : public layer {
     }
   }
 
+  /**
+   * the uint8 weights are kept across forward calls, and quantized again
+   * after every weight update or load. callers that edit the weights
+   * directly call post_update().
+   **/
+  void post_update() override { quantized_.valid = false; }
+
+  /**
+   * quantize the input to the fixed range [min_input, max_input] found by
+   * calibration, rather than to the range of each input. values outside of
+   * the range are clamped.
+   **/
+  void set_input_range(float_t min_input, float_t max_input) {
+    if (!(min_input < max_input)) {
+      throw nn_error("invalid input range for " + layer_type());
+    }
+    quantized_.has_input_range = true;
+    quantized_.min_input       = min_input;
+    quantized_.max_input       = max_input;
+  }
+
+  /**
+   * take the uint8 codes of [min_input, max_input] as input, as produced by
+   * a previous quantized layer whose output range was set to the same range
+   **/
+  void set_quantized_input(float_t min_input, float_t max_input) {
+    set_input_range(min_input, max_input);
+    quantized_.quantized_input = true;
+    // the padding has to hold the code of 0 rather than 0
+    const float_t zero = static_cast<float_t>(
+      core::kernels::float_to_quantized<uint8_t>(0, min_input, max_input));
+    for (vec_t &buf : cws_.prev_out_buf_) {
+      std::fill(buf.begin(), buf.end(), zero);
+    }
+  }
+
+  /**
+   * produce the uint8 codes of the fixed range [min_output, max_output]
+   * rather than floats, so that the next quantized layer takes them as they
+   * are. values outside of the range are clamped.
+   **/
+  void set_output_range(float_t min_output, float_t max_output) {
+    if (!(min_output < max_output)) {
+      throw nn_error("invalid output range for " + layer_type());
+    }
+    quantized_.has_output_range = true;
+    quantized_.min_output       = min_output;
+    quantized_.max_output       = max_output;
+  }
+
+  void load(std::istream &is,
+            const int precision =
+              std::numeric_limits<float_t>::digits10 + 2) override {
+    layer::load(is, precision);
+    quantized_.valid = false;
+  }
+
+  void load(const std::vector<float_t> &src, int &idx) override {  // NOLINT
+    layer::load(src, idx);
+    quantized_.valid = false;
+  }
+
   /**
    * return delta of previous layer (delta=\frac{dE}{da}, a=wx in
    *fully-connected layer)
@@ -344,6 +429,9 @@ class quantized_convolutional_layer : public layer {
     params_.w_stride = w_stride;
     params_.h_stride = h_stride;
     params_.tbl      = tbl;
+
+    // init padding buffer
+    init();
   }
 
   void init() {
@@ -471,7 +559,7 @@ class quantized_convolutional_layer : public layer {
         [this](const tensor_t &delta, tensor_t &dst) {
           return copy_and_unpad_delta(delta, dst);
         },
-        &cws_);
+        &cws_, &quantized_);
     } else {
       throw nn_error("Not supported backend type.");
     }
@@ -492,6 +580,9 @@ class quantized_convolutional_layer : public layer {
 
   /* Workers buffers */
   core::conv_layer_worker_specific_storage cws_;
+
+  /* Weights quantized by the backend, see post_update() */
+  core::kernels::quantized_weights quantized_;
 };
 
 }  // namespace tiny_dnn
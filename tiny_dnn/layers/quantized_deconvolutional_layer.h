@@ -242,6 +242,25 @@ class quantized_deconvolutional_layer : public layer {
     }
   }
 
+  /**
+   * the uint8 weights are kept across forward calls, and quantized again
+   * after every weight update or load. callers that edit the weights
+   * directly call post_update().
+   **/
+  void post_update() override { quantized_.valid = false; }
+
+  void load(std::istream &is,
+            const int precision =
+              std::numeric_limits<float_t>::digits10 + 2) override {
+    layer::load(is, precision);
+    quantized_.valid = false;
+  }
+
+  void load(const std::vector<float_t> &src, int &idx) override {  // NOLINT
+    layer::load(src, idx);
+    quantized_.valid = false;
+  }
+
   /**
    * return delta of previous layer (delta=\frac{dE}{da}, a=wx in
    *fully-connected layer)
@@ -329,7 +348,7 @@ class quantized_deconvolutional_layer : public layer {
         [this](const tensor_t &delta, tensor_t &dst) {
           return copy_and_pad_delta(delta, dst);
         },
-        &deconv_layer_worker_storage_);
+        &deconv_layer_worker_storage_, &quantized_);
     } else {
       throw nn_error("Not supported backend type.");
     }
@@ -492,6 +511,9 @@ class quantized_deconvolutional_layer : public layer {
 
   /* Workers buffers */
   core::deconv_layer_worker_specific_storage deconv_layer_worker_storage_;
+
+  /* Weights quantized by the backend, see post_update() */
+  core::kernels::quantized_weights quantized_;
 };
 
 }  // namespace tiny_dnn
@@ -12,6 +12,7 @@
 #include <utility>
 #include <vector>
 
+#include "tiny_dnn/layers/fully_connected_layer.h"
 #include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/util/product.h"
 
@@ -37,6 +38,23 @@ class quantized_fully_connected_layer : public layer {
     init_backend(backend_type);
   }
 
+  /**
+   * quantized equivalent of a trained float fully-connected layer, with a
+   * copy of its weights.
+   *
+   * @param l [in] the float layer to convert
+   **/
+  explicit quantized_fully_connected_layer(const fully_connected_layer &l)
+    : layer(std_input_order(l.in_channels() == 3), {vector_type::data}) {
+    set_params(l.fan_in_size(), l.fan_out_size(), l.in_channels() == 3);
+    init_backend(core::backend_t::internal);
+
+    std::vector<float_t> w;
+    for (const vec_t *v : l.weights()) w.insert(w.end(), v->begin(), v->end());
+    int idx = 0;
+    load(w, idx);
+  }
+
   // move constructor
   quantized_fully_connected_layer(quantized_fully_connected_layer &&other)
     : layer(std::move(other)), params_(std::move(other.params_)) {
@@ -72,6 +90,62 @@ class quantized_fully_connected_layer : public layer {
     }
   }
 
+  /**
+   * the uint8 weights are kept across forward calls, and quantized again
+   * after every weight update or load. callers that edit the weights
+   * directly call post_update().
+   **/
+  void post_update() override { quantized_.valid = false; }
+
+  /**
+   * quantize the input to the fixed range [min_input, max_input] found by
+   * calibration, rather than to the range of each input. values outside of
+   * the range are clamped.
+   **/
+  void set_input_range(float_t min_input, float_t max_input) {
+    if (!(min_input < max_input)) {
+      throw nn_error("invalid input range for " + layer_type());
+    }
+    quantized_.has_input_range = true;
+    quantized_.min_input       = min_input;
+    quantized_.max_input       = max_input;
+  }
+
+  /**
+   * take the uint8 codes of [min_input, max_input] as input, as produced by
+   * a previous quantized layer whose output range was set to the same range
+   **/
+  void set_quantized_input(float_t min_input, float_t max_input) {
+    set_input_range(min_input, max_input);
+    quantized_.quantized_input = true;
+  }
+
+  /**
+   * produce the uint8 codes of the fixed range [min_output, max_output]
+   * rather than floats, so that the next quantized layer takes them as they
+   * are. values outside of the range are clamped.
+   **/
+  void set_output_range(float_t min_output, float_t max_output) {
+    if (!(min_output < max_output)) {
+      throw nn_error("invalid output range for " + layer_type());
+    }
+    quantized_.has_output_range = true;
+    quantized_.min_output       = min_output;
+    quantized_.max_output       = max_output;
+  }
+
+  void load(std::istream &is,
+            const int precision =
+              std::numeric_limits<float_t>::digits10 + 2) override {
+    layer::load(is, precision);
+    quantized_.valid = false;
+  }
+
+  void load(const std::vector<float_t> &src, int &idx) override {  // NOLINT
+    layer::load(src, idx);
+    quantized_.valid = false;
+  }
+
   void back_propagation(const std::vector<tensor_t *> &in_data,
                         const std::vector<tensor_t *> &out_data,
                         std::vector<tensor_t *> &out_grad,
@@ -86,6 +160,9 @@ class quantized_fully_connected_layer : public layer {
  protected:
   core::fully_params params_;
 
+  /* Weights quantized by the backend, see post_update() */
+  core::kernels::quantized_weights quantized_;
+
   void set_params(const size_t in_size, const size_t out_size, bool has_bias) {
     params_.in_size_  = in_size;
     params_.out_size_ = out_size;
@@ -97,7 +174,7 @@ class quantized_fully_connected_layer : public layer {
 
     // allocate new backend
     if (backend_type == core::backend_t::internal) {
-      backend = std::make_shared<core::tiny_backend>(&params_);
+      backend = std::make_shared<core::tiny_backend>(&params_, &quantized_);
     } else {
       throw nn_error("Not supported backend type.");
     }
@@ -0,0 +1,88 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/tiny_quantization_kernel.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * relu on the uint8 codes of [min_input, max_input], giving the uint8 codes
+ * of [min_output, max_output].
+ *
+ * the 256 possible outputs are computed once, so that a quantized layer
+ * followed by a relu stays in the integer domain.
+ **/
+class quantized_relu_layer : public layer {
+ public:
+  /**
+   * @param in_shape   [in] shape of input tensor
+   * @param min_input  [in] range coded by the input
+   * @param max_input  [in] range coded by the input
+   * @param min_output [in] range coded by the output
+   * @param max_output [in] range coded by the output
+   **/
+  quantized_relu_layer(const shape3d &in_shape,
+                       float_t min_input,
+                       float_t max_input,
+                       float_t min_output,
+                       float_t max_output)
+    : layer({vector_type::data}, {vector_type::data}),
+      in_shape_(in_shape),
+      table_(256) {
+    if (!(min_input < max_input) || !(min_output < max_output)) {
+      throw nn_error("invalid range for " + layer_type());
+    }
+    for (size_t code = 0; code < table_.size(); code++) {
+      const float_t x = core::kernels::quantized_to_float<uint8_t>(
+        static_cast<uint8_t>(code), min_input, max_input);
+      table_[code] = core::kernels::float_to_quantized<uint8_t>(
+        std::max(x, float_t{0}), min_output, max_output);
+    }
+  }
+
+  std::string layer_type() const override { return "q_relu"; }
+
+  std::vector<shape3d> in_shape() const override { return {in_shape_}; }
+
+  std::vector<shape3d> out_shape() const override { return {in_shape_}; }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    const tensor_t &x = *in_data[0];
+    tensor_t &y       = *out_data[0];
+
+    for_i(x.size(), [&](size_t i) {
+      std::transform(x[i].begin(), x[i].end(), y[i].begin(), [&](float_t q) {
+        return static_cast<float_t>(table_[static_cast<uint8_t>(q)]);
+      });
+    });
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    CNN_UNREFERENCED_PARAMETER(out_grad);
+    CNN_UNREFERENCED_PARAMETER(in_grad);
+    throw nn_error(layer_type() + " is inference only");
+  }
+
+ private:
+  shape3d in_shape_;
+  std::vector<uint8_t> table_;
+};
+
+}  // namespace tiny_dnn
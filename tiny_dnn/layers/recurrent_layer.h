@@ -29,6 +29,42 @@ struct recurrent_layer_parameters {
   bool reset_state = true;
 };
 
+/**
+ * State of independent streams advanced one step at a time by
+ * recurrent_layer::step(), e.g. to generate text one character at a time.
+ * Allocated once by recurrent_layer::make_state(), it holds the hidden state
+ * of every stream along with the buffers of a step and the scratch of the
+ * cell kernels, so that a step reuses them instead of allocating.
+ *
+ * The state refers to the weight edges of its layer: it is invalid once the
+ * layer is reshaped or reconnected, and a new one must be made.
+ **/
+class recurrent_state {
+ public:
+  // number of streams, which are advanced together as a batch
+  size_t streams() const { return streams_; }
+
+  // zeroes the state and the output of every stream
+  void clear() {
+    for (auto &tensor : in_) fill_tensor(tensor, float_t{0});
+    for (auto &tensor : out_) fill_tensor(tensor, float_t{0});
+  }
+
+  // output of the last step, one row per stream
+  const tensor_t &output() const { return out_[0]; }
+
+ private:
+  friend class recurrent_layer;
+
+  size_t streams_ = 0;
+  // inputs and outputs of the cell; the weights are the layer's own
+  std::vector<tensor_t> in_;
+  std::vector<tensor_t> out_;
+  std::vector<tensor_t *> in_ptr_;
+  std::vector<tensor_t *> out_ptr_;
+  core::cell_workspace workspace_;
+};
+
 /**
  * Recurrent layer
  * ===============
@@ -42,6 +78,10 @@ struct recurrent_layer_parameters {
  * which is forwarded/backwarded sequence-wise, feeding the output state of each
  * step to the input of the next one.
  *
+ * Sequences shorter than `seq_len` can share a batch with longer ones: with
+ * their lengths given to `seq_lengths()`, the batch shrinks as they finish
+ * instead of computing the padding.
+ *
  * By default, the state is reset every time that a tensor of `seq_len *
  * batch_size` is processed. However, this can be avoided by increasing the max
  * backpropagation-through-time steps, which is the number of iterations until
@@ -89,7 +129,8 @@ class recurrent_layer : public layer {
       bptt_max_(std::move(other.bptt_max_)),
       bptt_count_(std::move(other.bptt_count_)),
       reset_state_(std::move(other.reset_state_)),
-      seq_len_(std::move(other.seq_len_)) {
+      seq_len_(std::move(other.seq_len_)),
+      seq_lengths_(std::move(other.seq_lengths_)) {
     cell_->init_backend(static_cast<layer *>(this));
     init();
   }
@@ -146,8 +187,11 @@ class recurrent_layer : public layer {
   }
 
   /**
-   * Forward propagation through time. Copies each sequence to a buffer and
-   * forwards it propagating the hidden states.
+   * Forward propagation through time. The step buffers borrow the rows of
+   * each timestep from the sequence tensors, so the cell reads and writes them
+   * in place, and the output state of each step is the input of the next one.
+   * Only the sequences that have not finished take part in a step (see
+   * seq_lengths()).
    * @param in_data  [in]  input tensors. Data must be of size (seq_length *
    * batch_size, dim2, ..., dimn).
    * @param out_data [out] output tensors.
@@ -155,6 +199,10 @@ class recurrent_layer : public layer {
   void forward_propagation(const std::vector<tensor_t *> &in_data,
                            std::vector<tensor_t *> &out_data) override {
     size_t batch_size = (*out_data[0]).size() / seq_len_;
+    if (!seq_lengths_.empty() &&
+        (seq_lengths_.size() != batch_size || seq_lengths_[0] > seq_len_)) {
+      throw nn_error("sequence lengths do not match the input batch");
+    }
     // create buffers to store the batches of the sequences
     reshape_forward_buffers_(batch_size, in_data);
 
@@ -165,58 +213,56 @@ class recurrent_layer : public layer {
       } else {
         for (size_t i = 0; i < in_type_.size(); i++) {
           if (in_type_[i] == vector_type::aux) {
-            *input_buffer_[i] = *in_data[i];
+            state_[i].assign(in_data[i]->begin(),
+                             in_data[i]->begin() + batch_size);
           }
         }
       }
     }
 
-    size_t start = 0;  // auxiliary variable
+    // the input-to-hidden products do not depend on the recurrence; compute
+    // them for all the rows of the sequence with one matrix product
+    const bool projected = project_inputs_(batch_size, in_data);
+
+    size_t first_row = 0;  // of the current step, among the projected rows
     for (size_t s = 0; s < seq_len_; s++) {
-      start = s * batch_size;
-      for (size_t i = 0; i < in_data.size(); i++) {
-        // move current sequence batch to a buffer
-        if (in_type_[i] == vector_type::data) {
-          auto *data       = &(*in_data[i])[start];
-          tensor_t &buffer = *input_buffer_[i];
-          for (size_t b = 0; b < batch_size; b++) {
-            buffer[b] = data[b];  // copy data
-          }
-        } else if (in_type_[i] == vector_type::aux) {
-          auto *data       = &(*in_data[i])[start];
-          tensor_t &buffer = *input_buffer_[i];
-          if (!reset_state_) {
-            for (size_t b = 0; b < batch_size; b++) {
-              data[b] = buffer[b];  // copy state
-            }
-          }
-        }
+      const size_t active = active_samples_(s, batch_size);
+      if (active > 0) {
+        if (projected) cell_->use_projected_inputs(true, first_row);
+        swap_step_(s, batch_size, active, state_, in_data, out_data);
+        cell_->forward_propagation(input_buffer_, output_buffer_);
+        swap_step_(s, batch_size, active, state_, in_data, out_data);
+        first_row += active;
       }
-      // forward current sequence batch
-      cell_->forward_propagation(input_buffer_, output_buffer_);
-      // move from buffer to output
+      // finished sequences output zeros
       for (size_t o = 0; o < out_data.size(); o++) {
-        tensor_t &out_buffer = *output_buffer_[o];
-        auto *data           = &(*out_data[o])[start];
-        for (size_t b = 0; b < batch_size; b++) {
-          data[b] = out_buffer[b];
-        }
-        // copy output state to next input
-        if (state_mask_[o]) {
-          auto &in_buffer = *input_buffer_[state_map_o2i_[o]];
-          for (size_t b = 0; b < batch_size; b++) {
-            in_buffer[b] = out_buffer[b];
-          }
+        for (size_t b = active; b < batch_size; b++) {
+          vec_t &row = (*out_data[o])[s * batch_size + b];
+          std::fill(row.begin(), row.end(), float_t{0});
         }
       }
     }
+    if (projected) cell_->use_projected_inputs(false);
+
+    // keep the state the sequences started from for the backward pass, and
+    // carry the one of the last step of each sequence over to the next call
+    for (const auto &m : state_map_o2i_) {
+      tensor_t &state = state_[m.second];
+      std::swap(state, initial_state_[m.second]);
+      state.resize(batch_size);
+      for (size_t b = 0; b < batch_size; b++) {
+        const size_t last = seq_length_(b) - 1;
+        state[b]          = (*out_data[m.first])[last * batch_size + b];
+      }
+    }
     bptt_count_ = (bptt_count_ + seq_len_) % bptt_max_;
   }
 
   /**
-   * Back propagation through time. Copies each sequence to a buffer and
-   * backwards it copying state input grads to
-   * previous sequence output grads.
+   * Back propagation through time. As in the forward pass, the step buffers
+   * borrow the rows of each timestep; the state input gradients of a step are
+   * written straight into the state output gradients of the previous one.
+   * The steps past the end of a sequence get zero gradients.
    * @param in_data  [in]  input tensors. Data must be of size (seq_length *
    * batch_size, dim2, ..., dimn).
    * @param out_data [in]  output tensors.
@@ -228,68 +274,117 @@ class recurrent_layer : public layer {
                         std::vector<tensor_t *> &out_grad,
                         std::vector<tensor_t *> &in_grad) override {
     size_t batch_size = (*out_data[0]).size() / seq_len_;
-    // resize input buffers
-    reshape_backward_buffers_(batch_size, in_data);
+    bind_parameters_(in_data);
 
-    // move input to buffer
-    for (int s = (seq_len_ - 1); s >= 0; s--) {
-      const size_t start = batch_size * s;
-      for (size_t i = 0; i < in_data.size(); i++) {
-        if (in_type_[i] == vector_type::data ||
-            in_type_[i] == vector_type::aux) {
-          auto *data       = &(*in_data[i])[start];
-          tensor_t &buffer = *input_buffer_[i];
-          for (size_t b = 0; b < batch_size; b++) {
-            buffer[b] = data[b];
-          }
+    for (int s = static_cast<int>(seq_len_) - 1; s >= 0; s--) {
+      const size_t active = active_samples_(s, batch_size);
+      for (size_t i = 0; i < in_grad.size(); i++) {
+        for (size_t b = active; b < batch_size; b++) {
+          vec_t &row = (*in_grad[i])[s * batch_size + b];
+          std::fill(row.begin(), row.end(), float_t{0});
         }
-        auto &grad_buffer = *input_grad_buffer_[i];
-        fill_tensor(grad_buffer, 0.0);
       }
-      // fill output
-      for (size_t o = 0; o < out_data.size(); o++) {
-        tensor_t &buffer      = *output_buffer_[o];
-        tensor_t &grad_buffer = *output_grad_buffer_[o];
-        auto *data            = &(*out_data[o])[start];
-        auto *grad            = &(*out_grad[o])[start];
-        int end               = seq_len_ - 1;
-        if (out_type_[o] == vector_type::aux && s == end && reset_state_) {
-          fill_tensor(buffer, 0.0);
-          fill_tensor(grad_buffer, 0.0);
-        } else {
-          for (size_t b = 0; b < batch_size; b++) {
-            buffer[b]      = data[b];
-            grad_buffer[b] = grad[b];
+      if (active == 0) continue;
+
+      swap_step_(s, batch_size, active, initial_state_, in_data, out_data);
+      swap_step_grads_(s, batch_size, active, out_grad, in_grad);
+      for (size_t i = 0; i < in_data.size(); i++) {
+        fill_tensor(*input_grad_buffer_[i], float_t{0});
+      }
+      // nothing flows back into the state of the last step of a sequence
+      if (reset_state_) {
+        const size_t last = active_samples_(s + 1, batch_size);
+        for (size_t o = 0; o < out_data.size(); o++) {
+          if (out_type_[o] != vector_type::aux) continue;
+          for (size_t b = last; b < active; b++) {
+            vec_t &row = (*output_grad_buffer_[o])[b];
+            std::fill(row.begin(), row.end(), float_t{0});
           }
         }
       }
       cell_->back_propagation(input_buffer_, output_buffer_,
                               output_grad_buffer_, input_grad_buffer_);
-      for (size_t i = 0; i < in_data.size(); i++) {
-        auto *in_grad_   = &(*in_grad[i])[start];
-        tensor_t &buffer = *input_grad_buffer_[i];
-        for (size_t b = 0; b < batch_size; b++) {
-          if (clip_ > 0) {
-            clip(buffer[b], clip_, in_grad_[b]);
-          } else {
-            in_grad_[b] = buffer[b];
+      if (clip_ > 0) {
+        for (size_t i = 0; i < in_data.size(); i++) {
+          for (auto &grad : *input_grad_buffer_[i]) {
+            clip(grad, clip_, grad);
           }
         }
       }
-      // copy gradient to previous state
-      if (s > 0) {
-        for (size_t o = 0; o < out_data.size(); o++) {
-          if (state_mask_[o]) {
-            tensor_t &buffer  = *input_grad_buffer_[state_map_o2i_[o]];
-            size_t prev_start = batch_size * (s - 1);
-            auto *out_grad_   = &(*out_grad[o])[prev_start];
-            for (size_t b = 0; b < batch_size; b++) {
-              out_grad_[b] = buffer[b];
-            }
-          }
+      swap_step_grads_(s, batch_size, active, out_grad, in_grad);
+      swap_step_(s, batch_size, active, initial_state_, in_data, out_data);
+    }
+  }
+
+  /**
+   * Allocates the state of independent streams for step(), all of them
+   * starting from a zero state. The state reads the weights of this layer
+   * through its edges, so it must be made again after the layer is reshaped
+   * or reconnected.
+   * @param streams [in] number of streams advanced together.
+   */
+  recurrent_state make_state(size_t streams) {
+    recurrent_state st;
+    st.streams_     = streams;
+    auto in_shape_  = in_shape();
+    auto out_shape_ = out_shape();
+    st.in_.resize(in_shape_.size());
+    for (size_t i = 0; i < in_shape_.size(); i++) {
+      if (in_type_[i] == vector_type::data || in_type_[i] == vector_type::aux) {
+        st.in_[i].assign(streams, vec_t(in_shape_[i].size(), float_t{0}));
+      }
+    }
+    st.out_.resize(out_shape_.size());
+    for (size_t o = 0; o < out_shape_.size(); o++) {
+      st.out_[o].assign(streams, vec_t(out_shape_[o].size(), float_t{0}));
+    }
+    // the weights are read from the layer's edges
+    st.in_ptr_.resize(in_shape_.size());
+    st.out_ptr_.resize(out_shape_.size());
+    auto in_edges = inputs();
+    for (size_t i = 0; i < in_shape_.size(); i++) {
+      st.in_ptr_[i] = in_edges[i]->get_data();
+    }
+    // a first step sizes the scratch of the cell kernels
+    step(tensor_t(streams, vec_t(in_shape_[0].size())), st);
+    st.clear();
+    return st;
+  }
+
+  /**
+   * Advances every stream by one step, without the buffer management of
+   * forward(): the step works in the buffers of the state, allocated by
+   * make_state(). The output state of the step becomes the state of the
+   * streams by swapping buffers.
+   * @param x  [in] next input of each stream, one row per stream.
+   * @param st [in,out] state of the streams, from make_state().
+   * @return the output of the step, one row per stream.
+   */
+  const tensor_t &step(const tensor_t &x, recurrent_state &st) {
+    if (x.size() != st.streams_ ||
+        (!x.empty() && x[0].size() != in_shape()[0].size())) {
+      throw nn_error("input does not match the streams of the state");
+    }
+    for (size_t i = 0; i < in_type_.size(); i++) {
+      if (in_type_[i] == vector_type::data) {
+        for (size_t b = 0; b < x.size(); b++) {
+          std::copy(x[b].begin(), x[b].end(), st.in_[i][b].begin());
         }
       }
+      if (in_type_[i] == vector_type::data || in_type_[i] == vector_type::aux) {
+        st.in_ptr_[i] = &st.in_[i];
+      }
     }
+    for (size_t o = 0; o < st.out_.size(); o++) {
+      st.out_ptr_[o] = &st.out_[o];
+    }
+    cell_->use_workspace(&st.workspace_);
+    cell_->forward_propagation(st.in_ptr_, st.out_ptr_);
+    cell_->use_workspace(nullptr);
+    for (const auto &m : state_map_o2i_) {
+      std::swap(st.in_[m.second], st.out_[m.first]);
+    }
+    return st.out_[0];
   }
 
   std::string layer_type() const override { return "recurrent-layer"; }
@@ -298,9 +393,9 @@ class recurrent_layer : public layer {
    * Zeroes the hidden state.
    */
   void clear_state() {
-    for (size_t i = 0; i < input_buffer_.size(); i++) {
+    for (size_t i = 0; i < state_.size(); i++) {
       if (in_type_[i] == vector_type::aux) {
-        fill_tensor(*input_buffer_[i], 0.0);
+        fill_tensor(state_[i], 0.0);
       }
     }
     bptt_count_ = 0;
@@ -323,6 +418,25 @@ class recurrent_layer : public layer {
    */
   void seq_len(size_t len) { seq_len_ = len; }
 
+  /**
+   * Sets the length of each sequence of the batch, so that sequences shorter
+   * than `seq_len` are not computed past their end. They must be sorted from
+   * the longest to the shortest: the batch then shrinks as they finish. The
+   * outputs of the steps past the end of a sequence are zero, and the state
+   * carried over to the next call is the one of its last step.
+   * @param lengths [in] length of each sequence of the batch, or empty for
+   * sequences of `seq_len` steps.
+   */
+  void seq_lengths(const std::vector<size_t> &lengths) {
+    for (size_t b = 0; b < lengths.size(); b++) {
+      if (lengths[b] == 0 || (b > 0 && lengths[b] > lengths[b - 1])) {
+        throw nn_error(
+          "sequence lengths must be positive and in decreasing order");
+      }
+    }
+    seq_lengths_ = lengths;
+  }
+
   friend struct serialization_buddy;
 
  private:
@@ -331,6 +445,8 @@ class recurrent_layer : public layer {
     input_grad_buffer_.resize(in_shape().size());
     output_buffer_.resize(out_shape().size());
     output_grad_buffer_.resize(out_shape().size());
+    state_.resize(input_buffer_.size());
+    initial_state_.resize(input_buffer_.size());
     delete_mask_.resize(input_buffer_.size(), false);
     std::vector<size_t> state_pos;
     for (size_t i = 0; i < in_shape().size(); i++) {
@@ -347,8 +463,9 @@ class recurrent_layer : public layer {
       output_buffer_[o]      = new tensor_t();
       output_grad_buffer_[o] = new tensor_t();
       size_t map_size        = state_map_o2i_.size();
-      if (in_type_[o] == vector_type::aux && map_size < state_pos.size()) {
-        state_map_o2i_[o] = state_pos[map_size];
+      if (out_type_[o] == vector_type::aux && map_size < state_pos.size()) {
+        state_map_o2i_[o]                   = state_pos[map_size];
+        state_map_i2o_[state_pos[map_size]] = o;
         state_mask_.push_back(true);
       } else {
         state_mask_.push_back(false);
@@ -356,68 +473,136 @@ class recurrent_layer : public layer {
     }
   }
 
-  // Helper function to set internal input buffers to the correct size.
-  inline void reshape_forward_buffers_(const size_t batch_size,
-                                       const std::vector<tensor_t *> &in_data) {
+  size_t seq_length_(size_t sample) const {
+    return seq_lengths_.empty() ? seq_len_ : seq_lengths_[sample];
+  }
+
+  // number of sequences taking part in step s, which come first in the batch
+  size_t active_samples_(size_t s, size_t batch_size) const {
+    if (seq_lengths_.empty()) return s < seq_len_ ? batch_size : 0;
+    size_t active = 0;
+    while (active < batch_size && seq_lengths_[active] > s) active++;
+    return active;
+  }
+
+  // exchanges the rows of a step buffer with rows [start, start + n) of a
+  // sequence tensor; doing it twice gives both of them back
+  static void swap_rows_(tensor_t &buffer,
+                         tensor_t &seq,
+                         size_t start,
+                         size_t n) {
+    buffer.resize(n);
+    for (size_t b = 0; b < n; b++) {
+      buffer[b].swap(seq[start + b]);
+    }
+  }
+
+  // lends the data and outputs of the active samples of timestep s to the
+  // step buffers, or takes them back. the state inputs of s > 0 are the state
+  // outputs of s - 1, the ones of s = 0 are taken from first_state.
+  void swap_step_(size_t s,
+                  size_t batch_size,
+                  size_t active,
+                  std::vector<tensor_t> &first_state,
+                  const std::vector<tensor_t *> &in_data,
+                  const std::vector<tensor_t *> &out_data) {
+    const size_t start = s * batch_size;
     for (size_t i = 0; i < in_data.size(); i++) {
-      auto &buffer   = *input_buffer_[i];
-      auto in_shape_ = in_shape();
-      // weights and biases do not change with the length of the sequences
-      if (in_type_[i] == vector_type::weight ||
-          in_type_[i] == vector_type::bias) {
-        input_buffer_[i] = in_data[i];
+      if (in_type_[i] == vector_type::data) {
+        swap_rows_(*input_buffer_[i], *in_data[i], start, active);
+      }
+    }
+    for (const auto &m : state_map_o2i_) {
+      if (s == 0) {
+        swap_rows_(*input_buffer_[m.second], first_state[m.second], 0, active);
       } else {
-        buffer.resize(batch_size);
-        if (in_type_[i] == vector_type::aux) {
-          for (size_t b = 0; b < batch_size; b++) {
-            buffer[b].resize(in_shape_[i].size(), 0);
-          }
-        }
+        swap_rows_(*input_buffer_[m.second], *out_data[m.first],
+                   start - batch_size, active);
       }
     }
-    auto out_shape_ = out_shape();
-    for (size_t o = 0; o < out_shape_.size(); o++) {
-      tensor_t &buffer = *output_buffer_[o];
-      buffer.resize(batch_size);
-      for (size_t b = 0; b < batch_size; b++) {
-        buffer[b].resize(out_shape_[o].size(), 0);
+    for (size_t o = 0; o < out_data.size(); o++) {
+      swap_rows_(*output_buffer_[o], *out_data[o], start, active);
+    }
+  }
+
+  // same as swap_step_ for the gradients. the state input gradients of s > 0
+  // are the state output gradients of s - 1; in_grad only receives the
+  // gradient of the initial state.
+  void swap_step_grads_(size_t s,
+                        size_t batch_size,
+                        size_t active,
+                        const std::vector<tensor_t *> &out_grad,
+                        const std::vector<tensor_t *> &in_grad) {
+    const size_t start = s * batch_size;
+    for (size_t i = 0; i < in_grad.size(); i++) {
+      auto state = state_map_i2o_.find(i);
+      if (s > 0 && state != state_map_i2o_.end()) {
+        swap_rows_(*input_grad_buffer_[i], *out_grad[state->second],
+                   start - batch_size, active);
+      } else {
+        swap_rows_(*input_grad_buffer_[i], *in_grad[i], start, active);
       }
     }
+    for (size_t o = 0; o < out_grad.size(); o++) {
+      swap_rows_(*output_grad_buffer_[o], *out_grad[o], start, active);
+    }
+  }
+
+  // lets the cell project the data rows of all the steps at once. with
+  // sequences of different lengths only the active rows are projected,
+  // packed step after step.
+  bool project_inputs_(size_t batch_size,
+                       const std::vector<tensor_t *> &in_data) {
+    if (seq_lengths_.empty()) return cell_->project_inputs(in_data);
+
+    size_t rows = 0;
+    for (size_t s = 0; s < seq_len_; s++) {
+      rows += active_samples_(s, batch_size);
+    }
+    std::vector<tensor_t> packed(in_data.size());
+    std::vector<tensor_t *> packed_data = in_data;
+    auto exchange = [&]() {
+      for (size_t i = 0; i < in_data.size(); i++) {
+        if (in_type_[i] != vector_type::data) continue;
+        packed[i].resize(rows);
+        packed_data[i] = &packed[i];
+        size_t row     = 0;
+        for (size_t s = 0; s < seq_len_; s++) {
+          const size_t active = active_samples_(s, batch_size);
+          for (size_t b = 0; b < active; b++) {
+            packed[i][row++].swap((*in_data[i])[s * batch_size + b]);
+          }
+        }
+      }
+    };
+    exchange();
+    const bool projected = cell_->project_inputs(packed_data);
+    exchange();
+    return projected;
   }
 
-  // Helper function to set internal output buffers to the correct size.
-  inline void reshape_backward_buffers_(
-    const size_t batch_size, const std::vector<tensor_t *> &in_data) {
+  // weights and biases do not change with the length of the sequences
+  inline void bind_parameters_(const std::vector<tensor_t *> &in_data) {
     for (size_t i = 0; i < in_data.size(); i++) {
-      auto &buffer   = *input_buffer_[i];
-      auto in_shape_ = in_shape();
-      // weights and biases do not change with the length of the sequences
       if (in_type_[i] == vector_type::weight ||
           in_type_[i] == vector_type::bias) {
         input_buffer_[i] = in_data[i];
-      } else {
-        buffer.resize(batch_size);
-      }
-      // resize input gradient
-      tensor_t &grad_buffer = *input_grad_buffer_[i];
-      const size_t in_size  = in_shape()[i].size();
-      if (grad_buffer.size() != batch_size) {
-        grad_buffer.resize(batch_size);
-      }
-      for (size_t b = 0; b < batch_size; b++) {
-        grad_buffer[b].resize(in_size);
       }
     }
-    // resize output
-    for (size_t o = 0; o < out_shape().size(); o++) {
-      const size_t out_size = out_shape()[o].size();
-      tensor_t &buffer      = *output_buffer_[o];
-      tensor_t &grad_buffer = *output_grad_buffer_[o];
-      buffer.resize(batch_size);
-      grad_buffer.resize(batch_size);
-      for (size_t b = 0; b < batch_size; b++) {
-        buffer[b].resize(out_size);
-        grad_buffer[b].resize(out_size);
+  }
+
+  // Helper function to set the state to the correct size. the rows of the
+  // step buffers are borrowed from the sequences.
+  inline void reshape_forward_buffers_(const size_t batch_size,
+                                       const std::vector<tensor_t *> &in_data) {
+    bind_parameters_(in_data);
+    auto in_shape_ = in_shape();
+    for (size_t i = 0; i < in_data.size(); i++) {
+      if (in_type_[i] == vector_type::aux) {
+        state_[i].resize(batch_size);
+        for (size_t b = 0; b < batch_size; b++) {
+          state_[i][b].resize(in_shape_[i].size(), 0);
+        }
       }
     }
   }
@@ -431,10 +616,12 @@ class recurrent_layer : public layer {
 
   bool reset_state_ = true;
   // sequence length
-  // TODO(prlz77) std::vector, support variable sequence lengths
   size_t seq_len_;
+  // length of each sequence of the batch, if they differ
+  std::vector<size_t> seq_lengths_;
 
   std::map<size_t, size_t> state_map_o2i_;
+  std::map<size_t, size_t> state_map_i2o_;
   std::vector<bool> state_mask_;
 
   // buffers for state transitions
@@ -443,6 +630,10 @@ class recurrent_layer : public layer {
   std::vector<tensor_t *> input_grad_buffer_;
   std::vector<tensor_t *> output_grad_buffer_;
   std::vector<bool> delete_mask_;
+  // state carried between calls, and the one the last forwarded sequences
+  // started from
+  std::vector<tensor_t> state_;
+  std::vector<tensor_t> initial_state_;
 };
 
 }  // namespace tiny_dnn
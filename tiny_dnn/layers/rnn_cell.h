@@ -63,6 +63,7 @@ class rnn_cell : public cell {
   rnn_cell(rnn_cell &&other)
     : cell(std::move(other)),
       params_(std::move(other.params_)),
+      x_projection_(std::move(other.x_projection_)),
       fwd_ctx_(std::move(other.fwd_ctx_)),
       bwd_ctx_(std::move(other.bwd_ctx_)),
       kernel_fwd_(std::move(other.kernel_fwd_)),
@@ -140,6 +141,23 @@ class rnn_cell : public cell {
 
   inline std::string layer_type() const { return "rnn-cell"; }
 
+  bool project_inputs(const std::vector<tensor_t *> &in_data) override {
+    kernels::cell_project_inputs(
+      cell::wrapper_->parallelize(), *in_data[0], params_.in_size_,
+      (*in_data[2])[0], params_.has_bias_ ? (*in_data[5])[0] : vec_t(),
+      params_.has_bias_, params_.out_size_, x_projection_);
+    return true;
+  }
+
+  void use_projected_inputs(bool use, size_t first_row = 0) override {
+    params_.x_projection_ =
+      use ? &x_projection_[first_row * params_.out_size_] : nullptr;
+  }
+
+  void use_workspace(core::cell_workspace *workspace) override {
+    params_.workspace_ = workspace;
+  }
+
   friend struct serialization_buddy;
 
  protected:
@@ -163,6 +181,9 @@ class rnn_cell : public cell {
   /* The layer parameters */
   core::rnn_cell_params params_;
 
+  /* b + U x of all the rows of a sequence */
+  vec_t x_projection_;
+
   /* forward op context */
   core::OpKernelContext fwd_ctx_;
 
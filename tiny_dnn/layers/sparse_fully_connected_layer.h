@@ -0,0 +1,95 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/core/kernels/sparse_fully_connected_kernel.h"
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/layers/layer.h"
+
+namespace tiny_dnn {
+
+/**
+ * fully-connected layer keeping only its non-zero weights, in CSR format.
+ *
+ * made from a pruned fully_connected_layer, it stores and multiplies only
+ * the remaining weights. the weights are fixed: the layer is inference only.
+ **/
+class sparse_fully_connected_layer : public layer {
+ public:
+  /**
+   * @param W    [in] out_dim x in_dim weights
+   * @param bias [in] out_dim biases, or empty for no bias
+   **/
+  sparse_fully_connected_layer(kernels::csr_matrix W, vec_t bias)
+    : layer({vector_type::data}, {vector_type::data}),
+      W_(std::move(W)),
+      bias_(std::move(bias)) {
+    if (W_.row_ptr.size() != W_.rows + 1 || W_.row_ptr.back() != W_.nnz() ||
+        W_.columns.size() != W_.nnz() ||
+        (!bias_.empty() && bias_.size() != W_.rows)) {
+      throw nn_error("invalid sparse weights for " + layer_type());
+    }
+    for (uint32_t c : W_.columns) {
+      if (c >= W_.cols) {
+        throw nn_error("invalid sparse weights for " + layer_type());
+      }
+    }
+  }
+
+  /**
+   * the non-zero weights of a trained (and pruned) fully-connected layer
+   **/
+  explicit sparse_fully_connected_layer(const fully_connected_layer &l)
+    : sparse_fully_connected_layer(
+        kernels::dense_to_csr(*l.weights()[0], l.fan_in_size(),
+                              l.fan_out_size()),
+        l.weights().size() > 1 ? *l.weights()[1] : vec_t()) {}
+
+  std::string layer_type() const override { return "sparse-fully-connected"; }
+
+  std::vector<shape3d> in_shape() const override {
+    return {shape3d(W_.cols, 1, 1)};
+  }
+
+  std::vector<shape3d> out_shape() const override {
+    return {shape3d(W_.rows, 1, 1)};
+  }
+
+  void forward_propagation(const std::vector<tensor_t *> &in_data,
+                           std::vector<tensor_t *> &out_data) override {
+    kernels::sparse_fully_connected_kernel(W_, bias_, *in_data[0],
+                                           *out_data[0], parallelize());
+  }
+
+  void back_propagation(const std::vector<tensor_t *> &in_data,
+                        const std::vector<tensor_t *> &out_data,
+                        std::vector<tensor_t *> &out_grad,
+                        std::vector<tensor_t *> &in_grad) override {
+    CNN_UNREFERENCED_PARAMETER(in_data);
+    CNN_UNREFERENCED_PARAMETER(out_data);
+    CNN_UNREFERENCED_PARAMETER(out_grad);
+    CNN_UNREFERENCED_PARAMETER(in_grad);
+    throw nn_error(layer_type() + " is inference only");
+  }
+
+  const kernels::csr_matrix &sparse_weights() const { return W_; }
+
+  const vec_t &bias() const { return bias_; }
+
+  friend struct serialization_buddy;
+
+ private:
+  kernels::csr_matrix W_;
+  vec_t bias_;
+};
+
+}  // namespace tiny_dnn
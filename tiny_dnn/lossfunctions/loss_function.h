@@ -7,12 +7,20 @@
 */
 #pragma once
 
+#include <numeric>
 #include <vector>
 
 #include "tiny_dnn/util/util.h"
 
 namespace tiny_dnn {
 
+/**
+ * a loss function E provides the loss E::f(y, t) and its gradient
+ * E::df(y, t) with respect to y. The built-in ones also compute the gradient
+ * in place with E::df(y, t, d), which the minibatch gradient uses when
+ * available.
+ **/
+
 // mean-squared-error loss function for regression
 class mse {
  public:
@@ -26,13 +34,16 @@ class mse {
   }
 
   static vec_t df(const vec_t &y, const vec_t &t) {
-    assert(y.size() == t.size());
     vec_t d(t.size());
+    df(y, t, d);
+    return d;
+  }
+
+  static void df(const vec_t &y, const vec_t &t, vec_t &d) {
+    assert(y.size() == t.size() && d.size() == t.size());
     float_t factor = float_t(2) / static_cast<float_t>(t.size());
 
     for (size_t i = 0; i < y.size(); ++i) d[i] = factor * (y[i] - t[i]);
-
-    return d;
   }
 };
 
@@ -49,8 +60,13 @@ class absolute {
   }
 
   static vec_t df(const vec_t &y, const vec_t &t) {
-    assert(y.size() == t.size());
     vec_t d(t.size());
+    df(y, t, d);
+    return d;
+  }
+
+  static void df(const vec_t &y, const vec_t &t, vec_t &d) {
+    assert(y.size() == t.size() && d.size() == t.size());
     float_t factor = float_t(1) / static_cast<float_t>(t.size());
 
     for (size_t i = 0; i < y.size(); ++i) {
@@ -62,8 +78,6 @@ class absolute {
       else
         d[i] = {0};
     }
-
-    return d;
   }
 };
 
@@ -85,8 +99,13 @@ class absolute_eps {
   }
 
   static vec_t df(const vec_t &y, const vec_t &t) {
-    assert(y.size() == t.size());
     vec_t d(t.size());
+    df(y, t, d);
+    return d;
+  }
+
+  static void df(const vec_t &y, const vec_t &t, vec_t &d) {
+    assert(y.size() == t.size() && d.size() == t.size());
     const float_t factor = float_t(1) / static_cast<float_t>(t.size());
     const float_t eps    = float_t(1) / fraction;
 
@@ -99,7 +118,6 @@ class absolute_eps {
       else
         d[i] = 0.f;
     }
-    return d;
   }
 };
 
@@ -118,13 +136,16 @@ class cross_entropy {
   }
 
   static vec_t df(const vec_t &y, const vec_t &t) {
-    assert(y.size() == t.size());
     vec_t d(t.size());
+    df(y, t, d);
+    return d;
+  }
+
+  static void df(const vec_t &y, const vec_t &t, vec_t &d) {
+    assert(y.size() == t.size() && d.size() == t.size());
 
     for (size_t i = 0; i < y.size(); ++i)
       d[i]        = (y[i] - t[i]) / (y[i] * (float_t(1) - y[i]));
-
-    return d;
   }
 };
 
@@ -141,15 +162,43 @@ class cross_entropy_multiclass {
   }
 
   static vec_t df(const vec_t &y, const vec_t &t) {
-    assert(y.size() == t.size());
     vec_t d(t.size());
+    df(y, t, d);
+    return d;
+  }
 
-    for (size_t i = 0; i < y.size(); ++i) d[i] = -t[i] / y[i];
+  static void df(const vec_t &y, const vec_t &t, vec_t &d) {
+    assert(y.size() == t.size() && d.size() == t.size());
 
-    return d;
+    for (size_t i = 0; i < y.size(); ++i) d[i] = -t[i] / y[i];
   }
 };
 
+namespace detail {
+
+template <typename E>
+auto loss_df(const vec_t &y, const vec_t &t, vec_t &d, int)
+  -> decltype(E::df(y, t, d), void()) {
+  d.resize(t.size());
+  E::df(y, t, d);
+}
+
+template <typename E>
+void loss_df(const vec_t &y, const vec_t &t, vec_t &d, long) {  // NOLINT
+  d = E::df(y, t);
+}
+
+// minibatches whose gradient has fewer elements are computed serially
+const size_t loss_gradient_parallel_size = 1 << 14;
+
+inline bool parallelize_loss_gradient(const std::vector<tensor_t> &y) {
+  size_t elements = 0;
+  for (const auto &channel : y[0]) elements += channel.size();
+  return y.size() > 1 && y.size() * elements >= loss_gradient_parallel_size;
+}
+
+}  // namespace detail
+
 template <typename E>
 vec_t gradient(const vec_t &y, const vec_t &t) {
   assert(y.size() == t.size());
@@ -171,50 +220,101 @@ std::vector<vec_t> gradient(const std::vector<vec_t> &y,
 inline void apply_cost_if_defined(std::vector<vec_t> &sample_gradient,
                                   const std::vector<vec_t> &sample_cost) {
   if (sample_gradient.size() == sample_cost.size()) {
-    // @todo consider adding parallelism
     const size_t channel_count = sample_gradient.size();
     for (size_t channel = 0; channel < channel_count; ++channel) {
-      if (sample_gradient[channel].size() == sample_cost[channel].size()) {
-        const size_t element_count = sample_gradient[channel].size();
-
-        // @todo optimize? (use AVX or so)
-        for (size_t element = 0; element < element_count; ++element) {
-          sample_gradient[channel][element] *= sample_cost[channel][element];
-        }
+      vec_t &gradient   = sample_gradient[channel];
+      const vec_t &cost = sample_cost[channel];
+      if (!gradient.empty() && gradient.size() == cost.size()) {
+        vectorize::mul(&cost[0], cost.size(), &gradient[0]);
       }
     }
   }
 }
 
-// gradient for a minibatch
+/**
+ * gradient for a minibatch, written into gradients. Buffers that already
+ * have the right shape are reused, so calling it again with the same
+ * gradients does not allocate. Samples are processed in parallel.
+ **/
 template <typename E>
-std::vector<tensor_t> gradient(const std::vector<tensor_t> &y,
-                               const std::vector<tensor_t> &t,
-                               const std::vector<tensor_t> &t_cost) {
+void gradient(const std::vector<tensor_t> &y,
+              const std::vector<tensor_t> &t,
+              const std::vector<tensor_t> &t_cost,
+              std::vector<tensor_t> &gradients) {
   const size_t sample_count  = y.size();
   const size_t channel_count = y[0].size();
 
-  std::vector<tensor_t> gradients(sample_count);
-
-  CNN_UNREFERENCED_PARAMETER(channel_count);
   assert(y.size() == t.size());
   assert(t_cost.empty() || t_cost.size() == t.size());
 
-  // @todo add parallelism
-  for (size_t sample = 0; sample < sample_count; ++sample) {
-    assert(y[sample].size() == channel_count);
-    assert(t[sample].size() == channel_count);
-    assert(t_cost.empty() || t_cost[sample].empty() ||
-           t_cost[sample].size() == channel_count);
+  gradients.resize(sample_count);
+  for_i(detail::parallelize_loss_gradient(y), sample_count,
+        [&](size_t sample) {
+          assert(y[sample].size() == channel_count);
+          assert(t[sample].size() == channel_count);
+          assert(t_cost.empty() || t_cost[sample].empty() ||
+                 t_cost[sample].size() == channel_count);
+
+          tensor_t &grad = gradients[sample];
+          grad.resize(channel_count);
+          for (size_t channel = 0; channel < channel_count; ++channel) {
+            detail::loss_df<E>(y[sample][channel], t[sample][channel],
+                               grad[channel], 0);
+          }
+
+          if (sample < t_cost.size()) {
+            apply_cost_if_defined(grad, t_cost[sample]);
+          }
+        },
+        1u);
+}
 
-    gradients[sample] = gradient<E>(y[sample], t[sample]);
+template <typename E>
+std::vector<tensor_t> gradient(const std::vector<tensor_t> &y,
+                               const std::vector<tensor_t> &t,
+                               const std::vector<tensor_t> &t_cost) {
+  std::vector<tensor_t> gradients;
+  gradient<E>(y, t, t_cost, gradients);
+  return gradients;
+}
 
-    if (sample < t_cost.size()) {
-      apply_cost_if_defined(gradients[sample], t_cost[sample]);
-    }
-  }
+/**
+ * gradient of cross_entropy_multiclass with respect to the input x of the
+ * softmax y = softmax(x) that produced y:
+ *
+ *   dE/dx = y * sum(t) - t
+ *
+ * which is (y - t) for one-hot targets. It replaces cross_entropy_multiclass
+ * ::df followed by the product with the softmax Jacobian, and avoids the
+ * division by y. Per-element costs scale the targets.
+ **/
+inline void softmax_cross_entropy_gradient(const std::vector<tensor_t> &y,
+                                           const std::vector<tensor_t> &t,
+                                           const std::vector<tensor_t> &t_cost,
+                                           std::vector<tensor_t> &gradients) {
+  assert(y.size() == t.size());
+  assert(t_cost.empty() || t_cost.size() == t.size());
 
-  return gradients;
+  gradients.resize(y.size());
+  for_i(detail::parallelize_loss_gradient(y), y.size(),
+        [&](size_t sample) {
+          gradients[sample].resize(y[sample].size());
+          for (size_t channel = 0; channel < y[sample].size(); ++channel) {
+            const vec_t &y_ = y[sample][channel];
+            const vec_t &t_ = t[sample][channel];
+            assert(y_.size() == t_.size());
+
+            vec_t &d = gradients[sample][channel];
+            d.assign(t_.begin(), t_.end());
+            if (sample < t_cost.size() && channel < t_cost[sample].size() &&
+                !d.empty() && t_cost[sample][channel].size() == d.size()) {
+              vectorize::mul(&t_cost[sample][channel][0], d.size(), &d[0]);
+            }
+            const float_t sum = std::accumulate(d.begin(), d.end(), float_t{0});
+            for (size_t i = 0; i < d.size(); ++i) d[i] = y_[i] * sum - d[i];
+          }
+        },
+        1u);
 }
 
 }  // namespace tiny_dnn
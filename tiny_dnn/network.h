@@ -20,6 +20,7 @@
 #include <set>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -177,8 +178,18 @@ class network {
   void bprop(const std::vector<tensor_t> &out,
              const std::vector<tensor_t> &t,
              const std::vector<tensor_t> &t_cost) {
-    std::vector<tensor_t> delta = gradient<E>(out, t, t_cost);
-    net_.backward(delta);
+    // a softmax output trained with cross_entropy_multiclass gets the
+    // gradient of its input directly, skipping the Jacobian product
+    softmax_layer *softmax = output_softmax();
+    if (softmax && std::is_same<E, cross_entropy_multiclass>::value &&
+        !out.empty() && out[0].size() == 1) {
+      softmax_cross_entropy_gradient(out, t, t_cost, delta_);
+      softmax_layer::fused_loss_gradient_scope fused(*softmax);
+      net_.backward(delta_);
+      return;
+    }
+    gradient<E>(out, t, t_cost, delta_);
+    net_.backward(delta_);
   }
 
   vec_t fprop(const vec_t &in) {
@@ -206,11 +217,7 @@ class network {
   /**
    * update weights and clear all gradients
    * */
-  void update_weights(optimizer *opt) {
-    for (auto l : net_) {
-      l->update_weight(opt);
-    }
-  }
+  void update_weights(optimizer *opt) { net_.update_weights(opt); }
 
   /**
    * executes forward-propagation and returns output
@@ -441,6 +448,27 @@ class network {
     }
   }
 
+  /**
+   * fuse elementwise activations into the preceding conv/deconv/fc layers,
+   * see nodes::fuse_activations(). Layer indices shift accordingly.
+   */
+  void fuse_activations() { net_.fuse_activations(); }
+
+  /**
+   * fold batch normalization into the preceding conv/deconv/fc layers, see
+   * nodes::fold_batch_normalization(). Layer indices shift accordingly.
+   */
+  void fold_batch_normalization() { net_.fold_batch_normalization(); }
+
+  /**
+   * remove the weakest output channels of the convolutional layers and
+   * shrink the layers that follow them, see nodes::prune_channels().
+   * @return number of removed channels
+   */
+  size_t prune_channels(float_t fraction) {
+    return net_.prune_channels(fraction);
+  }
+
   /**
    * request to finish an ongoing training
    *
@@ -566,7 +594,7 @@ class network {
             vec_t &w     = *weights[i];
             tensor_t &dw = *grads[i];
             for (size_t j = 0; j < w.size(); j++) {
-              if (!calc_delta<E>(in, v, w, dw, j, eps)) {
+              if (!calc_delta<E>(in, v, *current, w, dw, j, eps)) {
                 return false;
               }
             }
@@ -577,7 +605,8 @@ class network {
             vec_t &w     = *weights[i];
             tensor_t &dw = *grads[i];
             for (size_t j = 0; j < 10; j++) {
-              if (!calc_delta<E>(in, v, w, dw, uniform_idx(w), eps)) {
+              if (!calc_delta<E>(in, v, *current, w, dw, uniform_idx(w),
+                                 eps)) {
                 return false;
               }
             }
@@ -934,6 +963,7 @@ class network {
   template <typename E>
   bool calc_delta(const std::vector<tensor_t> &in,
                   const std::vector<tensor_t> &v,
+                  layer &owner,
                   vec_t &w,
                   tensor_t &dw,
                   size_t check_index,
@@ -961,18 +991,21 @@ class network {
 
     float_t f_p    = float_t(0);
     w[check_index] = prev_w + delta;
+    owner.post_update();
     for (size_t i = 0; i < sample_count; i++) {
       f_p += get_loss<E>(in[i], v[i]);
     }
 
     float_t f_m    = float_t(0);
     w[check_index] = prev_w - delta;
+    owner.post_update();
     for (size_t i = 0; i < sample_count; i++) {
       f_m += get_loss<E>(in[i], v[i]);
     }
 
     float_t delta_by_numerical = (f_p - f_m) / (float_t(2) * delta);
     w[check_index]             = prev_w;
+    owner.post_update();
 
     // calculate dw/dE by bprop
     bprop<E>(fprop(in), v, std::vector<tensor_t>());
@@ -986,6 +1019,15 @@ class network {
     return std::abs(delta_by_bprop - delta_by_numerical) <= eps;
   }
 
+  // the softmax producing the only output of the network, if any
+  softmax_layer *output_softmax() {
+    const std::vector<layer *> outputs = net_.output_layers();
+    if (outputs.size() != 1 || outputs[0]->out_channels() != 1) {
+      return nullptr;
+    }
+    return dynamic_cast<softmax_layer *>(outputs[0]);
+  }
+
   void check_t(size_t i, label_t t, size_t dim_out) {
     if (t >= dim_out) {
       std::ostringstream os;
@@ -1102,6 +1144,8 @@ class network {
   bool stop_training_;
   std::vector<tensor_t> in_batch_;
   std::vector<tensor_t> t_batch_;
+  // output gradients, reused by every bprop
+  std::vector<tensor_t> delta_;
 };
 
 /**
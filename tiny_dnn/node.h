@@ -87,11 +87,16 @@ class edge {
       prev_(prev) {}
 
   void merge_grads(vec_t *dst) {
+    assert(!grad_.empty());
+    dst->resize(grad_[0].size());
+    merge_grads(&(*dst)[0]);
+  }
+
+  // dst must hold grad_[0].size() elements
+  void merge_grads(float_t *pdst) {
     assert(!grad_.empty());
     const auto &grad_head = grad_[0];
     size_t sz             = grad_head.size();
-    dst->resize(sz);
-    float_t *pdst = &(*dst)[0];
     // dst = grad_[0]
     std::copy(grad_head.begin(), grad_head.end(), pdst);
     // @todo consider adding parallelism
@@ -125,6 +130,7 @@ class edge {
   const shape3d &shape() const { return shape_; }
   vector_type vtype() const { return vtype_; }
   void add_next_node(node *next) { next_.push_back(next); }
+  void set_prev(node *prev) { prev_ = prev; }
 
  private:
   shape3d shape_;
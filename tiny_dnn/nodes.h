@@ -7,7 +7,10 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
+#include <string>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -18,6 +21,9 @@
 #include <cereal/types/utility.hpp>
 #endif
 
+#include "tiny_dnn/activations/activation_layer.h"
+#include "tiny_dnn/activations/softmax_layer.h"
+#include "tiny_dnn/layers/batch_normalization_layer.h"
 #include "tiny_dnn/layers/layer.h"
 #include "tiny_dnn/optimizers/optimizer.h"
 #include "tiny_dnn/util/util.h"
@@ -101,8 +107,17 @@ class nodes {
    * update weights and clear all gradients
    **/
   virtual void update_weights(optimizer *opt) {
+    // gather every trainable weight, so that the optimizer merges the
+    // per-sample gradients and updates the whole model in one fused sweep
+    weights_.clear();
+    weights_grads_.clear();
     for (auto l : nodes_) {
-      l->update_weight(opt);
+      l->collect_weights(weights_, weights_grads_);
+    }
+    if (!weights_.empty()) opt->update_all(weights_grads_, weights_);
+    for (auto l : nodes_) {
+      l->clear_grads();
+      l->post_update();
     }
   }
 
@@ -121,6 +136,141 @@ class nodes {
     }
   }
 
+  /**
+   * fuse elementwise activations into the convolutional, deconvolutional and
+   * fully-connected layers feeding them.
+   *
+   * the activation is then computed in place on the output of the preceding
+   * layer instead of through a separate edge, and its node is removed from
+   * this container (so layer indices shift). Only activations whose gradient
+   * can be computed from their output are fused, so the network can still be
+   * trained afterwards.
+   **/
+  void fuse_activations() {
+    std::vector<layer *> fused;
+    for (auto l : nodes_) {
+      const std::string type = l->layer_type();
+      if (type != "conv" && type != "deconv" && type != "fully-connected") {
+        continue;
+      }
+      if (l->fused_activation() || is_output_layer(l)) continue;
+
+      auto next = l->next_nodes();
+      if (next.size() != 1) continue;
+      auto act = dynamic_cast<activation_layer *>(next[0]);
+      if (!act || !act->backward_uses_output_only()) continue;
+
+      l->fuse_activation(act);
+      replace_layer(act, l);
+      fused.push_back(act);
+    }
+    remove_layers(fused);
+  }
+
+  /**
+   * fold test-phase batch normalization into the convolutional,
+   * deconvolutional or fully-connected layer feeding it.
+   *
+   * y = (x - mean) / sqrt(variance + eps) is a per-channel affine transform
+   * of the previous layer's output, so it is merged into that layer's weights
+   * and bias (a bias is added if the layer has none) using the moving
+   * averages of the normalization layer. The normalization node is removed
+   * from this container (so layer indices shift). This is meant for
+   * inference; the network can't learn the normalization afterwards.
+   **/
+  void fold_batch_normalization() {
+    std::vector<layer *> folded;
+    for (auto l : nodes_) {
+      auto bn = dynamic_cast<batch_normalization_layer *>(l);
+      if (!bn) continue;
+
+      auto prev = bn->prev_nodes();
+      if (prev.size() != 1) continue;
+      auto producer = dynamic_cast<layer *>(prev[0]);
+      if (!producer || producer->fused_activation() ||
+          producer->next_nodes().size() != 1 || is_output_layer(producer)) {
+        continue;
+      }
+
+      const vec_t &mean     = bn->mean();
+      const vec_t &variance = bn->variance();
+      vec_t scale(mean.size()), shift(mean.size());
+      for (size_t c = 0; c < mean.size(); c++) {
+        scale[c] = float_t(1) / std::sqrt(variance[c] + bn->epsilon());
+        shift[c] = -mean[c] * scale[c];
+      }
+      if (!producer->fold_channel_affine(scale, shift)) continue;
+
+      producer->take_output_of(bn);
+      replace_layer(bn, producer);
+      folded.push_back(bn);
+    }
+    remove_layers(folded);
+  }
+
+  /**
+   * structured pruning: remove the fraction @a fraction of the output
+   * channels of each convolutional layer, those whose filters have the
+   * smallest L2 norm, with their weights.
+   *
+   * the layers between the pruned layer and the next convolutional or
+   * fully-connected layer (activations, pooling, batch normalization) and
+   * the input weights of that layer are shrunk accordingly, so the network
+   * is genuinely smaller and faster. a layer is left as it is when its
+   * output feeds several layers, a layer that mixes channels (e.g. softmax,
+   * concat) or the network output. the optimizer state of each shrunk
+   * weight starts over at the next update.
+   *
+   * @return number of removed channels
+   **/
+  size_t prune_channels(float_t fraction) {
+    if (!(fraction >= 0 && fraction < 1)) {
+      throw nn_error("fraction must be in [0, 1)");
+    }
+    size_t removed = 0;
+    for (auto l : nodes_) {
+      const vec_t norms = l->output_channel_norms();
+      const size_t n    = static_cast<size_t>(fraction * norms.size());
+      if (n == 0) continue;
+
+      // layers following the removed channels, up to the one consuming them
+      std::vector<layer *> chain;
+      for (layer *cur = l;;) {
+        auto next = cur->next_nodes();
+        if (cur->fused_activation() || is_output_layer(cur) ||
+            next.size() != 1) {
+          chain.clear();
+          break;
+        }
+        layer *consumer = dynamic_cast<layer *>(next[0]);
+        const channel_pruning how =
+          consumer->prev_nodes().size() == 1
+            ? consumer->input_channel_pruning()
+            : channel_pruning::none;
+        if (how == channel_pruning::none) {
+          chain.clear();
+          break;
+        }
+        chain.push_back(consumer);
+        if (how == channel_pruning::consumes) break;
+        cur = consumer;
+      }
+      if (chain.empty()) continue;
+
+      std::vector<size_t> kept(norms.size());
+      for (size_t c = 0; c < kept.size(); c++) kept[c] = c;
+      std::nth_element(kept.begin(), kept.begin() + n, kept.end(),
+                       [&](size_t a, size_t b) { return norms[a] < norms[b]; });
+      kept.erase(kept.begin(), kept.begin() + n);
+      std::sort(kept.begin(), kept.end());
+
+      l->prune_output_channels(kept);
+      for (auto c : chain) c->prune_input_channels(kept, norms.size());
+      removed += n;
+    }
+    return removed;
+  }
+
   size_t size() const { return nodes_.size(); }
   iterator begin() { return nodes_.begin(); }
   iterator end() { return nodes_.end(); }
@@ -131,6 +281,14 @@ class nodes {
   size_t in_data_size() const { return nodes_.front()->in_data_size(); }
   size_t out_data_size() const { return nodes_.back()->out_data_size(); }
 
+  /**
+   * the layers whose outputs are the outputs of the network
+   **/
+  virtual std::vector<layer *> output_layers() const {
+    if (nodes_.empty()) return {};
+    return {nodes_.back()};
+  }
+
   template <typename T>
   const T &at(size_t index) const {
     const T *v = dynamic_cast<const T *>(nodes_[index]);
@@ -249,6 +407,33 @@ class nodes {
     }
   }
 
+  /**
+   * true if the output of @a l is an output of the network
+   **/
+  virtual bool is_output_layer(const layer *l) const {
+    return l == nodes_.back();
+  }
+
+  /**
+   * let @a to take the place of @a from as input/output of the network
+   **/
+  virtual void replace_layer(layer *from, layer *to) {
+    CNN_UNREFERENCED_PARAMETER(from);
+    CNN_UNREFERENCED_PARAMETER(to);
+  }
+
+  // drop layers which were merged into other layers. Owned layers are kept
+  // alive since the layers they were merged into still refer to them.
+  void remove_layers(const std::vector<layer *> &removed) {
+    nodes_.erase(std::remove_if(nodes_.begin(), nodes_.end(),
+                                [&](layer *l) {
+                                  return std::find(removed.begin(),
+                                                   removed.end(),
+                                                   l) != removed.end();
+                                }),
+                 nodes_.end());
+  }
+
   template <typename T>
   void push_back_impl(T &&node, std::true_type) {  // is_rvalue_reference
     own_nodes_.push_back(
@@ -266,6 +451,9 @@ class nodes {
   std::vector<std::shared_ptr<layer>> own_nodes_;
   /* List of all nodes which includes own_nodes */
   std::vector<layer *> nodes_;
+  /* Trainable weights and their gradients, reused by update_weights */
+  std::vector<vec_t *> weights_;
+  std::vector<const tensor_t *> weights_grads_;
 };
 
 /**
@@ -450,6 +638,10 @@ class graph : public nodes {
     setup(false);
   }
 
+  std::vector<layer *> output_layers() const override {
+    return output_layers_;
+  }
+
  private:
   friend class nodes;
 
@@ -568,6 +760,16 @@ class graph : public nodes {
     return merged;
   }
 
+  bool is_output_layer(const layer *l) const override {
+    return std::find(output_layers_.begin(), output_layers_.end(), l) !=
+           output_layers_.end();
+  }
+
+  void replace_layer(layer *from, layer *to) override {
+    std::replace(input_layers_.begin(), input_layers_.end(), from, to);
+    std::replace(output_layers_.begin(), output_layers_.end(), from, to);
+  }
+
   size_t find_index(const std::vector<node *> &nodes, layer *target) {
     for (size_t i = 0; i < nodes.size(); i++) {
       if (nodes[i] == static_cast<node *>(&*target)) return i;
@@ -581,6 +783,11 @@ class graph : public nodes {
 template <typename OutputArchive>
 void nodes::save_model(OutputArchive &oa) const {
 #ifndef CNN_NO_SERIALIZATION
+  for (auto n : nodes_) {
+    if (n->fused_activation()) {
+      throw nn_error("cannot save the model of a network with fused layers");
+    }
+  }
   oa(cereal::make_nvp("nodes", nodes_));
 
   if (typeid(*this) == typeid(sequential)) {
@@ -9,6 +9,8 @@
 
 #include <algorithm>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "tiny_dnn/util/util.h"
 
@@ -27,24 +29,220 @@ struct optimizer {
   optimizer &operator=(optimizer &&) = default;
   virtual ~optimizer()               = default;
   virtual void update(const vec_t &dW, vec_t &W, bool parallelize) = 0;
+
+  /**
+   * update all the parameters of a model in one step
+   *
+   * @param dW gradients of every parameter, back to back in the order of W
+   * @param W  parameters to update
+   *
+   * the built-in optimizers sweep the whole range in one multithreaded pass.
+   * this default falls back to update() for each parameter.
+   **/
+  virtual void update_all(const vec_t &dW, const std::vector<vec_t *> &W) {
+    vec_t g;
+    size_t pos = 0;
+    for (auto w : W) {
+      g.assign(dW.begin() + pos, dW.begin() + pos + w->size());
+      pos += w->size();
+      if (g.empty()) continue;
+      clip_gradient(&g[0], g.size());
+      update(g, *w, w->size() >= 512);
+    }
+  }
+
+  /**
+   * update all the parameters of a model from their per-sample gradients
+   *
+   * @param dW per-sample gradients of each parameter, which are summed and
+   *           divided by the number of samples
+   * @param W  parameters to update
+   **/
+  virtual void update_all(const std::vector<const tensor_t *> &dW,
+                          const std::vector<vec_t *> &W) {
+    vec_t g;
+    for (size_t s = 0; s < W.size(); s++) {
+      if (W[s]->empty()) continue;
+      const float_t scale = float_t(1) / float_t(dW[s]->size());
+      g.assign(W[s]->size(), float_t{0});
+      for (const auto &sample : *dW[s]) {
+        vectorize::muladd(&sample[0], scale, g.size(), &g[0]);
+      }
+      clip_gradient(&g[0], g.size());
+      update(g, *W[s], W[s]->size() >= 512);
+    }
+  }
+
   virtual void reset() {}  // override to implement pre-learning action
+
+  // update_all() clips each gradient to [-grad_clip, grad_clip], 0 disables
+  float_t grad_clip = float_t(0);
+
+ protected:
+  void clip_gradient(float_t *g, size_t n) const {
+    if (grad_clip <= float_t(0)) return;
+    for (size_t i = 0; i < n; i++) {
+      g[i] = std::max(-grad_clip, std::min(grad_clip, g[i]));
+    }
+  }
+};
+
+/**
+ * base class of the optimizers which update each element independently.
+ * the update rule is given by update_range() on a contiguous run of
+ * elements, so that update_all() can split the parameters of the whole model
+ * into even blocks regardless of where one parameter ends and the next begins.
+ **/
+struct elementwise_optimizer : public optimizer {
+  void update(const vec_t &dW, vec_t &W, bool parallelize) override {
+    const size_t offset = state_offset(W);
+    for_(parallelize, 0u, W.size(), [&](const blocked_range &r) {
+      update_range(&dW[r.begin()], &W[r.begin()], offset + r.begin(),
+                   r.end() - r.begin());
+    });
+    end_step();
+  }
+
+  void update_all(const vec_t &dW, const std::vector<vec_t *> &W) override {
+    sweep(W, [&](size_t s, size_t local, size_t n, float_t *g) {
+      const float_t *src = &dW[positions_[s] + local];
+      std::copy(src, src + n, g);
+    });
+  }
+
+  void update_all(const std::vector<const tensor_t *> &dW,
+                  const std::vector<vec_t *> &W) override {
+    sweep(W, [&](size_t s, size_t local, size_t n, float_t *g) {
+      const tensor_t &grads = *dW[s];
+      const float_t scale   = float_t(1) / float_t(grads.size());
+      vectorize::fill(g, n, float_t{0});
+      for (const auto &sample : grads) {
+        vectorize::muladd(&sample[local], scale, n, g);
+      }
+    });
+  }
+
+  void reset() override { layout_.clear(); }
+
+ protected:
+  /**
+   * update n elements of a parameter
+   * @param offset position of W[0] in the optimizer state, see state_offset()
+   **/
+  virtual void update_range(const float_t *dW,
+                            float_t *W,
+                            size_t offset,
+                            size_t n) = 0;
+
+  // position of the state of W in the flat state buffers
+  virtual size_t state_offset(const vec_t &W) {
+    CNN_UNREFERENCED_PARAMETER(W);
+    return 0;
+  }
+
+  // called once per update() or update_all()
+  virtual void end_step() {}
+
+ private:
+  static constexpr size_t tile_size = 256;
+
+  /**
+   * split the parameters into even blocks, one per thread. each block is
+   * walked in tiles small enough to stay in L1: gradient(s, local, n, g)
+   * writes the gradient of W[s][local, local + n) to g, which is clipped
+   * and handed to update_range() right away.
+   **/
+  template <typename Gradient>
+  void sweep(const std::vector<vec_t *> &W, Gradient gradient) {
+    if (!same_layout(W)) bind_layout(W);
+    const size_t total = positions_.back();
+
+    for_(total >= 512, 0u, total, [&](const blocked_range &r) {
+      alignas(32) float_t g[tile_size];
+      size_t s = std::upper_bound(positions_.begin(), positions_.end(),
+                                  r.begin()) -
+                 positions_.begin() - 1;
+      for (size_t i = r.begin(); i < r.end();) {
+        while (positions_[s + 1] <= i) s++;  // skip empty parameters
+        const size_t end =
+          std::min(std::min(r.end(), positions_[s + 1]), i + tile_size);
+        const size_t local = i - positions_[s];
+        gradient(s, local, end - i, g);
+        clip_gradient(g, end - i);
+        update_range(g, &(*W[s])[local], offsets_[s] + local, end - i);
+        i = end;
+      }
+    });
+    end_step();
+  }
+
+  bool same_layout(const std::vector<vec_t *> &W) const {
+    if (W.size() != layout_.size()) return false;
+    for (size_t s = 0; s < W.size(); s++) {
+      if (W[s] != layout_[s] ||
+          W[s]->size() != positions_[s + 1] - positions_[s]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void bind_layout(const std::vector<vec_t *> &W) {
+    layout_.assign(W.begin(), W.end());
+    positions_.assign(1, 0);
+    offsets_.clear();
+    for (auto w : W) {
+      positions_.push_back(positions_.back() + w->size());
+      offsets_.push_back(state_offset(*w));
+    }
+  }
+
+  // parameters of the last update_all(), their positions in dW and in the
+  // optimizer state
+  std::vector<const vec_t *> layout_;
+  std::vector<size_t> positions_;
+  std::vector<size_t> offsets_;
 };
 
-// helper class to hold N values for each weight
+/**
+ * helper class to hold N values for each weight.
+ * the values of all the weights are kept back to back in N flat buffers,
+ * allocated the first time a weight is updated.
+ **/
 template <int N>
-struct stateful_optimizer : public optimizer {
+struct stateful_optimizer : public elementwise_optimizer {
   void reset() override {
+    elementwise_optimizer::reset();
     for (auto &e : E_) e.clear();
+    offset_of_.clear();
   }
 
  protected:
   template <int Index>
-  vec_t &get(const vec_t &key) {
+  float_t *get(size_t offset) {
     static_assert(Index < N, "index out of range");
-    if (E_[Index][&key].empty()) E_[Index][&key].resize(key.size(), float_t());
-    return E_[Index][&key];
+    return &E_[Index][offset];
+  }
+
+  // a weight resized since its last update, e.g. by pruning, gets a new
+  // zeroed state
+  size_t state_offset(const vec_t &W) override {
+    auto it = offset_of_.find(&W);
+    if (it != offset_of_.end() && it->second.second == W.size()) {
+      return it->second.first;
+    }
+
+    const size_t offset = E_[0].size();
+    for (auto &e : E_) e.resize(offset + W.size(), float_t());
+    offset_of_[&W] = std::make_pair(offset, W.size());
+    return offset;
   }
-  std::unordered_map<const vec_t *, vec_t> E_[N];
+
+  vec_t E_[N];
+
+ private:
+  // offset and size of the state of each weight
+  std::unordered_map<const vec_t *, std::pair<size_t, size_t>> offset_of_;
 };
 
 /**
@@ -57,15 +255,20 @@ struct stateful_optimizer : public optimizer {
 struct adagrad : public stateful_optimizer<1> {
   adagrad() : alpha(float_t(0.01)), eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &g = get<0>(W);
-    for_i(parallelize, W.size(), [&](size_t i) {
+  float_t alpha;  // learning rate
+
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    float_t *g = get<0>(offset);
+    for (size_t i = 0; i < n; i++) {
       g[i] += dW[i] * dW[i];
       W[i] -= alpha * dW[i] / (std::sqrt(g[i]) + eps);
-    });
+    }
   }
 
-  float_t alpha;  // learning rate
  private:
   float_t eps;
 };
@@ -79,17 +282,21 @@ struct adagrad : public stateful_optimizer<1> {
 struct RMSprop : public stateful_optimizer<1> {
   RMSprop() : alpha(float_t(0.0001)), mu(float_t(0.99)), eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &g = get<0>(W);
+  float_t alpha;  // learning rate
+  float_t mu;     // decay term
 
-    for_i(parallelize, W.size(), [&](size_t i) {
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    float_t *g = get<0>(offset);
+    for (size_t i = 0; i < n; i++) {
       g[i] = mu * g[i] + (1 - mu) * dW[i] * dW[i];
       W[i] -= alpha * dW[i] / std::sqrt(g[i] + eps);
-    });
+    }
   }
 
-  float_t alpha;  // learning rate
-  float_t mu;     // decay term
  private:
   float_t eps;  // constant value to avoid zero-division
 };
@@ -109,29 +316,35 @@ struct adam : public stateful_optimizer<2> {
       b2_t(float_t(0.999)),
       eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &mt = get<0>(W);
-    vec_t &vt = get<1>(W);
+  float_t alpha;  // learning rate
+  float_t b1;     // decay term
+  float_t b2;     // decay term
+  float_t b1_t;   // decay term power t
+  float_t b2_t;   // decay term power t
 
-    for_i(parallelize, W.size(), [&](size_t i) {
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    float_t *mt = get<0>(offset);
+    float_t *vt = get<1>(offset);
+
+    for (size_t i = 0; i < n; i++) {
       mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
       vt[i] = b2 * vt[i] + (float_t(1) - b2) * dW[i] * dW[i];
 
       // L2 norm based update rule
       W[i] -= alpha * (mt[i] / (float_t(1) - b1_t)) /
               std::sqrt((vt[i] / (float_t(1) - b2_t)) + eps);
-    });
+    }
+  }
 
+  void end_step() override {
     b1_t *= b1;
     b2_t *= b2;
   }
 
-  float_t alpha;  // learning rate
-  float_t b1;     // decay term
-  float_t b2;     // decay term
-  float_t b1_t;   // decay term power t
-  float_t b2_t;   // decay term power t
-
  private:
   float_t eps;  // constant value to avoid zero-division
 };
@@ -150,25 +363,29 @@ struct adamax : public stateful_optimizer<2> {
       b1_t(b1),
       eps(float_t(1e-8)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &mt = get<0>(W);
-    vec_t &ut = get<1>(W);
+  float_t alpha;  // learning rate
+  float_t b1;     // decay term
+  float_t b2;     // decay term
+  float_t b1_t;   // decay term power t
 
-    for_i(parallelize, W.size(), [&](int i) {
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    float_t *mt = get<0>(offset);
+    float_t *ut = get<1>(offset);
+
+    for (size_t i = 0; i < n; i++) {
       mt[i] = b1 * mt[i] + (float_t(1) - b1) * dW[i];
       ut[i] = std::max(b2 * ut[i], std::abs(dW[i]));
 
       // Lp norm based update rule
       W[i] -= (alpha / (1.0 - b1_t)) * (mt[i] / (ut[i] + eps));
-    });
-
-    b1_t *= b1;
+    }
   }
 
-  float_t alpha;  // learning rate
-  float_t b1;     // decay term
-  float_t b2;     // decay term
-  float_t b1_t;   // decay term power t
+  void end_step() override { b1_t *= b1; }
 
  private:
   float_t eps;  // constant value to avoid zero-division
@@ -179,16 +396,22 @@ struct adamax : public stateful_optimizer<2> {
  *
  * slightly faster than tiny_dnn::momentum
  **/
-struct gradient_descent : public optimizer {
+struct gradient_descent : public elementwise_optimizer {
   gradient_descent() : alpha(float_t(0.01)), lambda(float_t(0)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    for_i(parallelize, W.size(),
-          [&](size_t i) { W[i] = W[i] - alpha * (dW[i] + lambda * W[i]); });
-  }
-
   float_t alpha;   // learning rate
   float_t lambda;  // weight decay
+
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    CNN_UNREFERENCED_PARAMETER(offset);
+    for (size_t i = 0; i < n; i++) {
+      W[i] = W[i] - alpha * (dW[i] + lambda * W[i]);
+    }
+  }
 };
 
 /**
@@ -202,19 +425,23 @@ struct momentum : public stateful_optimizer<1> {
  public:
   momentum() : alpha(float_t(0.01)), lambda(float_t(0)), mu(float_t(0.9)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &dWprev = get<0>(W);
+  float_t alpha;   // learning rate
+  float_t lambda;  // weight decay
+  float_t mu;      // momentum
+
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    float_t *dWprev = get<0>(offset);
 
-    for_i(parallelize, W.size(), [&](size_t i) {
+    for (size_t i = 0; i < n; i++) {
       float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
       W[i] += V;
       dWprev[i] = V;
-    });
+    }
   }
-
-  float_t alpha;   // learning rate
-  float_t lambda;  // weight decay
-  float_t mu;      // momentum
 };
 
 /**
@@ -229,19 +456,23 @@ struct nesterov_momentum : public stateful_optimizer<1> {
   nesterov_momentum()
     : alpha(float_t(0.01)), lambda(float_t(0)), mu(float_t(0.9)) {}
 
-  void update(const vec_t &dW, vec_t &W, bool parallelize) {
-    vec_t &dWprev = get<0>(W);
+  float_t alpha;   // learning rate
+  float_t lambda;  // weight decay
+  float_t mu;      // momentum
 
-    for_i(parallelize, W.size(), [&](size_t i) {
+ protected:
+  void update_range(const float_t *dW,
+                    float_t *W,
+                    size_t offset,
+                    size_t n) override {
+    float_t *dWprev = get<0>(offset);
+
+    for (size_t i = 0; i < n; i++) {
       float_t V = mu * dWprev[i] - alpha * (dW[i] + W[i] * lambda);
       W[i] += (-mu) * dWprev[i] + (1 + mu) * V;
       dWprev[i] = V;
-    });
+    }
   }
-
-  float_t alpha;   // learning rate
-  float_t lambda;  // weight decay
-  float_t mu;      // momentum
 };
 
 }  // namespace tiny_dnn
@@ -36,9 +36,13 @@
 #include "tiny_dnn/layers/concat_layer.h"
 #include "tiny_dnn/layers/convolutional_layer.h"
 #include "tiny_dnn/layers/deconvolutional_layer.h"
+#include "tiny_dnn/layers/dequantize_layer.h"
 #include "tiny_dnn/layers/dropout_layer.h"
+#include "tiny_dnn/layers/fake_quantize_layer.h"
 #include "tiny_dnn/layers/fully_connected_layer.h"
 #include "tiny_dnn/layers/global_average_pooling_layer.h"
+#include "tiny_dnn/layers/half_convolutional_layer.h"
+#include "tiny_dnn/layers/half_fully_connected_layer.h"
 #include "tiny_dnn/layers/input_layer.h"
 #include "tiny_dnn/layers/l2_normalization_layer.h"
 #include "tiny_dnn/layers/lrn_layer.h"
@@ -46,16 +50,16 @@
 #include "tiny_dnn/layers/max_pooling_layer.h"
 #include "tiny_dnn/layers/max_unpooling_layer.h"
 #include "tiny_dnn/layers/power_layer.h"
+#include "tiny_dnn/layers/quantized_average_pooling_layer.h"
 #include "tiny_dnn/layers/quantized_convolutional_layer.h"
 #include "tiny_dnn/layers/quantized_deconvolutional_layer.h"
+#include "tiny_dnn/layers/quantized_fully_connected_layer.h"
+#include "tiny_dnn/layers/quantized_relu_layer.h"
 #include "tiny_dnn/layers/recurrent_layer.h"
 #include "tiny_dnn/layers/slice_layer.h"
+#include "tiny_dnn/layers/sparse_fully_connected_layer.h"
 #include "tiny_dnn/layers/zero_pad_layer.h"
 
-#ifdef CNN_USE_GEMMLOWP
-#include "tiny_dnn/layers/quantized_fully_connected_layer.h"
-#endif  // CNN_USE_GEMMLOWP
-
 #include "tiny_dnn/lossfunctions/loss_function.h"
 #include "tiny_dnn/optimizers/optimizer.h"
 
@@ -87,6 +91,11 @@ CEREAL_REGISTER_TYPE(tiny_dnn::softplus_layer)
 CEREAL_REGISTER_TYPE(tiny_dnn::softsign_layer)
 CEREAL_REGISTER_TYPE(tiny_dnn::tanh_layer)
 CEREAL_REGISTER_TYPE(tiny_dnn::tanh_p1m2_layer)
+
+#include "tiny_dnn/util/calibration.h"
+#include "tiny_dnn/util/half_precision.h"
+#include "tiny_dnn/util/low_rank_factorization.h"
+#include "tiny_dnn/util/pruning.h"
 #endif  // CNN_NO_SERIALIZATION
 
 // shortcut version of layer names
@@ -109,9 +118,7 @@ using zero_pad = tiny_dnn::zero_pad_layer;
 
 // using rnn_cell = tiny_dnn::rnn_cell_layer;
 
-#ifdef CNN_USE_GEMMLOWP
 using q_fc = tiny_dnn::quantized_fully_connected_layer;
-#endif
 
 using add = tiny_dnn::elementwise_add_layer;
 
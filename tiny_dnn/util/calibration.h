@@ -0,0 +1,415 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/activations/relu_layer.h"
+#include "tiny_dnn/layers/average_pooling_layer.h"
+#include "tiny_dnn/layers/convolutional_layer.h"
+#include "tiny_dnn/layers/dequantize_layer.h"
+#include "tiny_dnn/layers/fake_quantize_layer.h"
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/layers/max_pooling_layer.h"
+#include "tiny_dnn/layers/quantized_average_pooling_layer.h"
+#include "tiny_dnn/layers/quantized_convolutional_layer.h"
+#include "tiny_dnn/layers/quantized_fully_connected_layer.h"
+#include "tiny_dnn/layers/quantized_relu_layer.h"
+#include "tiny_dnn/network.h"
+#include "tiny_dnn/util/deserialization_helper.h"
+#include "tiny_dnn/util/serialization_helper.h"
+
+namespace tiny_dnn {
+
+namespace detail {
+
+// copy of a layer with its weights, through its serialized model
+inline std::shared_ptr<layer> clone_layer(const layer &l) {
+  std::stringstream ss;
+  {
+    cereal::JSONOutputArchive oa(ss);
+    layer::save_layer(oa, l);
+  }
+  cereal::JSONInputArchive ia(ss);
+  std::shared_ptr<layer> copy = layer::load_layer(ia);
+
+  std::vector<float_t> w;
+  for (const vec_t *v : l.weights()) w.insert(w.end(), v->begin(), v->end());
+  if (!w.empty()) {
+    int idx = 0;
+    copy->load(w, idx);
+  }
+  return copy;
+}
+
+// fused activations are not part of the layer models, so a converted copy
+// of a fused network would silently lose them
+inline void check_not_fused(network<sequential> &net, const char *what) {
+  for (size_t i = 0; i < net.depth(); i++) {
+    if (net[i]->fused_activation()) {
+      throw nn_error(std::string(what) + " the network before fusing it");
+    }
+  }
+}
+
+/**
+ * copy of @a net in the test phase, for the network conversions.
+ * convert(i, copy) appends to copy the layers replacing the i th layer of
+ * @a net, if any, and returns true, or returns false to have that layer
+ * copied as it is. a network whose activations are fused is rejected, @a
+ * what naming the conversion.
+ **/
+template <typename Convert>
+network<sequential> convert_layers(network<sequential> &net,
+                                   const char *what,
+                                   Convert convert) {
+  check_not_fused(net, what);
+  network<sequential> copy(net.name());
+  for (size_t i = 0; i < net.depth(); i++) {
+    if (!convert(i, copy)) copy << clone_layer(*net[i]);
+  }
+  copy.set_netphase(net_phase::test);
+  return copy;
+}
+
+}  // namespace detail
+
+/**
+ * post-training int8 calibration of a trained float network.
+ *
+ * the network is run over representative data to record the range of the
+ * input of every layer, which is then used as the static quantization range
+ * of the equivalent quantized layers:
+ *
+ * @code
+ * int8_calibrator calib(net);
+ * calib.collect(samples);
+ * network<sequential> qnet = calib.quantize();
+ * @endcode
+ *
+ * convolutional layers are converted to quantized_convolutional_layer, and
+ * fully-connected layers to quantized_fully_connected_layer. the layers
+ * following a quantized layer are chained to it in the integer domain when
+ * they can: the uint8 codes of the calibrated range of each edge are passed
+ * on as they are, relu and pooling layers are replaced by their quantized
+ * versions, and a relu right after a quantized layer is folded into the
+ * output range of that layer. a dequantize_layer closes each chain. the
+ * other layers are copied as they are.
+ **/
+class int8_calibrator {
+ public:
+  enum class range_method {
+    min_max,    // full range of the observed values
+    percentile  // range holding the given percentile of the values
+  };
+
+  /**
+   * @param net  [in] trained float network, which must outlive the calibrator
+   * @param bins [in] resolution of the histograms used by percentile ranges
+   **/
+  explicit int8_calibrator(network<sequential> &net, size_t bins = 2048)
+    : net_(net), bins_(std::max(size_t(4), bins / 4 * 4)) {
+    detail::check_not_fused(net_, "calibrate");
+    stats_.resize(net_.depth() + 1);
+  }
+
+  /**
+   * run the network over @a inputs and add the values seen by every layer
+   * to the statistics. may be called several times.
+   **/
+  void collect(const std::vector<vec_t> &inputs, size_t batch_size = 32) {
+    net_.set_netphase(net_phase::test);
+    batch_size = std::max(batch_size, size_t(1));
+
+    std::vector<const tensor_t *> out;
+    for (size_t begin = 0; begin < inputs.size(); begin += batch_size) {
+      const size_t end = std::min(begin + batch_size, inputs.size());
+      const tensor_t batch(inputs.begin() + begin, inputs.begin() + end);
+      std::vector<tensor_t> samples;
+      for (const vec_t &in : batch) samples.push_back(tensor_t{in});
+      net_.fprop(samples);
+
+      stats_[0].add(batch, bins_);
+      for (size_t i = 1; i <= net_.depth(); i++) {
+        net_[i - 1]->output(out);
+        stats_[i].add(*out[0], bins_);
+      }
+    }
+  }
+
+  /**
+   * range of the input of the @a layer th layer. the range always includes
+   * 0, so that zero padding is exactly representable.
+   *
+   * @param method     [in] how to derive the range from the statistics
+   * @param percentile [in] percentage of the values kept in the range, the
+   *                        remaining outliers being split between both tails
+   **/
+  std::pair<float_t, float_t> input_range(
+    size_t layer,
+    range_method method = range_method::percentile,
+    float_t percentile  = float_t(99.99)) const {
+    return edge_range(layer, method, percentile);
+  }
+
+  /**
+   * range of the output of the @a layer th layer, see input_range()
+   **/
+  std::pair<float_t, float_t> output_range(
+    size_t layer,
+    range_method method = range_method::percentile,
+    float_t percentile  = float_t(99.99)) const {
+    return edge_range(layer + 1, method, percentile);
+  }
+
+  /**
+   * build the quantized equivalent of the network, with the ranges of the
+   * quantized layers fixed by the collected statistics
+   *
+   * @param integer_edges [in] chain the quantized layers in the integer
+   *                           domain, rather than giving float outputs
+   **/
+  network<sequential> quantize(
+    range_method method = range_method::percentile,
+    float_t percentile  = float_t(99.99),
+    bool integer_edges  = true) const {
+    network<sequential> q(net_.name());
+    // the last layer added gives the uint8 codes of [edge.first, edge.second]
+    bool chained = false;
+    std::pair<float_t, float_t> edge;
+
+    for (size_t i = 0; i < net_.depth(); i++) {
+      const layer *l = net_[i];
+      std::shared_ptr<layer> ql;
+
+      if (chained && dynamic_cast<const relu_layer *>(l)) {
+        const auto range = output_range(i, method, percentile);
+        ql = std::make_shared<quantized_relu_layer>(
+          l->in_shape()[0], edge.first, edge.second, range.first, range.second);
+        edge = range;
+      }
+      if (chained && dynamic_cast<const max_pooling_layer *>(l)) {
+        // the uint8 coding is monotonic, so the max of the codes is the code
+        // of the max and the range is kept
+        ql = detail::clone_layer(*l);
+      }
+      auto pool = dynamic_cast<const average_pooling_layer *>(l);
+      if (chained && pool) {
+        const auto range = output_range(i, method, percentile);
+        ql = std::make_shared<quantized_average_pooling_layer>(
+          *pool, edge.first, edge.second, range.first, range.second);
+        edge = range;
+      }
+
+      if (auto conv = dynamic_cast<const convolutional_layer *>(l)) {
+        try {
+          auto qconv = std::make_shared<quantized_convolutional_layer>(*conv);
+          i  = set_ranges(*qconv, i, integer_edges, &chained, &edge, method,
+                         percentile);
+          ql = qconv;
+        } catch (const nn_error &) {
+          // not quantizable, kept in float
+        }
+      }
+      if (auto fc = dynamic_cast<const fully_connected_layer *>(l)) {
+        auto qfc = std::make_shared<quantized_fully_connected_layer>(*fc);
+        i  = set_ranges(*qfc, i, integer_edges, &chained, &edge, method,
+                       percentile);
+        ql = qfc;
+      }
+
+      if (!ql) {
+        if (chained) {
+          q << std::make_shared<dequantize_layer>(l->in_shape()[0], edge.first,
+                                                  edge.second);
+          chained = false;
+        }
+        ql = detail::clone_layer(*l);
+      }
+      q << std::move(ql);
+    }
+    if (chained) {
+      q << std::make_shared<dequantize_layer>(
+        net_[net_.depth() - 1]->out_shape()[0], edge.first, edge.second);
+    }
+    q.set_netphase(net_phase::test);
+    return q;
+  }
+
+ private:
+  /**
+   * fix the ranges of @a ql, the quantized version of the @a i th layer.
+   * the output of ql stays in the integer domain when the next layer can
+   * take it, a next relu being folded into its output range.
+   *
+   * @return index of the last layer replaced by ql
+   **/
+  template <typename QuantizedLayer>
+  size_t set_ranges(QuantizedLayer &ql,
+                    size_t i,
+                    bool integer_edges,
+                    bool *chained,
+                    std::pair<float_t, float_t> *edge,
+                    range_method method,
+                    float_t percentile) const {
+    const bool in_chain = *chained;
+    const std::pair<float_t, float_t> in =
+      in_chain ? *edge : input_range(i, method, percentile);
+    const bool out_chain = integer_edges && i + 1 < net_.depth() &&
+                           takes_integer_input(*net_[i + 1]);
+    // a relu only clamps to the lower bound 0 of its own range
+    const size_t last =
+      out_chain && dynamic_cast<const relu_layer *>(net_[i + 1]) ? i + 1 : i;
+    const std::pair<float_t, float_t> out =
+      out_chain ? output_range(last, method, percentile) : in;
+
+    if (in_chain) {
+      ql.set_quantized_input(in.first, in.second);
+    } else {
+      ql.set_input_range(in.first, in.second);
+    }
+    if (out_chain) ql.set_output_range(out.first, out.second);
+    *chained = out_chain;
+    *edge    = out;
+    return last;
+  }
+
+  static bool takes_integer_input(const layer &l) {
+    return dynamic_cast<const relu_layer *>(&l) ||
+           dynamic_cast<const max_pooling_layer *>(&l) ||
+           dynamic_cast<const average_pooling_layer *>(&l) ||
+           dynamic_cast<const convolutional_layer *>(&l) ||
+           dynamic_cast<const fully_connected_layer *>(&l);
+  }
+
+  // range of the values entering the @a edge th layer, or leaving the
+  // network for the last edge
+  std::pair<float_t, float_t> edge_range(size_t edge,
+                                         range_method method,
+                                         float_t percentile) const {
+    const layer_stats &s = stats_.at(edge);
+    if (s.count == 0) {
+      throw nn_error("no calibration data collected for layer " +
+                     to_string(edge));
+    }
+    float_t lo = s.min, hi = s.max;
+    if (method == range_method::percentile) {
+      const float_t tail =
+        float_t(s.count) * (float_t(100) - percentile) / float_t(200);
+      const float_t width = 2 * s.bound / float_t(bins_);
+
+      float_t sum = 0;
+      size_t b    = 0;
+      while (b < bins_ - 1 && sum + s.hist[b] <= tail) sum += s.hist[b++];
+      lo = std::max(lo, -s.bound + width * float_t(b));
+
+      sum = 0;
+      b   = bins_ - 1;
+      while (b > 0 && sum + s.hist[b] <= tail) sum += s.hist[b--];
+      hi = std::min(hi, -s.bound + width * float_t(b + 1));
+    }
+    lo = std::min(lo, float_t(0));
+    hi = std::max(hi, float_t(0));
+    if (!(lo < hi)) hi = lo + std::numeric_limits<float_t>::epsilon();
+    return std::make_pair(lo, hi);
+  }
+
+  struct layer_stats {
+    size_t count  = 0;
+    float_t min   = std::numeric_limits<float_t>::max();
+    float_t max   = std::numeric_limits<float_t>::lowest();
+    float_t bound = 0;  // the histogram covers [-bound, bound]
+    std::vector<size_t> hist;
+
+    void add(const tensor_t &t, size_t bins) {
+      float_t abs_max = 0;
+      for (const vec_t &v : t) {
+        for (float_t x : v) {
+          min     = std::min(min, x);
+          max     = std::max(max, x);
+          abs_max = std::max(abs_max, std::abs(x));
+        }
+      }
+      if (hist.empty()) {
+        hist.assign(bins, 0);
+        bound = abs_max > 0 ? abs_max : float_t(1);
+      }
+      // widen the histogram by merging pairs of bins into its middle half
+      while (abs_max > bound) {
+        std::vector<size_t> wide(bins, 0);
+        for (size_t b = 0; b < bins; b++) wide[bins / 4 + b / 2] += hist[b];
+        hist.swap(wide);
+        bound *= 2;
+      }
+
+      const float_t scale = float_t(bins) / (2 * bound);
+      for (const vec_t &v : t) {
+        for (float_t x : v) {
+          const size_t b = static_cast<size_t>((x + bound) * scale);
+          hist[std::min(b, bins - 1)]++;
+        }
+        count += v.size();
+      }
+    }
+  };
+
+  network<sequential> &net_;
+  size_t bins_;
+  std::vector<layer_stats> stats_;
+};
+
+/**
+ * quantized equivalent of a network trained with fake quantization.
+ *
+ * convolutional and fully-connected layers are converted to their quantized
+ * versions, whose weights are quantized as they were rounded in training,
+ * and whose input range is the one learned by the fake_quantize_layer right
+ * before them. the fake_quantize_layers are removed.
+ **/
+inline network<sequential> export_quantized(network<sequential> &net) {
+  return detail::convert_layers(
+    net, "export", [&](size_t i, network<sequential> &q) {
+      const layer *l = net[i];
+      if (dynamic_cast<const fake_quantize_layer *>(l)) return true;
+      const fake_quantize_layer *fq =
+        i > 0 ? dynamic_cast<const fake_quantize_layer *>(net[i - 1])
+              : nullptr;
+      const bool has_range = fq && fq->has_range();
+
+      if (auto conv = dynamic_cast<const convolutional_layer *>(l)) {
+        try {
+          auto qconv = std::make_shared<quantized_convolutional_layer>(*conv);
+          if (has_range) {
+            qconv->set_input_range(fq->range().first, fq->range().second);
+          }
+          q << qconv;
+          return true;
+        } catch (const nn_error &) {
+          return false;  // not quantizable, kept in float
+        }
+      }
+      if (auto fc = dynamic_cast<const fully_connected_layer *>(l)) {
+        auto qfc = std::make_shared<quantized_fully_connected_layer>(*fc);
+        if (has_range) {
+          qfc->set_input_range(fq->range().first, fq->range().second);
+        }
+        q << qfc;
+        return true;
+      }
+      return false;
+    });
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,342 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "tiny_dnn/util/product.h"
+
+/**
+ * Vectorized transcendental functions used by the activation layers and the
+ * recurrent cells.
+ *
+ * The single precision versions evaluate Cephes-style minimax polynomials
+ * after a range reduction, so the AVX path and the scalar tail produce the
+ * same results. The maximum errors, measured against libm evaluated in
+ * double precision, are:
+ *
+ *   exp     : relative error < 2.5e-7 for x in [-87, 88],
+ *             x > 88 saturates to exp(88), x < -87.6 flushes to zero
+ *   tanh    : relative error < 3.0e-7, |tanh(x)| exactly 1 for |x| > 9.1
+ *   sigmoid : absolute error < 2.0e-7
+ *   log1p   : relative error < 2.5e-7 for x in (-1, FLT_MAX]
+ *
+ * In double precision (CNN_USE_DOUBLE) the functions forward to libm.
+ */
+namespace vectorize {
+namespace detail {
+
+namespace fast_math {
+
+// ln(2) split in a part exactly representable in float and the remainder
+static const float ln2_hi  = 0.693359375f;
+static const float ln2_lo  = -2.12194440e-4f;
+static const float log2e   = 1.44269504088896341f;
+static const float exp_hi  = 88.0f;
+static const float exp_lo  = -88.0f;
+static const float sqrt1_2 = 0.707106781186547524f;
+// below this magnitude tanh uses the odd polynomial instead of exp
+static const float tanh_small = 0.625f;
+
+static const float exp_p0 = 1.9875691500e-4f;
+static const float exp_p1 = 1.3981999507e-3f;
+static const float exp_p2 = 8.3334519073e-3f;
+static const float exp_p3 = 4.1665795894e-2f;
+static const float exp_p4 = 1.6666665459e-1f;
+static const float exp_p5 = 5.0000001201e-1f;
+
+static const float tanh_p0 = -5.70498872745e-3f;
+static const float tanh_p1 = 2.06390887954e-2f;
+static const float tanh_p2 = -5.37397155531e-2f;
+static const float tanh_p3 = 1.33314422036e-1f;
+static const float tanh_p4 = -3.33332819422e-1f;
+
+static const float log_p0 = 7.0376836292e-2f;
+static const float log_p1 = -1.1514610310e-1f;
+static const float log_p2 = 1.1676998740e-1f;
+static const float log_p3 = -1.2420140846e-1f;
+static const float log_p4 = 1.4249322787e-1f;
+static const float log_p5 = -1.6668057665e-1f;
+static const float log_p6 = 2.0000714765e-1f;
+static const float log_p7 = -2.4999993993e-1f;
+static const float log_p8 = 3.3333331174e-1f;
+
+}  // namespace fast_math
+
+inline float exp_ps(float x) {
+  using namespace fast_math;
+  x             = std::min(std::max(x, exp_lo), exp_hi);
+  const float n = std::floor(x * log2e + 0.5f);
+  const float r = x - n * ln2_hi - n * ln2_lo;
+  const float r2 = r * r;
+  float p        = exp_p0;
+  p              = p * r + exp_p1;
+  p              = p * r + exp_p2;
+  p              = p * r + exp_p3;
+  p              = p * r + exp_p4;
+  p              = p * r + exp_p5;
+  p              = p * r2 + r + 1.0f;
+
+  // 2^n, n + 127 == 0 yields +0 which flushes the result to zero
+  const int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return p * scale;
+}
+
+inline float tanh_ps(float x) {
+  using namespace fast_math;
+  const float ax = std::abs(x);
+  if (ax < tanh_small) {
+    const float z = x * x;
+    float p       = tanh_p0;
+    p             = p * z + tanh_p1;
+    p             = p * z + tanh_p2;
+    p             = p * z + tanh_p3;
+    p             = p * z + tanh_p4;
+    return p * z * x + x;
+  }
+  const float t = 1.0f - 2.0f / (exp_ps(2.0f * ax) + 1.0f);
+  return std::copysign(t, x);
+}
+
+inline float sigmoid_ps(float x) { return 1.0f / (1.0f + exp_ps(-x)); }
+
+inline float log1p_ps(float x) {
+  using namespace fast_math;
+  const float u = 1.0f + x;
+  // rounding error of 1 + x, restored by the first order correction below
+  const float c = (x - (u - 1.0f)) / u;
+
+  int32_t bits;
+  std::memcpy(&bits, &u, sizeof(bits));
+  float e     = static_cast<float>((bits >> 23) - 127);
+  bits        = (bits & 0x007fffff) | 0x3f800000;  // mantissa in [1, 2)
+  float m;
+  std::memcpy(&m, &bits, sizeof(m));
+  if (m > 2.0f * sqrt1_2) {
+    m *= 0.5f;
+    e += 1.0f;
+  }
+  const float r  = m - 1.0f;
+  const float r2 = r * r;
+  float p        = log_p0;
+  p              = p * r + log_p1;
+  p              = p * r + log_p2;
+  p              = p * r + log_p3;
+  p              = p * r + log_p4;
+  p              = p * r + log_p5;
+  p              = p * r + log_p6;
+  p              = p * r + log_p7;
+  p              = p * r + log_p8;
+  float y        = p * r * r2;
+  y += e * ln2_lo;
+  y -= 0.5f * r2;
+  return r + y + e * ln2_hi + c;
+}
+
+#ifdef CNN_USE_AVX
+
+// 2^n for a vector of integral valued floats
+inline __m256 pow2n256_ps(__m256 n) {
+  const __m256i ni = _mm256_cvttps_epi32(n);
+#ifdef CNN_USE_AVX2
+  const __m256i e = _mm256_slli_epi32(
+    _mm256_add_epi32(ni, _mm256_set1_epi32(127)), 23);
+  return _mm256_castsi256_ps(e);
+#else
+  const __m128i bias = _mm_set1_epi32(127);
+  const __m128i lo =
+    _mm_slli_epi32(_mm_add_epi32(_mm256_castsi256_si128(ni), bias), 23);
+  const __m128i hi =
+    _mm_slli_epi32(_mm_add_epi32(_mm256_extractf128_si256(ni, 1), bias), 23);
+  return _mm256_set_m128(_mm_castsi128_ps(hi), _mm_castsi128_ps(lo));
+#endif
+}
+
+// unbiased exponent of a vector of positive normal floats
+inline __m256 exponent256_ps(__m256 x) {
+  const __m256i xi = _mm256_castps_si256(x);
+#ifdef CNN_USE_AVX2
+  const __m256i e =
+    _mm256_sub_epi32(_mm256_srli_epi32(xi, 23), _mm256_set1_epi32(127));
+  return _mm256_cvtepi32_ps(e);
+#else
+  const __m128i bias = _mm_set1_epi32(127);
+  const __m128i lo =
+    _mm_sub_epi32(_mm_srli_epi32(_mm256_castsi256_si128(xi), 23), bias);
+  const __m128i hi =
+    _mm_sub_epi32(_mm_srli_epi32(_mm256_extractf128_si256(xi, 1), 23), bias);
+  return _mm256_cvtepi32_ps(
+    _mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+#endif
+}
+
+inline __m256 exp256_ps(__m256 x) {
+  using namespace fast_math;
+  x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(exp_lo)),
+                    _mm256_set1_ps(exp_hi));
+  const __m256 n = _mm256_floor_ps(madd256_ps(x, _mm256_set1_ps(log2e),
+                                              _mm256_set1_ps(0.5f)));
+  __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(n, _mm256_set1_ps(ln2_hi)));
+  r        = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(ln2_lo)));
+  const __m256 r2 = _mm256_mul_ps(r, r);
+  __m256 p        = _mm256_set1_ps(exp_p0);
+  p               = madd256_ps(p, r, _mm256_set1_ps(exp_p1));
+  p               = madd256_ps(p, r, _mm256_set1_ps(exp_p2));
+  p               = madd256_ps(p, r, _mm256_set1_ps(exp_p3));
+  p               = madd256_ps(p, r, _mm256_set1_ps(exp_p4));
+  p               = madd256_ps(p, r, _mm256_set1_ps(exp_p5));
+  p = madd256_ps(p, r2, _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+  return _mm256_mul_ps(p, pow2n256_ps(n));
+}
+
+inline __m256 tanh256_ps(__m256 x) {
+  using namespace fast_math;
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  const __m256 ax   = _mm256_andnot_ps(sign, x);
+
+  // |x| < tanh_small: x + x^3 * P(x^2)
+  const __m256 z = _mm256_mul_ps(x, x);
+  __m256 p       = _mm256_set1_ps(tanh_p0);
+  p              = madd256_ps(p, z, _mm256_set1_ps(tanh_p1));
+  p              = madd256_ps(p, z, _mm256_set1_ps(tanh_p2));
+  p              = madd256_ps(p, z, _mm256_set1_ps(tanh_p3));
+  p              = madd256_ps(p, z, _mm256_set1_ps(tanh_p4));
+  const __m256 small = madd256_ps(_mm256_mul_ps(p, z), x, x);
+
+  // otherwise: sign(x) * (1 - 2 / (exp(2|x|) + 1))
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 e   = exp256_ps(_mm256_add_ps(ax, ax));
+  __m256 large     = _mm256_sub_ps(
+    one, _mm256_div_ps(_mm256_set1_ps(2.0f), _mm256_add_ps(e, one)));
+  large = _mm256_or_ps(large, _mm256_and_ps(sign, x));
+
+  const __m256 mask =
+    _mm256_cmp_ps(ax, _mm256_set1_ps(tanh_small), _CMP_LT_OQ);
+  return _mm256_blendv_ps(large, small, mask);
+}
+
+inline __m256 sigmoid256_ps(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 e   = exp256_ps(_mm256_sub_ps(_mm256_setzero_ps(), x));
+  return _mm256_div_ps(one, _mm256_add_ps(one, e));
+}
+
+inline __m256 log1p256_ps(__m256 x) {
+  using namespace fast_math;
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 u   = _mm256_add_ps(one, x);
+  const __m256 c =
+    _mm256_div_ps(_mm256_sub_ps(x, _mm256_sub_ps(u, one)), u);
+
+  __m256 e = exponent256_ps(u);
+  __m256 m = _mm256_or_ps(
+    _mm256_and_ps(u, _mm256_castsi256_ps(_mm256_set1_epi32(0x007fffff))),
+    one);
+  const __m256 big =
+    _mm256_cmp_ps(m, _mm256_set1_ps(2.0f * sqrt1_2), _CMP_GT_OQ);
+  m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+  e = _mm256_add_ps(e, _mm256_and_ps(big, one));
+
+  const __m256 r  = _mm256_sub_ps(m, one);
+  const __m256 r2 = _mm256_mul_ps(r, r);
+  __m256 p        = _mm256_set1_ps(log_p0);
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p1));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p2));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p3));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p4));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p5));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p6));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p7));
+  p               = madd256_ps(p, r, _mm256_set1_ps(log_p8));
+  __m256 y        = _mm256_mul_ps(_mm256_mul_ps(p, r), r2);
+  y = madd256_ps(e, _mm256_set1_ps(ln2_lo), y);
+  y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), r2));
+  y = _mm256_add_ps(_mm256_add_ps(r, y),
+                    _mm256_mul_ps(e, _mm256_set1_ps(ln2_hi)));
+  return _mm256_add_ps(y, c);
+}
+
+#endif  // CNN_USE_AVX
+
+// apply f256 to full registers and f to the remaining elements
+template <typename F256, typename F>
+inline void transform_ps(
+  const float *src, size_t size, float *dst, F256 f256, F f) {
+  size_t i = 0;
+#ifdef CNN_USE_AVX
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(dst + i, f256(_mm256_loadu_ps(src + i)));
+  }
+#else
+  CNN_UNREFERENCED_PARAMETER(f256);
+#endif
+  for (; i < size; i++) {
+    dst[i] = f(src[i]);
+  }
+}
+
+#ifdef CNN_USE_AVX
+#define CNN_FAST_MATH_AVX_FN(fn) [](__m256 v) { return fn(v); }
+#else
+#define CNN_FAST_MATH_AVX_FN(fn) 0
+#endif
+
+}  // namespace detail
+
+// dst[i] = exp(src[i]), src and dst may alias
+inline void exp(const float *src, size_t size, float *dst) {
+  detail::transform_ps(src, size, dst,
+                       CNN_FAST_MATH_AVX_FN(detail::exp256_ps),
+                       detail::exp_ps);
+}
+
+inline void exp(const double *src, size_t size, double *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = std::exp(src[i]);
+}
+
+// dst[i] = tanh(src[i]), src and dst may alias
+inline void tanh(const float *src, size_t size, float *dst) {
+  detail::transform_ps(src, size, dst,
+                       CNN_FAST_MATH_AVX_FN(detail::tanh256_ps),
+                       detail::tanh_ps);
+}
+
+inline void tanh(const double *src, size_t size, double *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = std::tanh(src[i]);
+}
+
+// dst[i] = 1 / (1 + exp(-src[i])), src and dst may alias
+inline void sigmoid(const float *src, size_t size, float *dst) {
+  detail::transform_ps(src, size, dst,
+                       CNN_FAST_MATH_AVX_FN(detail::sigmoid256_ps),
+                       detail::sigmoid_ps);
+}
+
+inline void sigmoid(const double *src, size_t size, double *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = 1.0 / (1.0 + std::exp(-src[i]));
+}
+
+// dst[i] = log(1 + src[i]), src and dst may alias
+inline void log1p(const float *src, size_t size, float *dst) {
+  detail::transform_ps(src, size, dst,
+                       CNN_FAST_MATH_AVX_FN(detail::log1p256_ps),
+                       detail::log1p_ps);
+}
+
+inline void log1p(const double *src, size_t size, double *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] = std::log1p(src[i]);
+}
+
+#undef CNN_FAST_MATH_AVX_FN
+
+}  // namespace vectorize
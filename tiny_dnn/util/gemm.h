@@ -0,0 +1,84 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include "tiny_dnn/config.h"
+#include "tiny_dnn/util/product.h"
+
+namespace tiny_dnn {
+namespace detail {
+
+// dst[i] += c * src[i]
+template <typename T>
+inline void gemm_axpy(const T *src, T c, size_t size, T *dst) {
+  for (size_t i = 0; i < size; i++) dst[i] += c * src[i];
+}
+
+inline void gemm_axpy(const float_t *src,
+                      float_t c,
+                      size_t size,
+                      float_t *dst) {
+  vectorize::muladd(src, c, size, dst);
+}
+
+template <typename T>
+inline T gemm_dot(const T *s1, const T *s2, size_t size) {
+  T sum{0};
+  for (size_t i = 0; i < size; i++) sum += s1[i] * s2[i];
+  return sum;
+}
+
+inline float_t gemm_dot(const float_t *s1, const float_t *s2, size_t size) {
+  return vectorize::dot(s1, s2, size);
+}
+
+}  // namespace detail
+
+/**
+ * C += op(A) * op(B) on row-major matrices, where op(A) is M x K and op(B) is
+ * K x N. With TransA, A is stored as K x M; with TransB, B is stored as N x K.
+ *
+ * Without TransB, rows of B are accumulated into C with axpy, skipping zero
+ * elements of A (masked weights cost nothing); with TransB each element of C
+ * is a dot product.
+ **/
+template <bool TransA, bool TransB, typename T>
+inline void gemm(size_t M,
+                 size_t N,
+                 size_t K,
+                 const T *A,
+                 size_t lda,
+                 const T *B,
+                 size_t ldb,
+                 T *C,
+                 size_t ldc) {
+  for (size_t i = 0; i < M; i++) {
+    T *c = C + i * ldc;
+    if (TransB) {
+      for (size_t j = 0; j < N; j++) {
+        if (TransA) {
+          T sum{0};
+          for (size_t k = 0; k < K; k++) {
+            sum += A[k * lda + i] * B[j * ldb + k];
+          }
+          c[j] += sum;
+        } else {
+          c[j] += detail::gemm_dot(A + i * lda, B + j * ldb, K);
+        }
+      }
+    } else {
+      for (size_t k = 0; k < K; k++) {
+        const T a = TransA ? A[k * lda + i] : A[i * lda + k];
+        if (a == T{0}) continue;
+        detail::gemm_axpy(B + k * ldb, a, N, c);
+      }
+    }
+  }
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,41 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <memory>
+
+#include "tiny_dnn/layers/convolutional_layer.h"
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/layers/half_convolutional_layer.h"
+#include "tiny_dnn/layers/half_fully_connected_layer.h"
+#include "tiny_dnn/network.h"
+#include "tiny_dnn/util/calibration.h"
+
+namespace tiny_dnn {
+
+/**
+ * copy of @a net where the convolutional and fully-connected layers are
+ * replaced by their half-precision versions, which hold half of the weight
+ * bytes. see detail::convert_layers().
+ **/
+inline network<sequential> to_half_precision(network<sequential> &net) {
+  return detail::convert_layers(
+    net, "convert", [&](size_t i, network<sequential> &h) {
+      if (auto conv = dynamic_cast<const convolutional_layer *>(net[i])) {
+        h << std::make_shared<half_convolutional_layer>(*conv);
+      } else if (auto fc =
+                   dynamic_cast<const fully_connected_layer *>(net[i])) {
+        h << std::make_shared<half_fully_connected_layer>(*fc);
+      } else {
+        return false;
+      }
+      return true;
+    });
+}
+
+}  // namespace tiny_dnn
@@ -0,0 +1,437 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/network.h"
+#include "tiny_dnn/util/calibration.h"
+#include "tiny_dnn/util/random.h"
+
+namespace tiny_dnn {
+
+/**
+ * fully_connected_layer W ~= first * second, from a truncated SVD of W
+ **/
+struct low_rank_factors {
+  std::shared_ptr<fully_connected_layer> first;   // in -> rank, no bias
+  std::shared_ptr<fully_connected_layer> second;  // rank -> out, with bias
+  size_t rank   = 0;
+  float_t error = 0;  // ||W - W_rank|| / ||W|| (Frobenius norms)
+};
+
+namespace detail {
+
+typedef std::vector<double> dvec_t;
+
+/**
+ * truncated SVD A ~= U diag(s) V^T of the m x n row-major matrix A, by the
+ * randomized range finder of Halko et al. with @a sketch columns: the
+ * range of A is captured by an orthonormal Q, and the small Q^T A is
+ * decomposed through the eigenvectors of its Gram matrix, found by a
+ * Householder tridiagonalization and QL iterations. exact when
+ * sketch >= min(m, n).
+ *
+ * the singular values are in decreasing order; u[j] (m) and v[j] (n) are
+ * the singular vectors.
+ **/
+class truncated_svd {
+ public:
+  truncated_svd(const dvec_t &A, size_t m, size_t n, size_t sketch)
+    : A_(A), m_(m), n_(n) {
+    const size_t r = std::min(sketch, std::min(m, n));
+
+    // Q = orth(A (A^T A)^q Omega)
+    std::vector<dvec_t> omega(r, dvec_t(n)), q(r), z(r);
+    for (auto &o : omega) {
+      for (auto &x : o) x = gaussian_rand(float_t(0), float_t(1));
+    }
+    for (size_t j = 0; j < r; j++) q[j] = mul(omega[j]);
+    orthonormalize(&q);
+    // power iterations sharpen the range, which is exact at full rank
+    const size_t power_iterations = r < std::min(m, n) ? 2 : 0;
+    for (size_t iter = 0; iter < power_iterations; iter++) {
+      for (size_t j = 0; j < r; j++) z[j] = mul_transposed(q[j]);
+      orthonormalize(&z);
+      for (size_t j = 0; j < r; j++) q[j] = mul(z[j]);
+      orthonormalize(&q);
+    }
+
+    // Q^T A = J diag(s) V^T from the eigenvectors J of the r x r matrix
+    // Q^T A A^T Q = Z^T Z, with Z = A^T Q
+    for (size_t j = 0; j < r; j++) z[j] = mul_transposed(q[j]);
+    dvec_t J(r * r), eigenvalues(r);
+    for (size_t j = 0; j < r; j++) {
+      for (size_t k = j; k < r; k++) {
+        J[j * r + k] = J[k * r + j] = dot(z[j], z[k]);
+      }
+    }
+    symmetric_eigen(&J, &eigenvalues, r);
+
+    std::vector<size_t> order(r);
+    for (size_t j = 0; j < r; j++) order[j] = j;
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) {
+                return eigenvalues[a] > eigenvalues[b];
+              });
+
+    for (size_t j : order) {
+      // U = Q J, V = Z J diag(1 / s)
+      const double s = std::sqrt(std::max(0.0, eigenvalues[j]));
+      dvec_t u(m, 0.0), v(n, 0.0);
+      for (size_t l = 0; l < r; l++) {
+        const double x = J[l * r + j];
+        for (size_t i = 0; i < m; i++) u[i] += q[l][i] * x;
+        if (s > 0) {
+          for (size_t c = 0; c < n; c++) v[c] += z[l][c] * x / s;
+        }
+      }
+      s_.push_back(s);
+      u_.push_back(std::move(u));
+      v_.push_back(std::move(v));
+    }
+    norm2_ = dot(A_, A_);
+  }
+
+  const dvec_t &singular_values() const { return s_; }
+  const dvec_t &u(size_t j) const { return u_[j]; }
+  const dvec_t &v(size_t j) const { return v_[j]; }
+
+  // relative Frobenius error of the best rank-k approximation found
+  double error(size_t k) const {
+    double kept = 0;
+    for (size_t j = 0; j < k; j++) kept += s_[j] * s_[j];
+    if (norm2_ == 0) return 0;
+    return std::sqrt(std::max(0.0, norm2_ - kept) / norm2_);
+  }
+
+ private:
+  static double dot(const dvec_t &a, const dvec_t &b) {
+    double sum = 0;
+    for (size_t i = 0; i < a.size(); i++) sum += a[i] * b[i];
+    return sum;
+  }
+
+  // A x
+  dvec_t mul(const dvec_t &x) const {
+    dvec_t y(m_);
+    for (size_t i = 0; i < m_; i++) {
+      const double *row = &A_[i * n_];
+      double sum        = 0;
+      for (size_t c = 0; c < n_; c++) sum += row[c] * x[c];
+      y[i] = sum;
+    }
+    return y;
+  }
+
+  // A^T x
+  dvec_t mul_transposed(const dvec_t &x) const {
+    dvec_t y(n_, 0.0);
+    for (size_t i = 0; i < m_; i++) {
+      const double *row = &A_[i * n_];
+      for (size_t c = 0; c < n_; c++) y[c] += row[c] * x[i];
+    }
+    return y;
+  }
+
+  // modified Gram-Schmidt, twice; dependent vectors are set to zero
+  static void orthonormalize(std::vector<dvec_t> *vecs) {
+    for (size_t j = 0; j < vecs->size(); j++) {
+      dvec_t &a = (*vecs)[j];
+      for (size_t pass = 0; pass < 2; pass++) {
+        for (size_t k = 0; k < j; k++) {
+          const double d = dot(a, (*vecs)[k]);
+          for (size_t i = 0; i < a.size(); i++) a[i] -= d * (*vecs)[k][i];
+        }
+      }
+      const double norm = std::sqrt(dot(a, a));
+      for (auto &x : a) x = norm > 1e-12 ? x / norm : 0;
+    }
+  }
+
+  /**
+   * eigen-decomposition of the symmetric n x n matrix V, replaced by its
+   * eigenvectors (in columns): Householder reduction to a tridiagonal
+   * matrix, then implicit QL iterations (tred2 and tql2 of EISPACK, as
+   * adapted by JAMA).
+   **/
+  static void symmetric_eigen(dvec_t *V_, dvec_t *d_, size_t n) {
+    dvec_t &V = *V_;
+    dvec_t &d = *d_;
+    dvec_t e(n, 0.0);
+    auto at   = [&](size_t i, size_t j) -> double & { return V[i * n + j]; };
+    if (n == 1) {
+      d[0]     = at(0, 0);
+      at(0, 0) = 1;
+      return;
+    }
+
+    // tridiagonalization
+    for (size_t j = 0; j < n; j++) d[j] = at(n - 1, j);
+    for (size_t i = n - 1; i > 0; i--) {
+      double scale = 0, h = 0;
+      for (size_t k = 0; k < i; k++) scale += std::abs(d[k]);
+      if (scale == 0) {
+        e[i] = d[i - 1];
+        for (size_t j = 0; j < i; j++) {
+          d[j]     = at(i - 1, j);
+          at(i, j) = 0;
+          at(j, i) = 0;
+        }
+      } else {
+        for (size_t k = 0; k < i; k++) {
+          d[k] /= scale;
+          h += d[k] * d[k];
+        }
+        double f = d[i - 1];
+        double g = std::sqrt(h);
+        if (f > 0) g = -g;
+        e[i]     = scale * g;
+        h        = h - f * g;
+        d[i - 1] = f - g;
+        for (size_t j = 0; j < i; j++) e[j] = 0;
+        for (size_t j = 0; j < i; j++) {
+          f        = d[j];
+          at(j, i) = f;
+          g        = e[j] + at(j, j) * f;
+          for (size_t k = j + 1; k < i; k++) {
+            g += at(k, j) * d[k];
+            e[k] += at(k, j) * f;
+          }
+          e[j] = g;
+        }
+        f = 0;
+        for (size_t j = 0; j < i; j++) {
+          e[j] /= h;
+          f += e[j] * d[j];
+        }
+        const double hh = f / (h + h);
+        for (size_t j = 0; j < i; j++) e[j] -= hh * d[j];
+        for (size_t j = 0; j < i; j++) {
+          f = d[j];
+          g = e[j];
+          for (size_t k = j; k < i; k++) at(k, j) -= (f * e[k] + g * d[k]);
+          d[j]     = at(i - 1, j);
+          at(i, j) = 0;
+        }
+      }
+      d[i] = h;
+    }
+    for (size_t i = 0; i + 1 < n; i++) {
+      at(n - 1, i)   = at(i, i);
+      at(i, i)       = 1;
+      const double h = d[i + 1];
+      if (h != 0) {
+        for (size_t k = 0; k <= i; k++) d[k] = at(k, i + 1) / h;
+        for (size_t j = 0; j <= i; j++) {
+          double g = 0;
+          for (size_t k = 0; k <= i; k++) g += at(k, i + 1) * at(k, j);
+          for (size_t k = 0; k <= i; k++) at(k, j) -= g * d[k];
+        }
+      }
+      for (size_t k = 0; k <= i; k++) at(k, i + 1) = 0;
+    }
+    for (size_t j = 0; j < n; j++) {
+      d[j]         = at(n - 1, j);
+      at(n - 1, j) = 0;
+    }
+    at(n - 1, n - 1) = 1;
+    e[0]             = 0;
+
+    // QL iterations on the tridiagonal matrix
+    for (size_t i = 1; i < n; i++) e[i - 1] = e[i];
+    e[n - 1]         = 0;
+    double f         = 0, tst1 = 0;
+    const double eps = std::numeric_limits<double>::epsilon();
+    for (size_t l = 0; l < n; l++) {
+      tst1     = std::max(tst1, std::abs(d[l]) + std::abs(e[l]));
+      size_t m = l;
+      while (m < n - 1 && std::abs(e[m]) > eps * tst1) m++;
+      if (m > l) {
+        for (size_t iter = 0; iter < 100; iter++) {
+          double g = d[l];
+          double p = (d[l + 1] - g) / (2 * e[l]);
+          double r = std::hypot(p, 1.0);
+          if (p < 0) r = -r;
+          d[l]             = e[l] / (p + r);
+          d[l + 1]         = e[l] * (p + r);
+          const double dl1 = d[l + 1];
+          double h         = g - d[l];
+          for (size_t i = l + 2; i < n; i++) d[i] -= h;
+          f += h;
+
+          p                = d[m];
+          double c         = 1, c2 = 1, c3 = 1, s = 0, s2 = 0;
+          const double el1 = e[l + 1];
+          for (size_t i = m; i-- > l;) {
+            c3       = c2;
+            c2       = c;
+            s2       = s;
+            g        = c * e[i];
+            h        = c * p;
+            r        = std::hypot(p, e[i]);
+            e[i + 1] = s * r;
+            s        = e[i] / r;
+            c        = p / r;
+            p        = c * d[i] - s * g;
+            d[i + 1] = h + s * (c * g + s * d[i]);
+            for (size_t k = 0; k < n; k++) {
+              h            = at(k, i + 1);
+              at(k, i + 1) = s * at(k, i) + c * h;
+              at(k, i)     = c * at(k, i) - s * h;
+            }
+          }
+          p    = -s * s2 * c3 * el1 * e[l] / dl1;
+          e[l] = s * p;
+          d[l] = c * p;
+          if (std::abs(e[l]) <= eps * tst1) break;
+        }
+      }
+      d[l] += f;
+      e[l] = 0;
+    }
+  }
+
+  const dvec_t &A_;
+  size_t m_;
+  size_t n_;
+  double norm2_;
+  dvec_t s_;
+  std::vector<dvec_t> u_;
+  std::vector<dvec_t> v_;
+};
+
+// the weights of l as an out x in matrix
+inline dvec_t fully_connected_matrix(const fully_connected_layer &l) {
+  const vec_t &W   = *l.weights()[0];
+  const size_t in  = l.fan_in_size();
+  const size_t out = l.fan_out_size();
+  dvec_t A(out * in);
+  for (size_t c = 0; c < in; c++) {
+    for (size_t i = 0; i < out; i++) A[i * in + c] = W[c * out + i];
+  }
+  return A;
+}
+
+inline low_rank_factors make_low_rank_factors(const fully_connected_layer &l,
+                                              const truncated_svd &svd,
+                                              size_t rank) {
+  const size_t in     = l.fan_in_size();
+  const size_t out    = l.fan_out_size();
+  const bool has_bias = l.weights().size() > 1;
+
+  low_rank_factors f;
+  f.rank   = rank;
+  f.error  = static_cast<float_t>(svd.error(rank));
+  f.first  = std::make_shared<fully_connected_layer>(in, rank, false);
+  f.second = std::make_shared<fully_connected_layer>(rank, out, has_bias);
+
+  // first: V^T, second: U diag(s) followed by the bias
+  std::vector<float_t> W1(in * rank), W2(rank * out);
+  for (size_t j = 0; j < rank; j++) {
+    const double s = svd.singular_values()[j];
+    for (size_t c = 0; c < in; c++) {
+      W1[c * rank + j] = static_cast<float_t>(svd.v(j)[c]);
+    }
+    for (size_t i = 0; i < out; i++) {
+      W2[j * out + i] = static_cast<float_t>(svd.u(j)[i] * s);
+    }
+  }
+  if (has_bias) {
+    const vec_t &bias = *l.weights()[1];
+    W2.insert(W2.end(), bias.begin(), bias.end());
+  }
+  int idx = 0;
+  f.first->load(W1, idx);
+  idx = 0;
+  f.second->load(W2, idx);
+  return f;
+}
+
+// extra columns of the random sketch
+static const size_t low_rank_oversampling = 10;
+
+}  // namespace detail
+
+/**
+ * factorize the weights of a trained fully-connected layer into two thinner
+ * fully-connected layers, keeping the @a rank largest singular values. the
+ * bias goes to the second layer.
+ *
+ * the two layers hold rank * (in + out) weights instead of in * out.
+ **/
+inline low_rank_factors factorize_by_rank(const fully_connected_layer &l,
+                                          size_t rank) {
+  const size_t in  = l.fan_in_size();
+  const size_t out = l.fan_out_size();
+  if (rank == 0 || rank > std::min(in, out)) {
+    throw nn_error("rank must be in [1, min(in_size, out_size)]");
+  }
+  const detail::dvec_t A = detail::fully_connected_matrix(l);
+  detail::truncated_svd svd(A, out, in, rank + detail::low_rank_oversampling);
+  return detail::make_low_rank_factors(l, svd, rank);
+}
+
+/**
+ * factorize a fully-connected layer with the smallest rank whose relative
+ * Frobenius error of the weights is at most @a max_error, see
+ * factorize_by_rank().
+ **/
+inline low_rank_factors factorize_by_error(const fully_connected_layer &l,
+                                           float_t max_error) {
+  if (!(max_error >= 0 && max_error < 1)) {
+    throw nn_error("max_error must be in [0, 1)");
+  }
+  const size_t in        = l.fan_in_size();
+  const size_t out       = l.fan_out_size();
+  const size_t max_rank  = std::min(in, out);
+  const detail::dvec_t A = detail::fully_connected_matrix(l);
+
+  // the sketch is doubled until it holds enough singular values
+  for (size_t sketch = std::min(size_t(32), max_rank);; sketch *= 2) {
+    detail::truncated_svd svd(A, out, in, sketch);
+    const size_t found = svd.singular_values().size();
+    for (size_t k = 1; k <= found; k++) {
+      if (svd.error(k) <= max_error) {
+        return detail::make_low_rank_factors(l, svd, k);
+      }
+    }
+    if (found == max_rank) {
+      return detail::make_low_rank_factors(l, svd, max_rank);
+    }
+  }
+}
+
+/**
+ * copy of @a net where each fully-connected layer is replaced by its
+ * factorize_by_error() factors when they hold fewer weights. see
+ * detail::convert_layers().
+ **/
+inline network<sequential> factorize_fully_connected(network<sequential> &net,
+                                                     float_t max_error) {
+  return detail::convert_layers(
+    net, "factorize", [&](size_t i, network<sequential> &f) {
+      auto fc = dynamic_cast<const fully_connected_layer *>(net[i]);
+      if (!fc) return false;
+      low_rank_factors factors = factorize_by_error(*fc, max_error);
+      if (factors.rank * (fc->fan_in_size() + fc->fan_out_size()) >=
+          fc->fan_in_size() * fc->fan_out_size()) {
+        return false;
+      }
+      f << std::move(factors.first) << std::move(factors.second);
+      return true;
+    });
+}
+
+}  // namespace tiny_dnn
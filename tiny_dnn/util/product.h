@@ -492,6 +492,46 @@ CNN_MUST_INLINE void muladd(const typename T::value_type *src,
   }
 }
 
+template <typename T, typename src_aligned, typename dst_aligned>
+CNN_MUST_INLINE void mul(const typename T::value_type *src,
+                         std::size_t size,
+                         typename T::value_type *dst) {
+  auto sz     = T::unroll_size;
+  auto sz4    = T::unroll_size * 4;
+  auto n4     = size / sz4;
+  auto n1     = (size % sz4) / sz;
+  auto remain = size % sz;
+  for (size_t i = 0; i < n4; ++i) {
+    auto d0 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 0]);
+    auto d1 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 1]);
+    auto d2 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 2]);
+    auto d3 = T::template load<dst_aligned>(&dst[i * sz4 + sz * 3]);
+    auto s0 = T::template load<src_aligned>(&src[i * sz4 + sz * 0]);
+    auto s1 = T::template load<src_aligned>(&src[i * sz4 + sz * 1]);
+    auto s2 = T::template load<src_aligned>(&src[i * sz4 + sz * 2]);
+    auto s3 = T::template load<src_aligned>(&src[i * sz4 + sz * 3]);
+    d0      = T::mul(s0, d0);
+    d1      = T::mul(s1, d1);
+    d2      = T::mul(s2, d2);
+    d3      = T::mul(s3, d3);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 0], d0);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 1], d1);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 2], d2);
+    T::template store<dst_aligned>(&dst[i * sz4 + sz * 3], d3);
+  }
+  size_t idx = n4 * sz4;
+  for (size_t i = 0; i < n1; ++i) {
+    auto d = T::template load<dst_aligned>(&dst[idx + i * sz]);
+    auto s = T::template load<src_aligned>(&src[idx + i * sz]);
+    d      = T::mul(s, d);
+    T::template store<dst_aligned>(&dst[idx + i * sz], d);
+  }
+  idx += n1 * sz;
+  for (size_t i = 0; i < remain; ++i) {
+    dst[idx + i] *= src[idx + i];
+  }
+}
+
 template <typename T, typename src_aligned, typename dst_aligned>
 CNN_MUST_INLINE void reduce(const typename T::value_type *src,
                             std::size_t size,
@@ -683,6 +723,32 @@ void muladd(const T *src, T c, std::size_t size, T *dst) {
   }
 }
 
+// dst[i] *= src[i]
+template <typename T>
+void mul(const T *src, std::size_t size, T *dst) {
+  bool src_aligned =
+    CNN_VECTORIZE_TYPE::is_aligned((CNN_VECTORIZE_TYPE::value_type *)src);
+  bool dst_aligned =
+    CNN_VECTORIZE_TYPE::is_aligned((CNN_VECTORIZE_TYPE::value_type *)dst);
+  if (src_aligned) {
+    if (dst_aligned) {
+      detail::mul<CNN_VECTORIZE_TYPE, std::true_type, std::true_type>(src, size,
+                                                                      dst);
+    } else {
+      detail::mul<CNN_VECTORIZE_TYPE, std::true_type, std::false_type>(
+        src, size, dst);
+    }
+  } else {
+    if (dst_aligned) {
+      detail::mul<CNN_VECTORIZE_TYPE, std::false_type, std::true_type>(
+        src, size, dst);
+    } else {
+      detail::mul<CNN_VECTORIZE_TYPE, std::false_type, std::false_type>(
+        src, size, dst);
+    }
+  }
+}
+
 // sum(s1[i] * s2[i])
 template <typename T>
 T dot(const T *s1, const T *s2, std::size_t size) {
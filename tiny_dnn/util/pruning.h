@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2013, Taiga Nomi and the respective contributors
+    All rights reserved.
+
+    Use of this source code is governed by a BSD-style license that can be found
+    in the LICENSE file.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tiny_dnn/layers/convolutional_layer.h"
+#include "tiny_dnn/layers/fully_connected_layer.h"
+#include "tiny_dnn/layers/sparse_fully_connected_layer.h"
+#include "tiny_dnn/network.h"
+#include "tiny_dnn/util/calibration.h"
+
+namespace tiny_dnn {
+
+/**
+ * set to zero the fraction @a sparsity of the weights of @a l with the
+ * smallest magnitude. only the weights W are pruned, not the biases.
+ *
+ * @return number of zero weights
+ **/
+inline size_t prune_by_magnitude(layer &l, float_t sparsity) {
+  if (!(sparsity >= 0 && sparsity <= 1)) {
+    throw nn_error("sparsity must be in [0, 1]");
+  }
+  if (l.weights().empty()) return 0;
+  vec_t &W = *l.weights()[0];
+
+  const size_t n = static_cast<size_t>(sparsity * float_t(W.size()));
+  if (n > 0) {
+    std::vector<size_t> order(W.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::nth_element(order.begin(), order.begin() + (n - 1), order.end(),
+                     [&](size_t a, size_t b) {
+                       return std::abs(W[a]) < std::abs(W[b]);
+                     });
+    for (size_t i = 0; i < n; i++) W[order[i]] = float_t{0};
+    l.post_update();
+  }
+  return static_cast<size_t>(std::count(W.begin(), W.end(), float_t{0}));
+}
+
+/**
+ * prune the convolutional and fully-connected layers of a trained network,
+ * see prune_by_magnitude(layer &, float_t). the network may then be
+ * fine-tuned, although the pruned weights are free to grow again.
+ **/
+template <typename NetType>
+void prune_by_magnitude(network<NetType> &net, float_t sparsity) {
+  for (size_t i = 0; i < net.depth(); i++) {
+    layer *l = net[i];
+    if (dynamic_cast<convolutional_layer *>(l) ||
+        dynamic_cast<fully_connected_layer *>(l)) {
+      prune_by_magnitude(*l, sparsity);
+    }
+  }
+}
+
+/**
+ * copy of @a net where the fully-connected layers holding at least the
+ * fraction @a min_sparsity of zero weights are replaced by
+ * sparse_fully_connected_layer, see detail::convert_layers().
+ **/
+inline network<sequential> sparsify(network<sequential> &net,
+                                    float_t min_sparsity = 0.5) {
+  return detail::convert_layers(
+    net, "sparsify", [&](size_t i, network<sequential> &s) {
+      auto fc = dynamic_cast<const fully_connected_layer *>(net[i]);
+      if (!fc) return false;
+      const vec_t &W = *fc->weights()[0];
+      const size_t zeros =
+        static_cast<size_t>(std::count(W.begin(), W.end(), float_t{0}));
+      if (float_t(zeros) < min_sparsity * float_t(W.size())) return false;
+      s << std::make_shared<sparse_fully_connected_layer>(*fc);
+      return true;
+    });
+}
+
+}  // namespace tiny_dnn
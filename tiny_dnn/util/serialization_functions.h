@@ -285,6 +285,25 @@ struct LoadAndConstruct<tiny_dnn::dropout_layer> {
   }
 };
 
+template <>
+struct LoadAndConstruct<tiny_dnn::fake_quantize_layer> {
+  template <class Archive>
+  static void load_and_construct(
+    Archive &ar, cereal::construct<tiny_dnn::fake_quantize_layer> &construct) {
+    tiny_dnn::shape3d in_shape;
+    tiny_dnn::float_t momentum, min, max;
+    tiny_dnn::net_phase phase;
+
+    ::detail::arc(ar, ::detail::make_nvp("in_size", in_shape),
+                  ::detail::make_nvp("momentum", momentum),
+                  ::detail::make_nvp("phase", phase),
+                  ::detail::make_nvp("min", min),
+                  ::detail::make_nvp("max", max));
+    construct(in_shape, momentum, phase);
+    construct->set_range(min, max);
+  }
+};
+
 template <>
 struct LoadAndConstruct<tiny_dnn::fully_connected_layer> {
   template <class Archive>
@@ -314,6 +333,60 @@ struct LoadAndConstruct<tiny_dnn::global_average_pooling_layer> {
   }
 };
 
+template <>
+struct LoadAndConstruct<tiny_dnn::half_convolutional_layer> {
+  template <class Archive>
+  static void load_and_construct(
+    Archive &ar,
+    cereal::construct<tiny_dnn::half_convolutional_layer> &construct) {
+    size_t w_width, w_height, out_ch, w_stride, h_stride, w_dilation,
+      h_dilation;
+    bool has_bias;
+    tiny_dnn::shape3d in;
+    tiny_dnn::padding pad_type;
+    tiny_dnn::core::connection_table tbl;
+    std::vector<tiny_dnn::kernels::fp16_t> W;
+    tiny_dnn::vec_t bias;
+
+    ::detail::arc(ar, ::detail::make_nvp("in_size", in),
+                  ::detail::make_nvp("window_width", w_width),
+                  ::detail::make_nvp("window_height", w_height),
+                  ::detail::make_nvp("out_channels", out_ch),
+                  ::detail::make_nvp("connection_table", tbl),
+                  ::detail::make_nvp("pad_type", pad_type),
+                  ::detail::make_nvp("has_bias", has_bias),
+                  ::detail::make_nvp("w_stride", w_stride),
+                  ::detail::make_nvp("h_stride", h_stride),
+                  ::detail::make_nvp("w_dilation", w_dilation),
+                  ::detail::make_nvp("h_dilation", h_dilation),
+                  ::detail::make_nvp("weights", W),
+                  ::detail::make_nvp("bias", bias));
+
+    tiny_dnn::convolutional_layer geometry(
+      in.width_, in.height_, w_width, w_height, in.depth_, out_ch, tbl,
+      pad_type, has_bias, w_stride, h_stride, w_dilation, h_dilation);
+    construct(geometry, std::move(W), std::move(bias));
+  }
+};
+
+template <>
+struct LoadAndConstruct<tiny_dnn::half_fully_connected_layer> {
+  template <class Archive>
+  static void load_and_construct(
+    Archive &ar,
+    cereal::construct<tiny_dnn::half_fully_connected_layer> &construct) {
+    size_t in_dim, out_dim;
+    std::vector<tiny_dnn::kernels::fp16_t> W;
+    tiny_dnn::vec_t bias;
+
+    ::detail::arc(ar, ::detail::make_nvp("in_size", in_dim),
+                  ::detail::make_nvp("out_size", out_dim),
+                  ::detail::make_nvp("weights", W),
+                  ::detail::make_nvp("bias", bias));
+    construct(in_dim, out_dim, std::move(W), std::move(bias));
+  }
+};
+
 template <>
 struct LoadAndConstruct<tiny_dnn::input_layer> {
   template <class Archive>
@@ -576,6 +649,25 @@ struct LoadAndConstruct<tiny_dnn::rnn_cell> {
   }
 };
 
+template <>
+struct LoadAndConstruct<tiny_dnn::sparse_fully_connected_layer> {
+  template <class Archive>
+  static void load_and_construct(
+    Archive &ar,
+    cereal::construct<tiny_dnn::sparse_fully_connected_layer> &construct) {
+    tiny_dnn::kernels::csr_matrix W;
+    tiny_dnn::vec_t bias;
+
+    ::detail::arc(ar, ::detail::make_nvp("in_size", W.cols),
+                  ::detail::make_nvp("out_size", W.rows),
+                  ::detail::make_nvp("values", W.values),
+                  ::detail::make_nvp("columns", W.columns),
+                  ::detail::make_nvp("row_ptr", W.row_ptr),
+                  ::detail::make_nvp("bias", bias));
+    construct(std::move(W), std::move(bias));
+  }
+};
+
 template <>
 struct LoadAndConstruct<tiny_dnn::slice_layer> {
   template <class Archive>
@@ -837,6 +929,16 @@ struct serialization_buddy {
                   ::detail::make_nvp("phase", layer.phase_));
   }
 
+  template <class Archive>
+  static inline void serialize(Archive &ar,
+                               tiny_dnn::fake_quantize_layer &layer) {
+    ::detail::arc(ar, ::detail::make_nvp("in_size", layer.in_shape_),
+                  ::detail::make_nvp("momentum", layer.momentum_),
+                  ::detail::make_nvp("phase", layer.phase_),
+                  ::detail::make_nvp("min", layer.min_),
+                  ::detail::make_nvp("max", layer.max_));
+  }
+
   template <class Archive>
   static inline void serialize(Archive &ar,
                                tiny_dnn::fully_connected_layer &layer) {
@@ -853,6 +955,34 @@ struct serialization_buddy {
     ::detail::arc(ar, ::detail::make_nvp("in_shape", params_.in));
   }
 
+  template <class Archive>
+  static inline void serialize(Archive &ar,
+                               tiny_dnn::half_convolutional_layer &layer) {
+    auto &params_ = layer.params_;
+    ::detail::arc(ar, ::detail::make_nvp("in_size", params_.in),
+                  ::detail::make_nvp("window_width", params_.weight.width_),
+                  ::detail::make_nvp("window_height", params_.weight.height_),
+                  ::detail::make_nvp("out_channels", params_.out.depth_),
+                  ::detail::make_nvp("connection_table", params_.tbl),
+                  ::detail::make_nvp("pad_type", params_.pad_type),
+                  ::detail::make_nvp("has_bias", params_.has_bias),
+                  ::detail::make_nvp("w_stride", params_.w_stride),
+                  ::detail::make_nvp("h_stride", params_.h_stride),
+                  ::detail::make_nvp("w_dilation", params_.w_dilation),
+                  ::detail::make_nvp("h_dilation", params_.h_dilation),
+                  ::detail::make_nvp("weights", layer.W_),
+                  ::detail::make_nvp("bias", layer.bias_));
+  }
+
+  template <class Archive>
+  static inline void serialize(Archive &ar,
+                               tiny_dnn::half_fully_connected_layer &layer) {
+    ::detail::arc(ar, ::detail::make_nvp("in_size", layer.in_size_),
+                  ::detail::make_nvp("out_size", layer.out_size_),
+                  ::detail::make_nvp("weights", layer.W_),
+                  ::detail::make_nvp("bias", layer.bias_));
+  }
+
   template <class Archive>
   static inline void serialize(Archive &ar, tiny_dnn::input_layer &layer) {
     ::detail::arc(ar, ::detail::make_nvp("shape", layer.shape_));
@@ -989,6 +1119,17 @@ struct serialization_buddy {
                   ::detail::make_nvp("has_bias", params_.has_bias_));
   }
 
+  template <class Archive>
+  static inline void serialize(Archive &ar,
+                               tiny_dnn::sparse_fully_connected_layer &layer) {
+    ::detail::arc(ar, ::detail::make_nvp("in_size", layer.W_.cols),
+                  ::detail::make_nvp("out_size", layer.W_.rows),
+                  ::detail::make_nvp("values", layer.W_.values),
+                  ::detail::make_nvp("columns", layer.W_.columns),
+                  ::detail::make_nvp("row_ptr", layer.W_.row_ptr),
+                  ::detail::make_nvp("bias", layer.bias_));
+  }
+
   template <class Archive>
   static inline void serialize(Archive &ar, tiny_dnn::slice_layer &layer) {
     ::detail::arc(ar, ::detail::make_nvp("in_size", layer.in_shape_),
@@ -21,9 +21,13 @@ void register_layers(T* h) {
   h->template register_layer<convolutional_layer>("conv");
   h->template register_layer<deconvolutional_layer>("deconv");
   h->template register_layer<dropout_layer>("dropout");
+  h->template register_layer<fake_quantize_layer>("fake_quantize");
   h->template register_layer<fully_connected_layer>("fully_connected");
   h->template register_layer<global_average_pooling_layer>(
     "global_average_pooling");
+  h->template register_layer<half_convolutional_layer>("half_conv");
+  h->template register_layer<half_fully_connected_layer>(
+    "half_fully_connected");
   h->template register_layer<input_layer>("input");
   h->template register_layer<linear_layer>("linear");
   h->template register_layer<lrn_layer>("lrn");
@@ -40,6 +44,8 @@ void register_layers(T* h) {
   h->template register_layer<lstm_cell>("lstm_cell");
   h->template register_layer<rnn_cell>("rnn_cell");
   h->template register_layer<slice_layer>("slice");
+  h->template register_layer<sparse_fully_connected_layer>(
+    "sparse_fully_connected");
   h->template register_layer<zero_pad_layer>("zero_pad");
 
   h->template register_layer<sigmoid_layer>("sigmoid");
@@ -75,6 +75,16 @@ enum class padding {
   same    ///< add zero-padding around input so as to keep image size
 };
 
+/**
+ * how a layer follows the removal of some of its input channels,
+ * see nodes::prune_channels()
+ **/
+enum class channel_pruning {
+  none,      ///< the input channels can't be removed
+  forwards,  ///< channels are processed separately, the same outputs go
+  consumes   ///< the weights reading the removed channels go
+};
+
 template <typename T>
 T *reverse_endian(T *p) {
   std::reverse(reinterpret_cast<char *>(p),